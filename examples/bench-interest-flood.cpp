@@ -0,0 +1,171 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This registers a Namespace prefix with the local NFD and sends it a flood of
+ * Interests for random names which the Namespace doesn't have, then reports
+ * the CPU time, the resident memory and the number of nodes in the Namespace
+ * tree. One in ten Interests is under a "claimed" child with an OnObjectNeeded
+ * callback which claims production, so only the nodes for these names should
+ * be kept. (The callback doesn't produce the object, so the Interests time
+ * out.)
+ * Usage: bench-interest-flood [nInterests]
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <ndn-cpp/security/key-chain.hpp>
+#include <cnl-cpp/namespace.hpp>
+
+using namespace std;
+using namespace ndn;
+using namespace cnl_cpp;
+
+/**
+ * Get the value in kB of the field in /proc/self/status, such as "VmRSS" for
+ * the resident memory.
+ * @return The value in kB, or 0 if not found (for example if not on Linux).
+ */
+static size_t
+getStatusKb(const char* field)
+{
+  ifstream status("/proc/self/status");
+  string line;
+  while (getline(status, line)) {
+    if (line.compare(0, strlen(field), field) == 0 &&
+        line.size() > strlen(field) && line[strlen(field)] == ':')
+      return atol(line.c_str() + strlen(field) + 1);
+  }
+
+  return 0;
+}
+
+/**
+ * Get the number of nodes in the tree, including nameSpace.
+ */
+static size_t
+getNodeCount(Namespace& nameSpace)
+{
+  size_t count = 1;
+  ptr_lib::shared_ptr<vector<Name::Component> > components =
+    nameSpace.getChildComponents();
+  for (size_t i = 0; i < components->size(); ++i)
+    count += getNodeCount(nameSpace.getChild((*components)[i]));
+
+  return count;
+}
+
+static void
+printResult(const char* label, clock_t cpuStart, size_t rssBeforeKb)
+{
+  cout << label << ": CPU " << (double)(clock() - cpuStart) / CLOCKS_PER_SEC <<
+    " s, VmRSS " << rssBeforeKb << " kB -> " << getStatusKb("VmRSS") <<
+    " kB" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  size_t nInterests = argc > 1 ? atoi(argv[1]) : 100000;
+
+  try {
+    // The default Face will connect using a Unix socket, or to "localhost".
+    Face producerFace;
+    Face consumerFace;
+
+    // Use the system default key chain and certificate name to sign.
+    KeyChain keyChain;
+    producerFace.setCommandSigningInfo
+      (keyChain, keyChain.getDefaultCertificateName());
+
+    Namespace prefix("/test/flood", &keyChain);
+    Namespace& claimed = prefix[Name::Component("claimed")];
+    size_t nObjectsNeeded = 0;
+    claimed.addOnObjectNeeded
+      ([&](Namespace& nameSpace, Namespace& neededNamespace,
+           uint64_t callbackId) {
+        ++nObjectsNeeded;
+        return true;
+      });
+
+    bool enabled = true;
+    prefix.setFace
+      (&producerFace, [&](const ptr_lib::shared_ptr<const Name>& prefixName) {
+        cout << "Register failed for prefix " << prefixName->toUri() << endl;
+        enabled = false;
+      });
+    // Let the registration finish.
+    for (int i = 0; i < 100 && enabled; ++i) {
+      producerFace.processEvents();
+      usleep(10000);
+    }
+    if (!enabled)
+      return 1;
+
+    size_t nNodesBefore = getNodeCount(prefix);
+    size_t rssBeforeKb = getStatusKb("VmRSS");
+    clock_t cpuStart = clock();
+
+    size_t nFinished = 0;
+    srand(1);
+    for (size_t i = 0; i < nInterests; ++i) {
+      Name name(prefix.getName());
+      if (i % 10 == 0)
+        name.append(Name::Component("claimed"));
+      name.append(Name::Component::fromNumber(rand()))
+        .append(Name::Component::fromNumber(rand()));
+
+      Interest interest(name);
+      interest.setInterestLifetimeMilliseconds(2000);
+      consumerFace.expressInterest
+        (interest,
+         [&](const ptr_lib::shared_ptr<const Interest>&,
+             const ptr_lib::shared_ptr<Data>&) { ++nFinished; },
+         [&](const ptr_lib::shared_ptr<const Interest>&) { ++nFinished; },
+         [&](const ptr_lib::shared_ptr<const Interest>&,
+             const ptr_lib::shared_ptr<NetworkNack>&) { ++nFinished; });
+
+      if (i % 100 == 0) {
+        consumerFace.processEvents();
+        producerFace.processEvents();
+      }
+    }
+
+    while (nFinished < nInterests) {
+      consumerFace.processEvents();
+      producerFace.processEvents();
+      // We need to sleep for a few milliseconds so we don't use 100% of the CPU.
+      usleep(1000);
+    }
+
+    printResult("Interest flood", cpuStart, rssBeforeKb);
+    cout << "Interests: " << nInterests << ", OnObjectNeeded calls: " <<
+      nObjectsNeeded << ", nodes: " << nNodesBefore << " -> " <<
+      getNodeCount(prefix) << endl;
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This benchmarks inserting and looking up the children of a Namespace node
+ * for different numbers of children, compared to a std::map from the name
+ * component to the child (like the previous child storage). The children are
+ * segment components, inserted in increasing order (as when fetching or
+ * producing segments) or in shuffled order.
+ * Usage: bench-namespace-lookup [maxChildren [nLookups]]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cnl-cpp/namespace.hpp>
+
+using namespace std;
+using namespace ndn;
+using namespace cnl_cpp;
+
+static double
+getSeconds(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void
+printResult(const char* label, double seconds, size_t nOperations)
+{
+  cout << "  " << label << ": " << seconds * 1e9 / nOperations <<
+    " ns/operation" << endl;
+}
+
+/**
+ * Insert the components as children of a new Namespace and a std::map, then
+ * look up each child in the Namespace and the map until there have been
+ * nLookups lookups.
+ */
+static void
+benchmark(const vector<Name::Component>& components, size_t nLookups)
+{
+  size_t nChildren = components.size();
+  size_t nRounds = max((size_t)1, nLookups / nChildren);
+  size_t nFound = 0;
+
+  Namespace prefix("/test/object");
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < nChildren; ++i)
+    prefix.getChild(components[i]);
+  printResult("Namespace insert", getSeconds(start), nChildren);
+
+  start = chrono::steady_clock::now();
+  for (size_t round = 0; round < nRounds; ++round) {
+    for (size_t i = 0; i < nChildren; ++i) {
+      if (prefix.hasChild(components[i]))
+        ++nFound;
+    }
+  }
+  printResult("Namespace hasChild", getSeconds(start), nRounds * nChildren);
+
+  start = chrono::steady_clock::now();
+  for (size_t round = 0; round < nRounds; ++round) {
+    for (size_t i = 0; i < nChildren; ++i)
+      nFound += prefix.getChild(components[i]).getName().size() > 0 ? 1 : 0;
+  }
+  printResult("Namespace getChild", getSeconds(start), nRounds * nChildren);
+
+  map<Name::Component, Namespace*> children;
+  start = chrono::steady_clock::now();
+  for (size_t i = 0; i < nChildren; ++i)
+    children[components[i]] = &prefix.getChild(components[i]);
+  printResult("std::map insert (+ getChild)", getSeconds(start), nChildren);
+
+  start = chrono::steady_clock::now();
+  for (size_t round = 0; round < nRounds; ++round) {
+    for (size_t i = 0; i < nChildren; ++i) {
+      if (children.find(components[i]) != children.end())
+        ++nFound;
+    }
+  }
+  printResult("std::map find", getSeconds(start), nRounds * nChildren);
+
+  if (nFound != 3 * nRounds * nChildren)
+    cout << "  Error: Found " << nFound << " children" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  size_t maxChildren = argc > 1 ? atoi(argv[1]) : 100000;
+  size_t nLookups = argc > 2 ? atoi(argv[2]) : 1000000;
+
+  try {
+    srand(1);
+    for (size_t nChildren = 1; nChildren <= maxChildren; nChildren *= 4) {
+      vector<Name::Component> components;
+      for (size_t i = 0; i < nChildren; ++i)
+        components.push_back(Name::Component::fromSegment(i));
+
+      cout << nChildren << " children, increasing order:" << endl;
+      benchmark(components, nLookups);
+
+      random_shuffle(components.begin(), components.end());
+      cout << nChildren << " children, shuffled order:" << endl;
+      benchmark(components, nLookups);
+    }
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+  }
+  return 0;
+}
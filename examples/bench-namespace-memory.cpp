@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This reports the number of heap allocations, the time and the resident
+ * memory to create nNodes segment nodes and then to remove them. With "tree",
+ * the nodes are children in a Namespace tree, allocated from the pool of the
+ * root node. With "separate", each node is a separate Namespace allocated
+ * with new and held by a shared_ptr, like the nodes before the pool. Run each
+ * mode in its own process so that the peak resident memory is for that mode.
+ * Usage: bench-namespace-memory [tree|separate [nNodes]]
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <new>
+#include <chrono>
+#include <cnl-cpp/namespace.hpp>
+
+using namespace std;
+using namespace ndn;
+using namespace cnl_cpp;
+
+static size_t nAllocations = 0;
+
+// Count the heap allocations. (The array forms call these by default.)
+void*
+operator new(size_t size)
+{
+  ++nAllocations;
+  void* p = malloc(size > 0 ? size : 1);
+  if (!p)
+    throw bad_alloc();
+  return p;
+}
+
+void
+operator delete(void* p) noexcept { free(p); }
+
+void
+operator delete(void* p, size_t size) noexcept { free(p); }
+
+/**
+ * Get the value in kB of the field in /proc/self/status, such as "VmRSS" for
+ * the resident memory or "VmHWM" for the peak resident memory.
+ * @return The value in kB, or 0 if not found (for example if not on Linux).
+ */
+static size_t
+getStatusKb(const char* field)
+{
+  ifstream status("/proc/self/status");
+  string line;
+  while (getline(status, line)) {
+    if (line.compare(0, strlen(field), field) == 0 &&
+        line.size() > strlen(field) && line[strlen(field)] == ':')
+      return atol(line.c_str() + strlen(field) + 1);
+  }
+
+  return 0;
+}
+
+static double
+getSeconds(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void
+printResult
+  (const char* label, size_t allocationsBefore, size_t rssBeforeKb,
+   double seconds, size_t nNodes)
+{
+  cout << label << ": " << (nAllocations - allocationsBefore) <<
+    " allocations, " << seconds * 1e9 / nNodes << " ns/node, VmRSS " <<
+    rssBeforeKb << " kB -> " << getStatusKb("VmRSS") << " kB, VmHWM " <<
+    getStatusKb("VmHWM") << " kB" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  bool useTree = !(argc > 1 && strcmp(argv[1], "separate") == 0);
+  size_t nNodes = argc > 2 ? atoi(argv[2]) : 130000;
+
+  try {
+    Name prefix("/test/object");
+    vector<Name::Component> components;
+    for (size_t i = 0; i < nNodes; ++i)
+      components.push_back(Name::Component::fromSegment(i));
+
+    Namespace root("/test");
+    vector<ptr_lib::shared_ptr<Namespace> > separateNodes;
+    if (!useTree)
+      separateNodes.reserve(nNodes);
+
+    size_t allocationsBefore = nAllocations;
+    size_t rssBeforeKb = getStatusKb("VmRSS");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (useTree) {
+      Namespace& objectNamespace = root.getChild(prefix);
+      for (size_t i = 0; i < nNodes; ++i)
+        objectNamespace.getChild(components[i]);
+    }
+    else {
+      for (size_t i = 0; i < nNodes; ++i)
+        separateNodes.push_back(ptr_lib::shared_ptr<Namespace>
+          (new Namespace(Name(prefix).append(components[i]))));
+    }
+    printResult
+      (useTree ? "Create tree nodes" : "Create separate nodes",
+       allocationsBefore, rssBeforeKb, getSeconds(start), nNodes);
+
+    allocationsBefore = nAllocations;
+    rssBeforeKb = getStatusKb("VmRSS");
+    start = chrono::steady_clock::now();
+    if (useTree)
+      root.removeChild(prefix[-1]);
+    else
+      separateNodes.clear();
+    printResult
+      (useTree ? "Remove tree nodes" : "Remove separate nodes",
+       allocationsBefore, rssBeforeKb, getSeconds(start), nNodes);
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This benchmarks the segments per second of SegmentStreamHandler::setObject
+ * with a signature _manifest for 1 up to maxThreads worker threads (set with
+ * setNWorkerThreads). Each measurement first calls setObject once so that the
+ * handler has started its worker threads, then times a second setObject with
+ * the same handler. If the third argument is "sign", this also benchmarks
+ * signing each segment packet with the system default KeyChain. Since the
+ * KeyChain is not thread safe, the signing is serial and only the Data
+ * construction uses the worker threads, so this mode is labeled as serial
+ * signing.
+ * Usage: bench-segment-threads [objectSize [maxThreads [sign]]]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <ndn-cpp/security/key-chain.hpp>
+#include <cnl-cpp/segment-stream-handler.hpp>
+
+using namespace std;
+using namespace ndn;
+using namespace cnl_cpp;
+
+static double
+getSeconds(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Call setObject on a new Namespace with the given number of worker threads
+ * and print the segments per second.
+ */
+static void
+benchmark
+  (KeyChain& keyChain, const Blob& object, int nThreads,
+   bool useSignatureManifest)
+{
+  SegmentStreamHandler handler;
+  handler.setNWorkerThreads(nThreads);
+  size_t maxSegmentPayloadLength = handler.getMaxSegmentPayloadLength();
+  size_t nSegments =
+    (object.size() + maxSegmentPayloadLength - 1) / maxSegmentPayloadLength;
+
+  // Start the worker threads, which the handler reuses for the next object.
+  Namespace warmUpNamespace("/test/warm-up", &keyChain);
+  handler.setObject(warmUpNamespace, object, useSignatureManifest);
+
+  Namespace objectNamespace("/test/object", &keyChain);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  handler.setObject(objectNamespace, object, useSignatureManifest);
+  double seconds = getSeconds(start);
+
+  cout << (useSignatureManifest ? "Signature _manifest" :
+           "Sign each segment (serial signing)") <<
+    ", " << nThreads << " threads: " << nSegments / seconds <<
+    " segments/s" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  size_t objectSize = argc > 1 ? atoi(argv[1]) : 20000000;
+  int maxThreads = argc > 2 ? atoi(argv[2]) :
+    max(1, (int)thread::hardware_concurrency());
+  bool benchmarkSigning = argc > 3 && string(argv[3]) == "sign";
+
+  try {
+    // Use the system default key chain and certificate name to sign.
+    KeyChain keyChain;
+
+    ptr_lib::shared_ptr<vector<uint8_t> > objectBytes
+      (new vector<uint8_t>(objectSize));
+    for (size_t i = 0; i < objectSize; ++i)
+      (*objectBytes)[i] = (uint8_t)rand();
+    Blob object(objectBytes, false);
+
+    for (int nThreads = 1; nThreads <= maxThreads; nThreads *= 2)
+      benchmark(keyChain, object, nThreads, true);
+    if ((maxThreads & (maxThreads - 1)) != 0)
+      // maxThreads is not a power of 2, so also run with maxThreads.
+      benchmark(keyChain, object, maxThreads, true);
+
+    if (benchmarkSigning) {
+      for (int nThreads = 1; nThreads <= maxThreads; nThreads *= 2)
+        benchmark(keyChain, object, nThreads, false);
+      if ((maxThreads & (maxThreads - 1)) != 0)
+        benchmark(keyChain, object, maxThreads, false);
+    }
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+  }
+  return 0;
+}
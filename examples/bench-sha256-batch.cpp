@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This benchmarks computing the implicit digests of segment packets with
+ * Data::getFullName(), with a new Sha256Batch for each packet, and with one
+ * Sha256Batch for all packets.
+ * Usage: bench-sha256-batch [nSegments [segmentSize]]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <ndn-cpp/data.hpp>
+#include <ndn-cpp/digest-sha256-signature.hpp>
+#include "../src/impl/sha256-batch.hpp"
+
+using namespace std;
+using namespace ndn;
+using namespace cnl_cpp;
+
+static double
+getSeconds(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void
+printResult
+  (const char* label, double seconds, size_t nSegments, size_t segmentSize)
+{
+  cout << label << ": " << seconds * 1e9 / nSegments << " ns/segment, " <<
+    (nSegments * (double)segmentSize) / seconds / 1e6 << " MB/s" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  size_t nSegments = argc > 1 ? atoi(argv[1]) : 10000;
+  size_t segmentSize = argc > 2 ? atoi(argv[2]) : 8000;
+
+  try {
+    // Make the segment encodings as in setObject with a signature _manifest.
+    ptr_lib::shared_ptr<vector<uint8_t> > payload
+      (new vector<uint8_t>(segmentSize, 0x55));
+    DigestSha256Signature digestSignature;
+    digestSignature.setSignature
+      (Blob(ptr_lib::make_shared<vector<uint8_t> >(ndn_SHA256_DIGEST_SIZE, 0),
+            false));
+    vector<ptr_lib::shared_ptr<Data> > segments(nSegments);
+    vector<Blob> encodings(nSegments);
+    for (size_t i = 0; i < nSegments; ++i) {
+      segments[i] = ptr_lib::make_shared<Data>
+        (Name("/test/object").appendSegment(i));
+      segments[i]->setContent(Blob(payload, false));
+      segments[i]->setSignature(digestSignature);
+      encodings[i] = segments[i]->wireEncode();
+    }
+    vector<uint8_t> digests(nSegments * ndn_SHA256_DIGEST_SIZE);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < nSegments; ++i)
+      segments[i]->getFullName();
+    printResult("Data::getFullName()", getSeconds(start), nSegments, segmentSize);
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < nSegments; ++i)
+      Sha256Batch().digest
+        (&encodings[i], 1, &digests[i * ndn_SHA256_DIGEST_SIZE]);
+    printResult
+      ("New Sha256Batch per segment", getSeconds(start), nSegments, segmentSize);
+
+    start = chrono::steady_clock::now();
+    if (nSegments > 0)
+      Sha256Batch().digest(&encodings[0], nSegments, &digests[0]);
+    printResult
+      ("One Sha256Batch for all", getSeconds(start), nSegments, segmentSize);
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This benchmarks the cost of the OnStateChanged dispatch for the number of
+ * handlers on a prefix Namespace. Each handler only wants the OBJECT_READY
+ * state of the stream nodes which are the children of the prefix, like a
+ * handler for each stream object. Then this makes nSegments segment nodes
+ * under a stream, where each new node fires NAME_EXISTS at the prefix. With
+ * "unfiltered", each handler uses addOnStateChanged(onStateChanged) and
+ * returns early for the other changes. With "filtered", each handler uses
+ * addOnStateChanged with a state mask and depth range so that the dispatch
+ * doesn't call it.
+ * Usage: bench-state-dispatch [maxHandlers [nSegments]]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <chrono>
+#include <cnl-cpp/namespace.hpp>
+
+using namespace std;
+using namespace ndn;
+using namespace cnl_cpp;
+
+static double
+getSeconds(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Add nHandlers handlers to a new prefix Namespace and make nSegments segment
+ * nodes under a stream. Print the time per segment node and the number of
+ * calls to the handlers.
+ */
+static void
+benchmark(size_t nHandlers, size_t nSegments, bool useFilter)
+{
+  Namespace prefix("/test/streams");
+  size_t nCalls = 0;
+  size_t nReadyStreams = 0;
+
+  for (size_t i = 0; i < nHandlers; ++i) {
+    if (useFilter)
+      prefix.addOnStateChanged
+        ([&](Namespace& nameSpace, Namespace& changedNamespace,
+             NamespaceState state, uint64_t callbackId) {
+          ++nCalls;
+          ++nReadyStreams;
+        },
+         Namespace::getStateMask(NamespaceState_OBJECT_READY), 1, 1);
+    else
+      prefix.addOnStateChanged
+        ([&](Namespace& nameSpace, Namespace& changedNamespace,
+             NamespaceState state, uint64_t callbackId) {
+          ++nCalls;
+          if (!(state == NamespaceState_OBJECT_READY &&
+                changedNamespace.getName().size() ==
+                  nameSpace.getName().size() + 1))
+            // Ignore the other changes.
+            return;
+
+          ++nReadyStreams;
+        });
+  }
+
+  Namespace& stream = prefix[Name::Component("stream")];
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < nSegments; ++i)
+    stream.getChild(Name::Component::fromSegment(i));
+  double seconds = getSeconds(start);
+
+  cout << (useFilter ? "Filtered" : "Unfiltered") << ", " << nHandlers <<
+    " handlers: " << seconds * 1e9 / nSegments << " ns/segment, " <<
+    nCalls << " calls, " << nReadyStreams << " ready streams" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  size_t maxHandlers = argc > 1 ? atoi(argv[1]) : 10000;
+  size_t nSegments = argc > 2 ? atoi(argv[2]) : 10000;
+
+  try {
+    benchmark(0, nSegments, false);
+    for (size_t nHandlers = 1; nHandlers <= maxHandlers; nHandlers *= 10) {
+      benchmark(nHandlers, nSegments, false);
+      benchmark(nHandlers, nSegments, true);
+    }
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+  }
+  return 0;
+}
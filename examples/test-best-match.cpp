@@ -0,0 +1,185 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This checks which Data packet a producer Namespace sends for an incoming
+ * Interest: the longest matching name and, among names of the same length,
+ * the leftmost, skipping stale Data for MustBeFresh and Data which was
+ * removed. The producer and consumer use two Faces in this process through
+ * the local NFD. Each check uses its own prefix under a new version, so that
+ * the NFD cache doesn't answer from an earlier check. This prints each result
+ * and returns 1 if a check fails.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <ndn-cpp/security/key-chain.hpp>
+#include <cnl-cpp/namespace.hpp>
+
+using namespace std;
+using namespace cnl_cpp;
+using namespace ndn;
+
+static int nFailures = 0;
+
+/**
+ * Make a Data packet with the name under the prefix, sign it and set it in
+ * the prefix Namespace tree.
+ * @param prefix The producer prefix Namespace.
+ * @param suffix The name relative to prefix, such as "a/b".
+ * @param freshnessPeriod The freshness period in milliseconds.
+ */
+static void
+setData
+  (Namespace& prefix, KeyChain& keyChain, const string& suffix,
+   Milliseconds freshnessPeriod = 10000)
+{
+  ptr_lib::shared_ptr<Data> data = ptr_lib::make_shared<Data>
+    (Name(prefix.getName()).append(Name(suffix)));
+  data->getMetaInfo().setFreshnessPeriod(freshnessPeriod);
+  keyChain.sign(*data);
+  prefix[data->getName()].setData(data);
+}
+
+/**
+ * Express the Interest and check that the Data name is the expected name.
+ * @param expectedSuffix The expected Data name relative to the Interest name.
+ */
+static void
+check
+  (Face& producerFace, Face& consumerFace, const Interest& interest,
+   const string& expectedSuffix, const char* description)
+{
+  Name expectedName(interest.getName());
+  expectedName.append(Name(expectedSuffix));
+
+  bool enabled = true;
+  Name dataName;
+  consumerFace.expressInterest
+    (interest,
+     [&](const ptr_lib::shared_ptr<const Interest>&,
+         const ptr_lib::shared_ptr<Data>& data) {
+       dataName = data->getName();
+       enabled = false;
+     },
+     [&](const ptr_lib::shared_ptr<const Interest>&) { enabled = false; },
+     [&](const ptr_lib::shared_ptr<const Interest>&,
+         const ptr_lib::shared_ptr<NetworkNack>&) { enabled = false; });
+
+  while (enabled) {
+    producerFace.processEvents();
+    consumerFace.processEvents();
+    // We need to sleep for a few milliseconds so we don't use 100% of the CPU.
+    usleep(10000);
+  }
+
+  bool isPass = dataName.size() > 0 && dataName.equals(expectedName);
+  cout << (isPass ? "PASS: " : "FAIL: ") << description;
+  if (!isPass)
+    cout << " (got " << (dataName.size() > 0 ? dataName.toUri() : "no Data") <<
+      ")";
+  cout << endl;
+  if (!isPass)
+    ++nFailures;
+}
+
+int main(int argc, char** argv)
+{
+  try {
+    // The default Face will connect using a Unix socket, or to "localhost".
+    Face producerFace;
+    Face consumerFace;
+
+    // Use the system default key chain and certificate name to sign.
+    KeyChain keyChain;
+    producerFace.setCommandSigningInfo
+      (keyChain, keyChain.getDefaultCertificateName());
+
+    // Use a new version so that the NFD cache doesn't have old packets.
+    Name prefixName("/test/best-match");
+    prefixName.appendVersion((uint64_t)ndn_getNowMilliseconds());
+    Namespace prefix(prefixName, &keyChain);
+
+    setData(prefix, keyChain, "leftmost");
+    setData(prefix, keyChain, "leftmost/a/b");
+    setData(prefix, keyChain, "leftmost/c/d");
+
+    setData(prefix, keyChain, "longest/a");
+    setData(prefix, keyChain, "longest/b/c/d");
+    setData(prefix, keyChain, "longest/z");
+
+    setData(prefix, keyChain, "exact");
+    setData(prefix, keyChain, "exact/a/b");
+
+    // A freshness period of 0 is stale right away.
+    setData(prefix, keyChain, "fresh/a/x", 0);
+    setData(prefix, keyChain, "fresh/b");
+
+    setData(prefix, keyChain, "removed/a/b/c");
+    setData(prefix, keyChain, "removed/d");
+    prefix[Name::Component("removed")].removeChild(Name::Component("a"));
+
+    bool enabled = true;
+    prefix.setFace
+      (&producerFace, [&](const ptr_lib::shared_ptr<const Name>& prefixName) {
+        cout << "Register failed for prefix " << prefixName->toUri() << endl;
+        enabled = false;
+      });
+    // Let the registration finish.
+    for (int i = 0; i < 100 && enabled; ++i) {
+      producerFace.processEvents();
+      usleep(10000);
+    }
+    if (!enabled)
+      return 1;
+
+    Interest interest;
+    interest.setCanBePrefix(true);
+
+    interest.setName(Name(prefixName).append(Name::Component("leftmost")));
+    check(producerFace, consumerFace, interest, "a/b",
+          "Prefer the leftmost among the longest names");
+
+    interest.setName(Name(prefixName).append(Name::Component("longest")));
+    check(producerFace, consumerFace, interest, "b/c/d",
+          "Prefer the longest name");
+
+    interest.setName(Name(prefixName).append(Name::Component("removed")));
+    check(producerFace, consumerFace, interest, "d",
+          "Don't match a removed Data packet");
+
+    interest.setName(Name(prefixName).append(Name::Component("fresh")));
+    interest.setMustBeFresh(true);
+    check(producerFace, consumerFace, interest, "b",
+          "Skip a longer stale Data packet for MustBeFresh");
+    interest.setMustBeFresh(false);
+
+    interest.setName(Name(prefixName).append(Name::Component("exact")));
+    interest.setCanBePrefix(false);
+    check(producerFace, consumerFace, interest, "",
+          "Only match the exact name if the Interest can't be a prefix");
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+    return 1;
+  }
+  return nFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This checks that an object with a signature _manifest tree (more than 256
+ * segments) can be fetched through the local NFD. The producer and consumer
+ * use two Faces in this process and the Interests can be a prefix, as in the
+ * other examples, so this also checks that the Interest for _manifest is not
+ * answered with a manifest tree packet. The object is fetched once while
+ * verifying each segment and once while fetching the manifest tree packets
+ * for verifyWithManifest. This prints each result and returns 1 if a check
+ * fails.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <ndn-cpp/security/key-chain.hpp>
+#include <cnl-cpp/segmented-object-handler.hpp>
+
+using namespace std;
+using namespace cnl_cpp;
+using namespace ndn;
+
+static int nFailures = 0;
+
+static void
+check(bool condition, const char* description)
+{
+  cout << (condition ? "PASS: " : "FAIL: ") << description << endl;
+  if (!condition)
+    ++nFailures;
+}
+
+/**
+ * Fetch the segmented object with a new consumer Namespace and check it.
+ */
+static void
+fetch
+  (Face& producerFace, Face& consumerFace, const Name& objectName,
+   const Blob& object, bool verifySegments)
+{
+  Namespace objectNamespace(objectName);
+  objectNamespace.setFace(&consumerFace);
+
+  bool enabled = true;
+  SegmentedObjectHandler handler
+    (&objectNamespace, [&](Namespace& nameSpace) { enabled = false; });
+  handler.setVerifySegments(verifySegments);
+  handler.addOnSegmentsError
+    ([&](Namespace& nameSpace, const string& message) {
+      cout << "Segments error: " << message << endl;
+      enabled = false;
+    });
+  handler.objectNeeded();
+
+  // Wait up to 20 seconds.
+  for (int i = 0; i < 2000 && enabled; ++i) {
+    producerFace.processEvents();
+    consumerFace.processEvents();
+    // We need to sleep for a few milliseconds so we don't use 100% of the CPU.
+    usleep(10000);
+  }
+
+  if (verifySegments) {
+    check(!enabled, "Fetch the object while verifying each segment");
+    check(objectNamespace.getBlobObject().equals(object),
+          "The object verified with each segment has the same content");
+  }
+  else {
+    check(!enabled, "Fetch the object and the manifest tree packets");
+    // The manifest tree packets are fetched along with the segments, so
+    // process events until they are all verified.
+    for (int i = 0; i < 500 &&
+         !SegmentStreamHandler::verifyWithManifest(objectNamespace); ++i) {
+      producerFace.processEvents();
+      consumerFace.processEvents();
+      usleep(10000);
+    }
+    check(objectNamespace.getBlobObject().equals(object),
+          "The object has the same content");
+    check(SegmentStreamHandler::verifyWithManifest(objectNamespace),
+          "verifyWithManifest verifies the fetched object");
+  }
+}
+
+int main(int argc, char** argv)
+{
+  try {
+    // The Interest for _manifest can be a prefix, as in the other examples.
+    Interest::setDefaultCanBePrefix(true);
+
+    // The default Face will connect using a Unix socket, or to "localhost".
+    Face producerFace;
+    Face consumerFace;
+
+    // Use the system default key chain and certificate name to sign.
+    KeyChain keyChain;
+    producerFace.setCommandSigningInfo
+      (keyChain, keyChain.getDefaultCertificateName());
+
+    // Use a new version so that the NFD cache doesn't have old packets.
+    Name objectName("/test/manifest-tree");
+    objectName.appendVersion((uint64_t)ndn_getNowMilliseconds());
+    Namespace producerNamespace(objectName, &keyChain);
+
+    // Make 600 segments so that the manifest has a tree level.
+    SegmentStreamHandler producerHandler;
+    size_t objectSize = 600 * producerHandler.getMaxSegmentPayloadLength();
+    ptr_lib::shared_ptr<vector<uint8_t> > objectBytes
+      (new vector<uint8_t>(objectSize));
+    for (size_t i = 0; i < objectSize; ++i)
+      (*objectBytes)[i] = (uint8_t)rand();
+    Blob object(objectBytes, false);
+    producerHandler.setObject(producerNamespace, object, true);
+
+    Namespace& manifestNamespace =
+      producerNamespace[SegmentStreamHandler::getNAME_COMPONENT_MANIFEST()];
+    check(manifestNamespace.getData() &&
+          manifestNamespace.getChildComponents()->size() == 0,
+          "The _manifest packet has no packets below it");
+    check(producerNamespace.hasChild
+            (SegmentStreamHandler::getNAME_COMPONENT_MANIFEST_TREE()),
+          "The manifest tree packets are below _manifest-tree");
+    check(SegmentStreamHandler::verifyWithManifest(producerNamespace),
+          "verifyWithManifest verifies the produced object");
+
+    bool enabled = true;
+    producerNamespace.setFace
+      (&producerFace, [&](const ptr_lib::shared_ptr<const Name>& prefix) {
+        cout << "Register failed for prefix " << prefix->toUri() << endl;
+        enabled = false;
+      });
+    // Let the registration finish.
+    for (int i = 0; i < 100 && enabled; ++i) {
+      producerFace.processEvents();
+      usleep(10000);
+    }
+    if (!enabled)
+      return 1;
+
+    fetch(producerFace, consumerFace, objectName, object, true);
+    fetch(producerFace, consumerFace, objectName, object, false);
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+    return 1;
+  }
+  return nFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This checks the pending incoming Interest table of a producer Namespace
+ * which doesn't have the Data yet: a retransmitted Interest is aggregated with
+ * the pending entry, the entry expires after the Interest lifetime, the oldest
+ * entry is evicted when the table is full, and setData satisfies the entry.
+ * The producer and consumer use two Faces in this process through the local
+ * NFD, using a prefix under a new version so that the NFD cache doesn't answer.
+ * This prints each result and returns 1 if a check fails.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <ndn-cpp/security/key-chain.hpp>
+#include <cnl-cpp/namespace.hpp>
+
+using namespace std;
+using namespace cnl_cpp;
+using namespace ndn;
+
+static int nFailures = 0;
+
+static void
+check(bool isPass, const char* description)
+{
+  cout << (isPass ? "PASS: " : "FAIL: ") << description << endl;
+  if (!isPass)
+    ++nFailures;
+}
+
+/**
+ * Process events on both faces for the given time.
+ */
+static void
+processEvents
+  (Face& producerFace, Face& consumerFace, Milliseconds milliseconds)
+{
+  MillisecondsSince1970 endTime = ndn_getNowMilliseconds() + milliseconds;
+  while (ndn_getNowMilliseconds() < endTime) {
+    producerFace.processEvents();
+    consumerFace.processEvents();
+    // We need to sleep for a few milliseconds so we don't use 100% of the CPU.
+    usleep(10000);
+  }
+}
+
+/**
+ * Express an Interest for the name with a new nonce.
+ * @param nData This is incremented when the Data packet is received.
+ */
+static void
+expressInterest
+  (Face& consumerFace, const Name& name, Milliseconds lifetime, int& nData)
+{
+  Interest interest(name);
+  interest.setInterestLifetimeMilliseconds(lifetime);
+  consumerFace.expressInterest
+    (interest,
+     [&](const ptr_lib::shared_ptr<const Interest>&,
+         const ptr_lib::shared_ptr<Data>&) { ++nData; },
+     [](const ptr_lib::shared_ptr<const Interest>&) {},
+     [](const ptr_lib::shared_ptr<const Interest>&,
+        const ptr_lib::shared_ptr<NetworkNack>&) {});
+}
+
+int main(int argc, char** argv)
+{
+  try {
+    // The default Face will connect using a Unix socket, or to "localhost".
+    Face producerFace;
+    Face consumerFace;
+
+    // Use the system default key chain and certificate name to sign.
+    KeyChain keyChain;
+    producerFace.setCommandSigningInfo
+      (keyChain, keyChain.getDefaultCertificateName());
+
+    // Use a new version so that the NFD cache doesn't have old packets.
+    Name prefixName("/test/pending-interest");
+    prefixName.appendVersion((uint64_t)ndn_getNowMilliseconds());
+    Namespace prefix(prefixName, &keyChain);
+
+    bool enabled = true;
+    prefix.setFace
+      (&producerFace, [&](const ptr_lib::shared_ptr<const Name>& prefixName) {
+        cout << "Register failed for prefix " << prefixName->toUri() << endl;
+        enabled = false;
+      });
+    // Let the registration finish.
+    for (int i = 0; i < 100 && enabled; ++i) {
+      producerFace.processEvents();
+      usleep(10000);
+    }
+    if (!enabled)
+      return 1;
+
+    int nData = 0;
+
+    // Wait between the Interests so that the NFD forwards the retransmission
+    // instead of suppressing it.
+    Name aggregateName = Name(prefixName).append(Name::Component("aggregate"));
+    expressInterest(consumerFace, aggregateName, 1000, nData);
+    processEvents(producerFace, consumerFace, 300);
+    expressInterest(consumerFace, aggregateName, 1000, nData);
+    processEvents(producerFace, consumerFace, 300);
+    check(prefix.getPendingIncomingInterestAggregationCount() == 1 &&
+          prefix.getPendingIncomingInterestCount() == 1,
+          "Aggregate a retransmitted Interest with the pending entry");
+
+    processEvents(producerFace, consumerFace, 2000);
+    check(prefix.getPendingIncomingInterestExpirationCount() == 1 &&
+          prefix.getPendingIncomingInterestCount() == 0,
+          "Remove the pending entry after the Interest lifetime");
+
+    prefix.setMaxPendingIncomingInterests(1);
+    Name evictedName = Name(prefixName).append(Name::Component("evicted"));
+    Name keptName = Name(prefixName).append(Name::Component("kept"));
+    expressInterest(consumerFace, evictedName, 4000, nData);
+    processEvents(producerFace, consumerFace, 300);
+    expressInterest(consumerFace, keptName, 4000, nData);
+    processEvents(producerFace, consumerFace, 300);
+    check(prefix.getPendingIncomingInterestEvictionCount() == 1 &&
+          prefix.getPendingIncomingInterestCount() == 1,
+          "Evict the oldest pending entry when the table is full");
+
+    ptr_lib::shared_ptr<Data> data = ptr_lib::make_shared<Data>(keptName);
+    keyChain.sign(*data);
+    prefix[keptName].setData(data);
+    processEvents(producerFace, consumerFace, 300);
+    check(prefix.getPendingIncomingInterestHitCount() == 1 &&
+          prefix.getPendingIncomingInterestCount() == 0 && nData == 1,
+          "Satisfy the pending entry when the Data is set");
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+    return 1;
+  }
+  return nFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+/**
+ * This checks when SegmentedObjectHandler removes the segment nodes after
+ * copying them into the object. The producer and consumer use two Faces in
+ * this process through the local NFD. By default, the segment nodes are kept.
+ * With setRemoveSegments(true), they are removed, except while there are
+ * OnSegment callbacks which must still get every segment in order. This
+ * prints each result and returns 1 if a check fails.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <ndn-cpp/security/key-chain.hpp>
+#include <cnl-cpp/segmented-object-handler.hpp>
+
+using namespace std;
+using namespace cnl_cpp;
+using namespace ndn;
+
+static int nFailures = 0;
+
+static void
+check(bool condition, const char* description)
+{
+  cout << (condition ? "PASS: " : "FAIL: ") << description << endl;
+  if (!condition)
+    ++nFailures;
+}
+
+/**
+ * Get the number of children of the Namespace which are segments.
+ */
+static size_t
+getSegmentNodeCount(Namespace& nameSpace)
+{
+  ptr_lib::shared_ptr<vector<Name::Component> > components =
+    nameSpace.getChildComponents();
+  size_t count = 0;
+  for (size_t i = 0; i < components->size(); ++i) {
+    if ((*components)[i].isSegment())
+      ++count;
+  }
+
+  return count;
+}
+
+/**
+ * Fetch the segmented object with a new consumer Namespace and check it.
+ * @param nSegments The number of segments in the object.
+ * @param removeSegments The value for setRemoveSegments.
+ * @param useOnSegment If true, add an OnSegment callback.
+ */
+static void
+fetch
+  (Face& producerFace, Face& consumerFace, const Name& objectName,
+   const Blob& object, size_t nSegments, bool removeSegments,
+   bool useOnSegment)
+{
+  Namespace objectNamespace(objectName);
+  objectNamespace.setFace(&consumerFace);
+
+  bool enabled = true;
+  SegmentedObjectHandler handler
+    (&objectNamespace, [&](Namespace& nameSpace) { enabled = false; });
+  handler.setRemoveSegments(removeSegments);
+  handler.addOnSegmentsError([&](Namespace& nameSpace, const string& message) {
+    cout << "Segments error: " << message << endl;
+    enabled = false;
+  });
+
+  uint64_t nextSegmentNumber = 0;
+  bool isInOrder = true;
+  if (useOnSegment)
+    handler.addOnSegment([&](Namespace* segmentNamespace) {
+      if (!segmentNamespace)
+        // The end of the segments.
+        return;
+      if (segmentNamespace->getNameComponent().toSegment() != nextSegmentNumber)
+        isInOrder = false;
+      ++nextSegmentNumber;
+    });
+  handler.objectNeeded();
+
+  // Wait up to 20 seconds.
+  for (int i = 0; i < 2000 && enabled; ++i) {
+    producerFace.processEvents();
+    consumerFace.processEvents();
+    // We need to sleep for a few milliseconds so we don't use 100% of the CPU.
+    usleep(10000);
+  }
+
+  check(!enabled && objectNamespace.getBlobObject().equals(object),
+        "Fetch the object with the same content");
+  if (useOnSegment)
+    check(nextSegmentNumber == nSegments && isInOrder,
+          "The OnSegment callback gets every segment in order");
+
+  size_t nSegmentNodes = getSegmentNodeCount(objectNamespace);
+  if (removeSegments && !useOnSegment)
+    // The node of the segment which was copied last may remain.
+    check(nSegmentNodes <= 1, "setRemoveSegments(true) removes the segments");
+  else
+    check(nSegmentNodes == nSegments, "The segment nodes are kept");
+}
+
+int main(int argc, char** argv)
+{
+  try {
+    // The default Face will connect using a Unix socket, or to "localhost".
+    Face producerFace;
+    Face consumerFace;
+
+    // Use the system default key chain and certificate name to sign.
+    KeyChain keyChain;
+    producerFace.setCommandSigningInfo
+      (keyChain, keyChain.getDefaultCertificateName());
+
+    // Use a new version so that the NFD cache doesn't have old packets.
+    Name objectName("/test/segment-removal");
+    objectName.appendVersion((uint64_t)ndn_getNowMilliseconds());
+    Namespace producerNamespace(objectName, &keyChain);
+
+    // Sign each segment, so that the consumer can remove the segments.
+    size_t nSegments = 20;
+    SegmentStreamHandler producerHandler;
+    size_t objectSize = nSegments * producerHandler.getMaxSegmentPayloadLength();
+    ptr_lib::shared_ptr<vector<uint8_t> > objectBytes
+      (new vector<uint8_t>(objectSize));
+    for (size_t i = 0; i < objectSize; ++i)
+      (*objectBytes)[i] = (uint8_t)rand();
+    Blob object(objectBytes, false);
+    producerHandler.setObject(producerNamespace, object);
+
+    bool enabled = true;
+    producerNamespace.setFace
+      (&producerFace, [&](const ptr_lib::shared_ptr<const Name>& prefix) {
+        cout << "Register failed for prefix " << prefix->toUri() << endl;
+        enabled = false;
+      });
+    // Let the registration finish.
+    for (int i = 0; i < 100 && enabled; ++i) {
+      producerFace.processEvents();
+      usleep(10000);
+    }
+    if (!enabled)
+      return 1;
+
+    cout << "Default:" << endl;
+    fetch(producerFace, consumerFace, objectName, object, nSegments, false,
+          false);
+    cout << "setRemoveSegments(true):" << endl;
+    fetch(producerFace, consumerFace, objectName, object, nSegments, true,
+          false);
+    cout << "setRemoveSegments(true) with an OnSegment callback:" << endl;
+    fetch(producerFace, consumerFace, objectName, object, nSegments, true,
+          true);
+  } catch (std::exception& e) {
+    cout << "exception: " << e.what() << endl;
+    return 1;
+  }
+  return nFailures > 0 ? 1 : 0;
+}
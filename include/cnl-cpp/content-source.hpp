@@ -0,0 +1,163 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_CONTENT_SOURCE_HPP
+#define CNL_CPP_CONTENT_SOURCE_HPP
+
+#include <string>
+#include <ndn-cpp/util/blob.hpp>
+
+namespace cnl_cpp {
+
+/**
+ * ContentSource is an abstract base class for random access to the content of
+ * an object to publish. It is used by SegmentStreamHandler::setObjectFromSource
+ * to read the content of each segment only when the segment is needed.
+ */
+class ContentSource {
+public:
+  virtual
+  ~ContentSource();
+
+  /**
+   * Get the total number of bytes in the content.
+   * @return The size of the content.
+   */
+  virtual uint64_t
+  size() = 0;
+
+  /**
+   * Read bytes of the content.
+   * @param offset The byte offset in the content.
+   * @param length The number of bytes to read. offset + length must not be
+   * greater than size().
+   * @return A Blob with the bytes.
+   * @throws runtime_error for an error reading the content.
+   */
+  virtual ndn::Blob
+  read(uint64_t offset, size_t length) = 0;
+};
+
+/**
+ * BlobContentSource extends ContentSource to read from a Blob in memory.
+ */
+class BlobContentSource : public ContentSource {
+public:
+  /**
+   * Create a BlobContentSource to read from the blob.
+   * @param blob The content. This shares the Blob's buffer.
+   */
+  BlobContentSource(const ndn::Blob& blob)
+  : blob_(blob)
+  {}
+
+  virtual uint64_t
+  size();
+
+  virtual ndn::Blob
+  read(uint64_t offset, size_t length);
+
+private:
+  ndn::Blob blob_;
+};
+
+/**
+ * FileContentSource extends ContentSource to read from a file with pread, so
+ * that the file is not loaded into memory.
+ */
+class FileContentSource : public ContentSource {
+public:
+  /**
+   * Create a FileContentSource to read from the file at the path. The file
+   * should not change while this is used.
+   * @param filePath The path of the file.
+   * @throws runtime_error if the file can't be opened.
+   */
+  FileContentSource(const std::string& filePath);
+
+  /**
+   * Close the file.
+   */
+  virtual
+  ~FileContentSource();
+
+  virtual uint64_t
+  size() { return size_; }
+
+  virtual ndn::Blob
+  read(uint64_t offset, size_t length);
+
+private:
+  // Don't allow copying since this closes the file descriptor.
+  FileContentSource(const FileContentSource& other);
+  FileContentSource& operator=(const FileContentSource& other);
+
+  int fileDescriptor_;
+  uint64_t size_;
+};
+
+/**
+ * MmapContentSource extends ContentSource to read from a file which is
+ * memory-mapped read-only, so that the file is not loaded into memory and the
+ * operating system pages it in as it is read.
+ */
+class MmapContentSource : public ContentSource {
+public:
+  /**
+   * Create an MmapContentSource to map the file at the path. The file should
+   * not change while this is used.
+   * @param filePath The path of the file.
+   * @throws runtime_error if the file can't be opened or mapped.
+   */
+  MmapContentSource(const std::string& filePath);
+
+  /**
+   * Unmap the file.
+   */
+  virtual
+  ~MmapContentSource();
+
+  virtual uint64_t
+  size() { return size_; }
+
+  virtual ndn::Blob
+  read(uint64_t offset, size_t length);
+
+  /**
+   * Get a pointer to the mapped file content, which is valid while this
+   * object exists.
+   * @return A pointer to the content, or null if the file is empty.
+   */
+  const uint8_t*
+  buf() const { return map_; }
+
+private:
+  // Don't allow copying since this unmaps the file.
+  MmapContentSource(const MmapContentSource& other);
+  MmapContentSource& operator=(const MmapContentSource& other);
+
+  const uint8_t* map_;
+  uint64_t size_;
+};
+
+}
+
+#endif
@@ -121,6 +121,32 @@ public:
     impl_->setObject(nameSpace, object, contentType, other);
   }
 
+  /**
+   * Publish the content of the file as a Generalized Object, as with
+   * setObject. If the file is large enough to require segmenting, this
+   * memory-maps the file and makes the content of each segment packet from the
+   * mapping (see SegmentStreamHandler::setObjectFromFile), so that the file is
+   * not read into memory first. In this case, this does not set the object of
+   * the given Namespace.
+   * @param nameSpace The Namespace to append segment packets to. This
+   * ignores the Namespace from setNamespace().
+   * @param filePath The path of the file, which must not change while this is
+   * called.
+   * @param contentType The content type for the content _meta packet.
+   * @param other (optional) If the "other" Blob size is greater than zero, then
+   * put it in the _meta packet and use segments for the file content (even if
+   * it is small). If the "other" Blob isNull() or the size is zero, then don't
+   * use it.
+   * @throws runtime_error if the file can't be mapped.
+   */
+  void
+  setObjectFromFile
+    (Namespace& nameSpace, const std::string& filePath,
+     const std::string& contentType, const ndn::Blob& other = ndn::Blob())
+  {
+    impl_->setObjectFromFile(nameSpace, filePath, contentType, other);
+  }
+
   /**
    * Get the number of outstanding interests which this maintains while fetching
    * segments (if the ContentMetaInfo hasSegments is true).
@@ -184,6 +210,45 @@ public:
     impl_->setMaxSegmentPayloadLength(maxSegmentPayloadLength);
   }
 
+  /**
+   * Get the number of threads used to make the segment packets (if the
+   * ContentMetaInfo hasSegments is true).
+   * @return The number of worker threads.
+   */
+  int
+  getNWorkerThreads() { return impl_->getNWorkerThreads(); }
+
+  /**
+   * Set the number of threads used to make the segment packets (if the
+   * ContentMetaInfo hasSegments is true). See
+   * SegmentStreamHandler::setNWorkerThreads.
+   * @param nWorkerThreads The number of worker threads.
+   * @throws runtime_error if nWorkerThreads is less than 1.
+   */
+  void
+  setNWorkerThreads(int nWorkerThreads)
+  {
+    impl_->setNWorkerThreads(nWorkerThreads);
+  }
+
+  /**
+   * Remove the callbacks that this handler added to its Namespace (including
+   * for fetching segments), detach it from the Namespace and set a new
+   * onGeneralizedObject callback, so that you can call setNamespace() to use
+   * this handler to fetch another object. This keeps settings such as the
+   * Interest pipeline size. If this handler is still fetching, then it will not
+   * call the previous onGeneralizedObject callback. GeneralizedObjectStreamHandler
+   * uses this to reuse a handler for each sequence number.
+   * @param onGeneralizedObject (optional) The new onGeneralizedObject callback
+   * as described in the constructor. If omitted, don't use a callback.
+   */
+  void
+  reset(const OnGeneralizedObject& onGeneralizedObject = OnGeneralizedObject())
+  {
+    impl_->reset(onGeneralizedObject);
+    detachNamespace();
+  }
+
   static const ndn::Name::Component&
   getNAME_COMPONENT_META() { return getValues().NAME_COMPONENT_META; }
 
@@ -211,11 +276,19 @@ private:
     void
     onNamespaceSet(Namespace* nameSpace);
 
+    void
+    reset(const OnGeneralizedObject& onGeneralizedObject);
+
     void
     setObject
       (Namespace& nameSpace, const ndn::Blob& object,
        const std::string& contentType, const ndn::Blob& other);
 
+    void
+    setObjectFromFile
+      (Namespace& nameSpace, const std::string& filePath,
+       const std::string& contentType, const ndn::Blob& other);
+
     int
     getInterestPipelineSize()
     {
@@ -258,7 +331,31 @@ private:
       segmentedObjectHandler_->setMaxSegmentPayloadLength(maxSegmentPayloadLength);
     }
 
+    int
+    getNWorkerThreads()
+    {
+      // Pass through to the SegmentedObjectHandler.
+      return segmentedObjectHandler_->getNWorkerThreads();
+    }
+
+    void
+    setNWorkerThreads(int nWorkerThreads)
+    {
+      // Pass through to the SegmentedObjectHandler.
+      segmentedObjectHandler_->setNWorkerThreads(nWorkerThreads);
+    }
+
   private:
+    /**
+     * Create the _meta packet as a child of the given Namespace.
+     * @param other If the size is greater than zero, put it in the "other"
+     * field.
+     */
+    void
+    setMetaInfo
+      (Namespace& nameSpace, const std::string& contentType, bool hasSegments,
+       const ndn::Blob& other);
+
     bool
     onObjectNeeded
       (Namespace& nameSpace, Namespace& neededNamespace, uint64_t callbackId);
@@ -289,6 +386,9 @@ private:
     int nComponentsAfterObjectNamespace_;
     uint64_t onObjectNeededId_;
     uint64_t onDeserializeNeededId_;
+    // True if segmentedObjectHandler_ is attached to a Namespace.
+    bool isFetchingSegments_;
+    uint64_t onSegmentedObjectId_;
   };
 
   /**
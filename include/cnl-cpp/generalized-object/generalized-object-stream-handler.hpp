@@ -22,6 +22,7 @@
 #ifndef NDN_GENERALIZED_OBJECT_STREAM_HANDLER_HPP
 #define NDN_GENERALIZED_OBJECT_STREAM_HANDLER_HPP
 
+#include <deque>
 #include "generalized-object-handler.hpp"
 
 namespace cnl_cpp {
@@ -186,6 +187,148 @@ public:
     impl_->setMaxSegmentPayloadLength(maxSegmentPayloadLength);
   }
 
+  /**
+   * Get the number of threads used to make the segment packets (if the
+   * ContentMetaInfo hasSegments is true for a particular generalized object).
+   * @return The number of worker threads.
+   */
+  int
+  getNWorkerThreads() { return impl_->getNWorkerThreads(); }
+
+  /**
+   * Set the number of threads used to make the segment packets (if the
+   * ContentMetaInfo hasSegments is true for a particular generalized object).
+   * See SegmentStreamHandler::setNWorkerThreads.
+   * @param nWorkerThreads The number of worker threads.
+   * @throws runtime_error if nWorkerThreads is less than 1.
+   */
+  void
+  setNWorkerThreads(int nWorkerThreads)
+  {
+    impl_->setNWorkerThreads(nWorkerThreads);
+  }
+
+  /**
+   * Get the maximum number of fetched objects to keep in the Namespace tree, as
+   * described in setMaxRetainedObjects.
+   * @return The maximum number of objects, or -1 for no limit.
+   */
+  int
+  getMaxRetainedObjects() { return impl_->getMaxRetainedObjects(); }
+
+  /**
+   * Set the maximum number of fetched objects to keep in the Namespace tree.
+   * After an object is supplied to the OnSequencedGeneralizedObject callback,
+   * it is retained under its sequence number node until the retention policy
+   * set by setMaxRetainedObjects, setRetentionPeriod and setMaxRetainedBytes
+   * removes the oldest supplied objects with Namespace.removeChild. This frees
+   * the Data packets, objects and callbacks under the sequence number node,
+   * so the application must not keep a reference to the objectNamespace
+   * given to the callback. Pruning is done after each object is supplied. For
+   * the retention period, pruning is also scheduled with callLater on the Face
+   * of the Namespace for when the oldest object expires, so that objects are
+   * removed even if no new object arrives. A removed sequence number is not
+   * fetched again.
+   * @param maxRetainedObjects The maximum number of objects to keep, or -1 for
+   * no limit (the default).
+   */
+  void
+  setMaxRetainedObjects(int maxRetainedObjects)
+  {
+    impl_->setMaxRetainedObjects(maxRetainedObjects);
+  }
+
+  /**
+   * Get the time period to keep a fetched object in the Namespace tree, as
+   * described in setRetentionPeriod.
+   * @return The retention period in milliseconds, or -1 for no limit.
+   */
+  ndn::Milliseconds
+  getRetentionPeriod() { return impl_->getRetentionPeriod(); }
+
+  /**
+   * Set the time period to keep a fetched object in the Namespace tree after
+   * it is supplied to the OnSequencedGeneralizedObject callback. See
+   * setMaxRetainedObjects for details.
+   * @param retentionPeriod The retention period in milliseconds, or -1 for no
+   * limit (the default).
+   */
+  void
+  setRetentionPeriod(ndn::Milliseconds retentionPeriod)
+  {
+    impl_->setRetentionPeriod(retentionPeriod);
+  }
+
+  /**
+   * Get the maximum number of bytes of fetched objects to keep in the
+   * Namespace tree, as described in setMaxRetainedBytes.
+   * @return The maximum number of bytes, or 0 for no limit.
+   */
+  size_t
+  getMaxRetainedBytes() { return impl_->getMaxRetainedBytes(); }
+
+  /**
+   * Set the maximum number of bytes of fetched objects to keep in the
+   * Namespace tree. The size of an object is the size of the encoding of its
+   * Data packets plus the size of the assembled object. See
+   * setMaxRetainedObjects for details.
+   * @param maxRetainedBytes The maximum number of bytes, or 0 for no limit
+   * (the default).
+   */
+  void
+  setMaxRetainedBytes(size_t maxRetainedBytes)
+  {
+    impl_->setMaxRetainedBytes(maxRetainedBytes);
+  }
+
+  /**
+   * Get the maximum number of published objects to keep in the Namespace tree,
+   * as described in setMaxPublishedObjects.
+   * @return The maximum number of objects, or -1 for no limit.
+   */
+  int
+  getMaxPublishedObjects() { return impl_->getMaxPublishedObjects(); }
+
+  /**
+   * Set the maximum number of published objects to keep in the Namespace tree,
+   * so that the producer keeps a ring buffer of the last objects. When
+   * setObject publishes a new object, it removes the oldest published objects
+   * with Namespace.removeChild (along with their pending Interests) until the
+   * objects are within the limits set by setMaxPublishedObjects and
+   * setMaxPublishedBytes. The newest object is always kept. When a limit is
+   * set, producing a new _latest packet also removes the previous _latest
+   * versions. This does a constant amount of work per published object so that
+   * a producer can run indefinitely with bounded memory.
+   * @param maxPublishedObjects The maximum number of objects to keep, or -1 for
+   * no limit (the default).
+   */
+  void
+  setMaxPublishedObjects(int maxPublishedObjects)
+  {
+    impl_->setMaxPublishedObjects(maxPublishedObjects);
+  }
+
+  /**
+   * Get the maximum number of bytes of published objects to keep in the
+   * Namespace tree, as described in setMaxPublishedBytes.
+   * @return The maximum number of bytes, or 0 for no limit.
+   */
+  size_t
+  getMaxPublishedBytes() { return impl_->getMaxPublishedBytes(); }
+
+  /**
+   * Set the maximum number of bytes of published objects to keep in the
+   * Namespace tree. The size of an object is the size of the object and other
+   * Blobs given to setObject. See setMaxPublishedObjects for details.
+   * @param maxPublishedBytes The maximum number of bytes, or 0 for no limit
+   * (the default).
+   */
+  void
+  setMaxPublishedBytes(size_t maxPublishedBytes)
+  {
+    impl_->setMaxPublishedBytes(maxPublishedBytes);
+  }
+
   static const ndn::Name::Component&
   getNAME_COMPONENT_LATEST() { return getValues().NAME_COMPONENT_LATEST; }
 
@@ -246,10 +389,98 @@ private:
       generalizedObjectHandler_.setMaxSegmentPayloadLength(maxSegmentPayloadLength);
     }
 
+    int
+    getNWorkerThreads()
+    {
+      // Pass through to the GeneralizedObjectHandler.
+      return generalizedObjectHandler_.getNWorkerThreads();
+    }
+
+    void
+    setNWorkerThreads(int nWorkerThreads)
+    {
+      // Pass through to the GeneralizedObjectHandler.
+      generalizedObjectHandler_.setNWorkerThreads(nWorkerThreads);
+    }
+
+    int
+    getMaxRetainedObjects() { return maxRetainedObjects_; }
+
+    void
+    setMaxRetainedObjects(int maxRetainedObjects)
+    {
+      maxRetainedObjects_ = maxRetainedObjects;
+    }
+
+    ndn::Milliseconds
+    getRetentionPeriod() { return retentionPeriod_; }
+
+    void
+    setRetentionPeriod(ndn::Milliseconds retentionPeriod)
+    {
+      retentionPeriod_ = retentionPeriod;
+    }
+
+    size_t
+    getMaxRetainedBytes() { return maxRetainedBytes_; }
+
+    void
+    setMaxRetainedBytes(size_t maxRetainedBytes)
+    {
+      maxRetainedBytes_ = maxRetainedBytes;
+    }
+
+    int
+    getMaxPublishedObjects() { return maxPublishedObjects_; }
+
+    void
+    setMaxPublishedObjects(int maxPublishedObjects)
+    {
+      maxPublishedObjects_ = maxPublishedObjects;
+    }
+
+    size_t
+    getMaxPublishedBytes() { return maxPublishedBytes_; }
+
+    void
+    setMaxPublishedBytes(size_t maxPublishedBytes)
+    {
+      maxPublishedBytes_ = maxPublishedBytes;
+    }
+
     void
     onNamespaceSet(Namespace* nameSpace);
 
   private:
+    /**
+     * A RetainedObject holds the sequence number and size of an object which
+     * was supplied to the application (or published) and is still in the
+     * Namespace tree.
+     */
+    class RetainedObject {
+    public:
+      RetainedObject
+        (int sequenceNumber, ndn::MillisecondsSince1970 addedTime,
+         size_t nBytes)
+      : sequenceNumber_(sequenceNumber), addedTime_(addedTime),
+        nBytes_(nBytes)
+      {}
+
+      int
+      getSequenceNumber() const { return sequenceNumber_; }
+
+      ndn::MillisecondsSince1970
+      getAddedTime() const { return addedTime_; }
+
+      size_t
+      getNBytes() const { return nBytes_; }
+
+    private:
+      int sequenceNumber_;
+      ndn::MillisecondsSince1970 addedTime_;
+      size_t nBytes_;
+    };
+
     /**
      * This is called for object needed at the Handler's namespace. If
      * neededNamespace is the Handler's Namespace (called by the appliction),
@@ -286,6 +517,83 @@ private:
     void
     requestNewSequenceNumbers();
 
+    /**
+     * Get a GeneralizedObjectHandler from freeHandlers_ (or make a new one),
+     * attach it to the Namespace to fetch the sequence number and add it to
+     * activeHandlers_.
+     * @param sequenceNamespace The Namespace node for the sequence number.
+     * @param sequenceNumber The sequence number.
+     */
+    void
+    attachHandler(Namespace& sequenceNamespace, int sequenceNumber);
+
+    /**
+     * Reset the GeneralizedObjectHandler for the sequence number to remove its
+     * callbacks, remove it from activeHandlers_ and put it in freeHandlers_ to
+     * reuse.
+     * @param sequenceNumber The sequence number.
+     */
+    void
+    releaseHandler(int sequenceNumber);
+
+    /**
+     * Call releaseHandler for the active handlers with a sequence number less
+     * than minSequenceNumber, which we don't expect to finish.
+     * @param minSequenceNumber The minimum sequence number to keep.
+     */
+    void
+    releaseStaleHandlers(int minSequenceNumber);
+
+    /**
+     * This is called after the object is supplied to the application. Release
+     * its handler, add it to retainedObjects_ and prune the retained objects.
+     * @param sequenceNumber The sequence number of the supplied object.
+     */
+    void
+    onObjectSupplied(int sequenceNumber);
+
+    /**
+     * Remove the oldest objects in retainedObjects_ from the Namespace tree
+     * until they are within the limits of the retention policy. Then, if there
+     * is a retention period, schedule onPruneTimeout for when the oldest
+     * remaining object expires.
+     */
+    void
+    pruneRetainedObjects();
+
+    /**
+     * This is called by callLater from pruneRetainedObjects.
+     */
+    void
+    onPruneTimeout();
+
+    /**
+     * Check if the sequence number is for an object that was removed by
+     * pruneRetainedObjects, so that it should not be fetched again.
+     */
+    bool
+    isPruned(int sequenceNumber)
+    {
+      return sequenceNumber <= maxPrunedSequenceNumber_;
+    }
+
+    /**
+     * Remove the oldest objects in publishedObjects_ from the Namespace tree
+     * until they are within maxPublishedObjects_ and maxPublishedBytes_,
+     * keeping at least the newest.
+     */
+    void
+    evictPublishedObjects();
+
+    /**
+     * Check if the producer keeps a ring buffer of published objects.
+     */
+    bool
+    hasPublishLimit()
+    {
+      return maxPublishedObjects_ >= 0 || maxPublishedBytes_ > 0;
+    }
+
     OnSequencedGeneralizedObject onSequencedGeneralizedObject_;
     Namespace* namespace_;
     Namespace* latestNamespace_;
@@ -297,6 +605,28 @@ private:
     int maxRequestedSequenceNumber_;
     int nReportedSequenceNumbers_;
     int maxReportedSequenceNumber_;
+    // The key is the sequence number. The value is the handler fetching it.
+    std::map<int, ndn::ptr_lib::shared_ptr<GeneralizedObjectHandler>>
+      activeHandlers_;
+    // The detached handlers to reuse, up to pipelineSize_ + 1.
+    std::vector<ndn::ptr_lib::shared_ptr<GeneralizedObjectHandler>>
+      freeHandlers_;
+    int maxRetainedObjects_;
+    ndn::Milliseconds retentionPeriod_;
+    size_t maxRetainedBytes_;
+    // The supplied objects still in the tree, in the order supplied.
+    std::deque<RetainedObject> retainedObjects_;
+    size_t nRetainedBytes_;
+    // True while onPruneTimeout is scheduled.
+    bool isPruneScheduled_;
+    int maxPrunedSequenceNumber_;
+    int maxPublishedObjects_;
+    size_t maxPublishedBytes_;
+    // The published objects still in the tree, in the order published.
+    std::deque<RetainedObject> publishedObjects_;
+    size_t nPublishedBytes_;
+    // The version component of the last produced _latest packet, or empty.
+    ndn::Name::Component latestVersionComponent_;
   };
 
   /**
@@ -23,6 +23,7 @@
 #define CNL_CPP_NAMESPACE_HPP
 
 #include <map>
+#include <deque>
 #include <ndn-cpp/face.hpp>
 #ifdef NDN_CPP_HAVE_BOOST_ASIO
 #include <boost/atomic.hpp>
@@ -68,6 +69,8 @@ enum NamespaceValidateState {
 };
 
 class PendingIncomingInterestTable;
+class NamespaceNodePool;
+class RttEstimator;
 
 /**
  * Namespace is the main class that represents the name tree and related
@@ -88,6 +91,40 @@ public:
     (Namespace& nameSpace, Namespace& neededNamespace,
      uint64_t callbackId)> OnObjectNeeded;
 
+  /**
+   * A StateChange holds a Namespace node and its new state, as given to an
+   * OnStateChangedBatch callback.
+   */
+  class StateChange {
+  public:
+    StateChange(Namespace* changedNamespace, NamespaceState state)
+    : changedNamespace_(changedNamespace), state_(state)
+    {}
+
+    /**
+     * Get the Namespace node whose state changed.
+     * @return The changed Namespace node.
+     */
+    Namespace&
+    getChangedNamespace() const { return *changedNamespace_; }
+
+    /**
+     * Get the new state. (This may be different than
+     * getChangedNamespace().getState() if the state changed again.)
+     * @return The new state.
+     */
+    NamespaceState
+    getState() const { return state_; }
+
+  private:
+    Namespace* changedNamespace_;
+    NamespaceState state_;
+  };
+
+  typedef ndn::func_lib::function<void
+    (Namespace& nameSpace, const std::vector<StateChange>& changes,
+     uint64_t callbackId)> OnStateChangedBatch;
+
   class Impl;
 
   /**
@@ -142,6 +179,14 @@ public:
     virtual void
     onNamespaceSet();
 
+    /**
+     * Detach this Handler from its Namespace so that setNamespace() can attach
+     * it to another Namespace. A subclass which can be reused should first
+     * remove the callbacks that it added to the Namespace.
+     */
+    void
+    detachNamespace() { namespace_ = 0; }
+
   private:
     // Disable the copy constructor and assignment operator.
     Handler(const Handler& other);
@@ -170,13 +215,24 @@ public:
   /**
    * Get the name of this node in the name tree. This includes the name
    * components of parent nodes. To get the name component of just this node,
-   * use getName()[-1].
+   * use getNameComponent(). A child node only stores its own name component.
+   * If the node has a Data packet, this returns the Data packet's name.
+   * Otherwise the first call to getName() makes the full name and keeps it.
    * @return The name of this namespace. NOTE: You must not change the name -
    * if you need to change it then make a copy.
    */
   const ndn::Name&
   getName() const { return impl_->getName(); }
 
+  /**
+   * Get the name component of just this node, which is the same as
+   * getName()[-1] but doesn't need to make the full name.
+   * @return The name component of this node. If this is the root node and its
+   * name is empty, return an empty name component.
+   */
+  const ndn::Name::Component&
+  getNameComponent() const { return impl_->getNameComponent(); }
+
   /**
    * Get the parent namespace.
    * @return The parent namespace, or null if this is the root of the tree.
@@ -306,6 +362,28 @@ public:
   ndn::ptr_lib::shared_ptr<std::vector<ndn::Name::Component>>
   getChildComponents() { return impl_->getChildComponents(); }
 
+  /**
+   * Remove the child with the given name component and all of its descendants
+   * from the tree, releasing their Data packets and objects. This is used to
+   * bound memory, for example after a segment is written to storage. The
+   * removed nodes are shut down, so a remaining reference to one of them will
+   * no longer change the tree. Do not call this to remove a node (or an
+   * ancestor of a node) whose callback is currently executing. If there is no
+   * such child, do nothing.
+   * @param component The name component of the child.
+   * @param removePendingInterests (optional) If true, also remove the pending
+   * incoming Interests under the name of the child, for example when the child
+   * is a published object which is evicted and will not be produced again. If
+   * false, keep them so that a Data packet which is set later for the name can
+   * still satisfy them. If omitted, use false.
+   */
+  void
+  removeChild
+    (const ndn::Name::Component& component, bool removePendingInterests = false)
+  {
+    impl_->removeChild(component, removePendingInterests);
+  }
+
   /**
    * Prepare Data packets for the object.
    * However, if getIsShutDown() then do nothing.
@@ -353,8 +431,8 @@ public:
   getData() { return impl_->getData(); }
 
   /**
-   * Recursively append to the Data packets for this and children nodes to the
-   * given list.
+   * Append the Data packets for this and children nodes to the given list, in
+   * the canonical order of their names.
    * @param dataList Append the Data packets to this list. This does not first
    * clear the list. You should not modify the returned Data packets. If you
    * need to modify one, then make a copy.
@@ -412,9 +490,84 @@ public:
   uint64_t
   addOnStateChanged(const OnStateChanged& onStateChanged)
   {
-    return impl_->addOnStateChanged(onStateChanged);
+    return impl_->addOnStateChanged(onStateChanged, 0xffffffff, 0, -1, -1);
+  }
+
+  /**
+   * Add an onStateChanged callback which is only called for the given states
+   * of the nodes at the given depths below this node. This is the same as
+   * addOnStateChanged(onStateChanged) except that the changes which don't
+   * match are filtered out before calling any callbacks. This node keeps an
+   * index of its callbacks by state, so that a change only visits the callbacks
+   * for its state. An application with many handlers in the same tree should
+   * use this to avoid calling every callback for every state change below it.
+   * @param onStateChanged The callback as described in
+   * addOnStateChanged(onStateChanged).
+   * @param stateMask The bitwise OR of getStateMask(state) for the states for
+   * which to call onStateChanged.
+   * @param minDepth The minimum depth of changedNamespace relative to this
+   * node, where 0 is this node, 1 is a child, etc.
+   * @param maxDepth (optional) The maximum depth of changedNamespace relative
+   * to this node, or -1 for no maximum. If omitted, use -1.
+   * @param componentType (optional) If not -1, only call onStateChanged if the
+   * type of the last name component of changedNamespace is this
+   * ndn_NameComponentType. (Note that a component such as a segment number
+   * may be encoded with a generic type using a marker, so check the naming
+   * convention before filtering by type.) If omitted, use -1.
+   * @return The callback ID which you can use in removeCallback().
+   */
+  uint64_t
+  addOnStateChanged
+    (const OnStateChanged& onStateChanged, uint32_t stateMask, int minDepth,
+     int maxDepth = -1, int componentType = -1)
+  {
+    return impl_->addOnStateChanged
+      (onStateChanged, stateMask, minDepth, maxDepth, componentType);
+  }
+
+  /**
+   * Add an onStateChangedBatch callback. This is like addOnStateChanged except
+   * that, instead of calling a callback for each state change, this collects
+   * the state changes during one pass of the event loop and calls the callback
+   * once with all of them, in the order that they happened. The callback is
+   * called from the Face with face.callLater(0, ...), so this node or a parent
+   * must have a Face (otherwise the callback is called for each change). If a
+   * child node is removed with removeChild, the collected changes are supplied
+   * first so that the callback doesn't see a removed node.
+   * @param onStateChangedBatch This calls
+   * onStateChangedBatch(namespace, changes, callbackId) where namespace is this
+   * Namespace, changes is the list of StateChange in the order that they
+   * happened, and callbackId is the callback ID returned by this method. The
+   * changes list is only valid during the callback.
+   * NOTE: The library will log any exceptions thrown by this callback, but for
+   * better error handling the callback should catch and properly handle any
+   * exceptions.
+   * @param stateMask (optional) The bitwise OR of getStateMask(state) for the
+   * states to collect. If omitted, collect all states.
+   * @param minDepth (optional) The minimum depth of the changed node relative
+   * to this node, where 0 is this node. If omitted, use 0.
+   * @param maxDepth (optional) The maximum depth of the changed node relative
+   * to this node, or -1 for no maximum. If omitted, use -1.
+   * @return The callback ID which you can use in removeCallback(). (Removing
+   * the callback discards the changes which are not yet supplied.)
+   */
+  uint64_t
+  addOnStateChangedBatch
+    (const OnStateChangedBatch& onStateChangedBatch,
+     uint32_t stateMask = 0xffffffff, int minDepth = 0, int maxDepth = -1)
+  {
+    return impl_->addOnStateChangedBatch
+      (onStateChangedBatch, stateMask, minDepth, maxDepth);
   }
 
+  /**
+   * Get the bit for the state, to use in the stateMask for addOnStateChanged.
+   * @param state The NamespaceState.
+   * @return The bit for the state.
+   */
+  static uint32_t
+  getStateMask(NamespaceState state) { return (uint32_t)1 << (int)state; }
+
   /**
    * Add an onValidateStateChanged callback. When the validate state changes in
    * this namespace at this node or any children, this calls
@@ -560,6 +713,20 @@ public:
   void
   objectNeeded(bool mustBeFresh = false) { impl_->objectNeeded(mustBeFresh); }
 
+  /**
+   * Do the same as objectNeeded(), but if this expresses an Interest, append
+   * the implicit SHA-256 digest to the Interest name so that only the Data
+   * packet with that digest matches. This method name has an underscore
+   * because is normally only called from a Handler, not from the application.
+   * @param implicitDigest The implicit SHA-256 digest of the expected Data
+   * packet.
+   */
+  void
+  objectNeededWithDigest_(const ndn::Blob& implicitDigest)
+  {
+    impl_->objectNeeded(false, implicitDigest);
+  }
+
   /**
    * Set the maximum lifetime for re-expressed interests to be used when this or
    * a child node calls expressInterest. You can call this on a child node to
@@ -573,6 +740,130 @@ public:
     impl_->setMaxInterestLifetime(maxInterestLifetime);
   }
 
+  /**
+   * Set the maximum number of pending incoming Interests which are waiting for
+   * a Data packet. All nodes in the Namespace tree share one pending Interest
+   * table in the root node, so this sets the capacity for the whole tree. When
+   * a new Interest would exceed this, the oldest pending Interest is evicted.
+   * If the table already has more entries, this evicts the oldest now. If you
+   * don't set this, the default is 10000.
+   * @param maxPendingIncomingInterests The maximum number of pending incoming
+   * Interests, or 0 for no limit.
+   */
+  void
+  setMaxPendingIncomingInterests(size_t maxPendingIncomingInterests)
+  {
+    impl_->setMaxPendingIncomingInterests(maxPendingIncomingInterests);
+  }
+
+  /**
+   * Get the maximum number of pending incoming Interests, as set by
+   * setMaxPendingIncomingInterests.
+   * @return The maximum number of pending incoming Interests, or 0 for no
+   * limit.
+   */
+  size_t
+  getMaxPendingIncomingInterests()
+  {
+    return impl_->getMaxPendingIncomingInterests();
+  }
+
+  /**
+   * Get the number of incoming Interests in the Namespace tree which are
+   * waiting for a Data packet. Aggregated Interests with the same name and
+   * selectors count once.
+   * @return The number of pending incoming Interests, or 0 if setFace has not
+   * been called with an onRegisterFailed callback.
+   */
+  size_t
+  getPendingIncomingInterestCount()
+  {
+    return impl_->getPendingIncomingInterestCount();
+  }
+
+  /**
+   * Get the number of pending incoming Interests in the Namespace tree which
+   * were satisfied by a Data packet.
+   * @return The number of hits.
+   */
+  uint64_t
+  getPendingIncomingInterestHitCount()
+  {
+    return impl_->getPendingIncomingInterestHitCount();
+  }
+
+  /**
+   * Get the number of pending incoming Interests in the Namespace tree which
+   * were removed because they timed out.
+   * @return The number of expirations.
+   */
+  uint64_t
+  getPendingIncomingInterestExpirationCount()
+  {
+    return impl_->getPendingIncomingInterestExpirationCount();
+  }
+
+  /**
+   * Get the number of pending incoming Interests in the Namespace tree which
+   * were evicted because the table was full. See
+   * setMaxPendingIncomingInterests.
+   * @return The number of evictions.
+   */
+  uint64_t
+  getPendingIncomingInterestEvictionCount()
+  {
+    return impl_->getPendingIncomingInterestEvictionCount();
+  }
+
+  /**
+   * Get the number of incoming Interests in the Namespace tree which were
+   * aggregated with a pending Interest with the same name and selectors.
+   * @return The number of aggregated Interests.
+   */
+  uint64_t
+  getPendingIncomingInterestAggregationCount()
+  {
+    return impl_->getPendingIncomingInterestAggregationCount();
+  }
+
+  /**
+   * Enable or disable estimating the round-trip time of Interests expressed by
+   * this and child nodes. If enabled, objectNeeded uses the retransmission
+   * timeout (RTO) from the estimate as the Interest lifetime (instead of 4000
+   * milliseconds). If the Interest times out, this doubles the RTO and
+   * retransmits only that Interest until the total time reaches
+   * getMaxInterestLifetime(). A child node which enables this has its own
+   * estimate, separate from the parent.
+   * @param enabled True to enable an estimate for this node, false to remove
+   * the estimate from this node (so that a child uses the parent's estimate,
+   * if any).
+   */
+  void
+  setRttEstimation(bool enabled) { impl_->setRttEstimation(enabled); }
+
+  /**
+   * Get the retransmission timeout from the RTT estimate of this or a parent
+   * node, as set by setRttEstimation.
+   * @return The RTO in milliseconds, or -1 if RTT estimation is not enabled for
+   * this or a parent node.
+   */
+  ndn::Milliseconds
+  getRetransmissionTimeout() { return impl_->getRetransmissionTimeout(); }
+
+  /**
+   * Check if objectNeeded retransmitted the Interest for this node after the
+   * RTO (see setRttEstimation). In this case, the time from the first Interest
+   * to the Data packet is not a valid RTT sample since we can't tell which
+   * Interest the Data packet answers. This method name has an underscore
+   * because is normally only called from a Handler, not from the application.
+   * @return True if the Interest was retransmitted.
+   */
+  bool
+  getIsInterestRetransmitted_()
+  {
+    return impl_->getIsInterestRetransmitted_();
+  }
+
   /**
    * Remove the callback with the given callbackId. This does not search for the
    * callbackId in child nodes. If the callbackId isn't found, do nothing.
@@ -709,18 +1000,40 @@ public:
   class Impl : public ndn::ptr_lib::enable_shared_from_this<Impl> {
   public:
     /**
-     * Create a new Impl, which should belong to a shared_ptr.
+     * Create a new Impl for the root node, which should belong to a shared_ptr.
      * @param outerNamespace The Namespace which is creating this inner Imp.
      * @param name See the Namespace constructor.
-     * @param isShutDown The isShutDown flag from the root (or a new bool(false)
-     * if this is the root).
+     * @param isShutDown A new bool(false) for the isShutDown flag.
      */
     Impl
       (Namespace& outerNamespace, const ndn::Name& name, ndn::KeyChain* keyChain,
        const ndn::ptr_lib::shared_ptr<bool>& isShutDown);
 
+    /**
+     * Create a new Impl for a child node, which should belong to a shared_ptr.
+     * @param outerNamespace The Namespace which is creating this inner Imp.
+     * @param parent The Impl of the parent node.
+     * @param component The name component of the child.
+     * @param isShutDown The isShutDown flag from the root.
+     */
+    Impl
+      (Namespace& outerNamespace, Namespace::Impl* parent,
+       const ndn::Name::Component& component,
+       const ndn::ptr_lib::shared_ptr<bool>& isShutDown);
+
     const ndn::Name&
-    getName() const { return name_; }
+    getName() const;
+
+    /**
+     * Make the full name of this node from the name component of this and
+     * each parent, without keeping it in the node like getName() does.
+     * @return A new Name.
+     */
+    ndn::Name
+    makeName() const;
+
+    const ndn::Name::Component&
+    getNameComponent() const { return component_; }
 
     Namespace*
     getParent();
@@ -749,7 +1062,7 @@ public:
     bool
     hasChild(const ndn::Name::Component& component) const
     {
-      return children_.find(component) != children_.end();
+      return children_.find(component) != 0;
     }
 
     bool
@@ -758,10 +1071,9 @@ public:
     Namespace&
     getChild(const ndn::Name::Component& component)
     {
-      std::map<ndn::Name::Component, ndn::ptr_lib::shared_ptr<Namespace>>::iterator
-        child = children_.find(component);
-      if (child != children_.end())
-        return *child->second;
+      Namespace* child = children_.find(component);
+      if (child)
+        return *child;
       else
         return createChild(component, true);
     }
@@ -775,6 +1087,18 @@ public:
     Namespace::Impl&
     getChildImpl(const ndn::Name& descendantName);
 
+    /**
+     * Find the deepest existing descendant node whose name is a prefix of the
+     * descendantName, without creating nodes.
+     * @param descendantName The name, which must have the name of this node as
+     * a prefix.
+     * @return The deepest existing node. If its nameSize_ equals
+     * descendantName.size(), then it is the node for descendantName. If no
+     * child matches, return this node.
+     */
+    Namespace::Impl*
+    findDeepestImpl(const ndn::Name& descendantName);
+
     ndn::ptr_lib::shared_ptr<std::vector<ndn::Name::Component>>
     getChildComponents();
 
@@ -794,7 +1118,14 @@ public:
     getObject() { return object_; }
 
     uint64_t
-    addOnStateChanged(const OnStateChanged& onStateChanged);
+    addOnStateChanged
+      (const OnStateChanged& onStateChanged, uint32_t stateMask, int minDepth,
+       int maxDepth, int componentType);
+
+    uint64_t
+    addOnStateChangedBatch
+      (const OnStateChangedBatch& onStateChangedBatch, uint32_t stateMask,
+       int minDepth, int maxDepth);
 
     uint64_t
     addOnValidateStateChanged
@@ -834,7 +1165,7 @@ public:
     getSyncNode();
 
     void
-    objectNeeded(bool mustBeFresh);
+    objectNeeded(bool mustBeFresh, const ndn::Blob& implicitDigest = ndn::Blob());
 
     void
     setMaxInterestLifetime(ndn::Milliseconds maxInterestLifetime)
@@ -843,15 +1174,44 @@ public:
     }
 
     void
-    removeCallback(uint64_t callbackId);
+    setMaxPendingIncomingInterests(size_t maxPendingIncomingInterests);
 
-    void
-    experimentalClear()
+    size_t
+    getMaxPendingIncomingInterests()
     {
-      object_.reset();
-      children_.clear();
+      return root_->maxPendingIncomingInterests_;
     }
 
+    size_t
+    getPendingIncomingInterestCount();
+
+    uint64_t
+    getPendingIncomingInterestHitCount();
+
+    uint64_t
+    getPendingIncomingInterestExpirationCount();
+
+    uint64_t
+    getPendingIncomingInterestEvictionCount();
+
+    uint64_t
+    getPendingIncomingInterestAggregationCount();
+
+    void
+    setRttEstimation(bool enabled);
+
+    ndn::Milliseconds
+    getRetransmissionTimeout();
+
+    bool
+    getIsInterestRetransmitted_() { return isInterestRetransmitted_; }
+
+    void
+    removeCallback(uint64_t callbackId);
+
+    void
+    experimentalClear();
+
     void
     shutdown();
 
@@ -882,7 +1242,345 @@ public:
       setState(NamespaceState_OBJECT_READY);
     }
 
+    /**
+     * Remove the child with the given name component and its descendants from
+     * the tree, and remove their Data packets from the root node's index. The
+     * removed nodes are shut down so that a remaining reference to one of them
+     * will not change the tree. If there is no such child, do nothing.
+     * @param component The name component of the child.
+     */
+    void
+    removeChild
+      (const ndn::Name::Component& component, bool removePendingInterests);
+
   private:
+    /**
+     * ChildList holds the child nodes of a Namespace node. A child whose name
+     * component is a segment or sequence number (whichever type is added first)
+     * is held in a dense array indexed by the number, so that finding a segment
+     * is a constant-time index instead of a search. The dense array only covers
+     * a contiguous range of numbers (allowing small gaps), and other children
+     * are held in a vector sorted by the name component of the child. Compared
+     * to a std::map, this doesn't allocate a tree node for each child and keeps
+     * the children contiguous in memory. Most nodes have only a few other
+     * children, which are searched with a linear scan. Otherwise this uses a
+     * binary search.
+     */
+    class ChildList {
+    public:
+      ChildList()
+      : denseType_(DENSE_NONE), denseOffset_(0), nDenseChildren_(0)
+      {}
+
+      /**
+       * Find the child with the given name component.
+       * @param component The name component of the child.
+       * @return The child, or null if not found.
+       */
+      Namespace*
+      find(const ndn::Name::Component& component) const;
+
+      /**
+       * Insert the child. This should only be called if a child with the name
+       * component does not already exist. If the child sorts after all
+       * existing children, this simply appends.
+       * @param child The child to insert.
+       */
+      void
+      insert(const ndn::ptr_lib::shared_ptr<Namespace>& child);
+
+      /**
+       * Remove the child with the given name component.
+       * @param component The name component of the child.
+       * @return The removed child, or null if not found.
+       */
+      ndn::ptr_lib::shared_ptr<Namespace>
+      remove(const ndn::Name::Component& component);
+
+      /**
+       * Append all the children to the list, sorted by name component.
+       * @param children Append the children to this list. This does not first
+       * clear the list.
+       */
+      void
+      getChildren(std::vector<Namespace*>& children) const;
+
+      /**
+       * Call visit(child) for each child, sorted by name component, until
+       * visit returns false. The visit function must not add or remove
+       * children.
+       * @param visit The function to call for each child.
+       * @return False if a call to visit returned false, otherwise true.
+       */
+      bool
+      forEach
+        (const ndn::func_lib::function<bool(Namespace& child)>& visit) const;
+
+      size_t
+      size() const { return sortedChildren_.size() + nDenseChildren_; }
+
+      void
+      clear()
+      {
+        sortedChildren_.clear();
+        denseChildren_.clear();
+        denseType_ = DENSE_NONE;
+        denseOffset_ = 0;
+        nDenseChildren_ = 0;
+      }
+
+    private:
+      enum DenseType {
+        DENSE_NONE,
+        DENSE_SEGMENT,
+        DENSE_SEQUENCE_NUMBER
+      };
+
+      /**
+       * Get the name component of the child, which is the key for sorting.
+       */
+      static const ndn::Name::Component&
+      getComponent(const ndn::ptr_lib::shared_ptr<Namespace>& child)
+      {
+        return child->impl_->component_;
+      }
+
+      /**
+       * Check if the name component of the child is less than the component,
+       * for use with std::lower_bound.
+       */
+      static bool
+      isLessThan
+        (const ndn::ptr_lib::shared_ptr<Namespace>& child,
+         const ndn::Name::Component& component)
+      {
+        return getComponent(child).compare(component) < 0;
+      }
+
+      /**
+       * Check if the component has the type held in denseChildren_.
+       */
+      bool
+      isDenseType(const ndn::Name::Component& component) const
+      {
+        return (denseType_ == DENSE_SEGMENT && component.isSegment()) ||
+               (denseType_ == DENSE_SEQUENCE_NUMBER &&
+                component.isSequenceNumber());
+      }
+
+      /**
+       * Get the number of the component, which must have the type held in
+       * denseChildren_.
+       */
+      uint64_t
+      getDenseNumber(const ndn::Name::Component& component) const
+      {
+        return denseType_ == DENSE_SEGMENT ?
+          component.toSegment() : component.toSequenceNumber();
+      }
+
+      /**
+       * Put the child in denseChildren_ at the index for the number, if this
+       * doesn't extend the dense range by more than maxDenseGap_.
+       * @return True if the child was added, false if the number is too far
+       * outside the dense range.
+       */
+      bool
+      insertDense
+        (uint64_t number, const ndn::ptr_lib::shared_ptr<Namespace>& child);
+
+      // Search lists up to this size with a linear scan.
+      static const size_t maxLinearSearchSize_ = 8;
+      // The maximum number of empty entries to add when extending the dense range.
+      static const uint64_t maxDenseGap_ = 64;
+      std::vector<ndn::ptr_lib::shared_ptr<Namespace>> sortedChildren_;
+      // The entry at index i is the child with number denseOffset_ + i, or null.
+      std::deque<ndn::ptr_lib::shared_ptr<Namespace>> denseChildren_;
+      DenseType denseType_;
+      uint64_t denseOffset_;
+      size_t nDenseChildren_;
+    };
+
+    /**
+     * NamePtrLess compares the Names that the pointers point to, so that a
+     * map can be keyed by the Name already held by a Data packet without
+     * making a copy.
+     */
+    class NamePtrLess {
+    public:
+      bool
+      operator()(const ndn::Name* name1, const ndn::Name* name2) const
+      {
+        return name1->compare(*name2) < 0;
+      }
+    };
+
+    typedef std::map<const ndn::Name*, Namespace::Impl*, NamePtrLess> DataIndex;
+
+    /**
+     * A StateChangedEntry holds an OnStateChanged callback and the filter given
+     * to addOnStateChanged.
+     */
+    class StateChangedEntry {
+    public:
+      StateChangedEntry
+        (const OnStateChanged& onStateChanged, uint32_t stateMask, int minDepth,
+         int maxDepth, int componentType)
+      : onStateChanged_(onStateChanged), stateMask_(stateMask),
+        minDepth_(minDepth), maxDepth_(maxDepth), componentType_(componentType)
+      {}
+
+      const OnStateChanged&
+      getOnStateChanged() const { return onStateChanged_; }
+
+      uint32_t
+      getStateMask() const { return stateMask_; }
+
+      /**
+       * Check if the changed node matches the depth and component type filter.
+       * (The state is already checked by the index.)
+       * @param changedNamespace The node whose state changed.
+       * @param depth The depth of changedNamespace relative to the node with
+       * this callback.
+       * @return True if the callback should be called.
+       */
+      bool
+      matches(Namespace& changedNamespace, int depth) const
+      {
+        if (depth < minDepth_ || (maxDepth_ >= 0 && depth > maxDepth_))
+          return false;
+        if (componentType_ >= 0) {
+          // Use the stored component so that we don't make the full name. The
+          // root node has no name component.
+          if (!changedNamespace.getParent() ||
+              (int)changedNamespace.getNameComponent().getType() !=
+                componentType_)
+            return false;
+        }
+
+        return true;
+      }
+
+    private:
+      OnStateChanged onStateChanged_;
+      uint32_t stateMask_;
+      int minDepth_;
+      int maxDepth_;
+      int componentType_;
+    };
+
+    /**
+     * A StateChangedBatch collects the state changes for an OnStateChangedBatch
+     * callback and schedules flush() to supply them at the end of the event
+     * loop pass.
+     */
+    class StateChangedBatch
+      : public ndn::ptr_lib::enable_shared_from_this<StateChangedBatch> {
+    public:
+      StateChangedBatch
+        (const OnStateChangedBatch& onStateChangedBatch, uint64_t callbackId)
+      : onStateChangedBatch_(onStateChangedBatch), callbackId_(callbackId),
+        onStateChangedId_(0), isFlushScheduled_(false), isRemoved_(false)
+      {}
+
+      /**
+       * This is the OnStateChanged callback to add the change to the batch.
+       */
+      void
+      onStateChanged
+        (Namespace& nameSpace, Namespace& changedNamespace,
+         NamespaceState state);
+
+      /**
+       * Call the OnStateChangedBatch callback with the collected changes, if
+       * any.
+       */
+      void
+      flush();
+
+      /**
+       * Discard the collected changes and don't call the callback again.
+       */
+      void
+      remove()
+      {
+        isRemoved_ = true;
+        changes_.clear();
+      }
+
+      uint64_t
+      getOnStateChangedId() const { return onStateChangedId_; }
+
+      void
+      setOnStateChangedId(uint64_t onStateChangedId)
+      {
+        onStateChangedId_ = onStateChangedId;
+      }
+
+    private:
+      OnStateChangedBatch onStateChangedBatch_;
+      uint64_t callbackId_;
+      // The ID from addOnStateChanged for onStateChanged.
+      uint64_t onStateChangedId_;
+      // The node with the callback. This is a weak_ptr since the node may be
+      // removed or deleted while the flush is scheduled.
+      ndn::ptr_lib::weak_ptr<Namespace::Impl> namespaceImpl_;
+      std::vector<StateChange> changes_;
+      bool isFlushScheduled_;
+      bool isRemoved_;
+    };
+
+    /**
+     * Call flush() for the StateChangedBatch objects of this node.
+     */
+    void
+    flushStateChangedBatches();
+
+    /**
+     * Call flushStateChangedBatches() for this node and its ancestors, so that
+     * the collected state changes are supplied before child nodes are deleted.
+     * The callbacks can change the tree, so the caller should look up the
+     * child nodes after calling this.
+     * @return False if the callbacks removed this node, so the caller should
+     * not continue.
+     */
+    bool
+    flushStateChangedBatchesToRoot();
+
+    /**
+     * Check if the name of this node is a prefix of the given name. This
+     * compares the name component of this node and each parent, so it doesn't
+     * need to make the full name of this node.
+     * @param name The name to check.
+     * @return True if the name of this node is a prefix of the name.
+     */
+    bool
+    isPrefixOf(const ndn::Name& name) const;
+
+    /**
+     * Get the state mask with the bits for all the NamespaceState values.
+     */
+    static uint32_t
+    getALL_STATES_MASK()
+    {
+      return (getStateMask(NamespaceState_OBJECT_READY_BUT_STALE) << 1) - 1;
+    }
+
+    /**
+     * Get the full name of this node if it is already stored in name_ or in
+     * the Data packet.
+     * @return A pointer to the stored name, or null if none.
+     */
+    const ndn::Name*
+    getStoredName() const
+    {
+      if (name_)
+        return name_.get();
+      if (data_)
+        return &data_->getName();
+      return 0;
+    }
+
     /**
      * Get the maximum Interest lifetime that was set on this or a parent node.
      * @return The maximum Interest lifetime, or the default if not set on this
@@ -891,6 +1589,14 @@ public:
     ndn::Milliseconds
     getMaxInterestLifetime();
 
+    /**
+     * Get the RttEstimator set by setRttEstimation on this or a parent
+     * Namespace node.
+     * @return The RttEstimator, or null if not set on this or any parent.
+     */
+    RttEstimator*
+    getRttEstimator();
+
     /**
      * Get the decryptor set by setDecryptor on this or a parent Namespace node.
      * @return The DecryptorV2, or null if not set on this or any parent.
@@ -912,6 +1618,22 @@ public:
     Namespace&
     createChild(const ndn::Name::Component& component, bool fireCallbacks);
 
+    /**
+     * Set the state to NamespaceState_NAME_EXISTS, firing the OnStateChanged
+     * callbacks, and publish the name to sync if needed. This is called for a
+     * new node by createChild if fireCallbacks is true, or later for a node
+     * which was created without firing callbacks.
+     */
+    void
+    announceNameExists();
+
+    /**
+     * Set isShutDown_ of this node and its descendants to the given flag.
+     * @param isShutDown The new shared isShutDown_ flag.
+     */
+    void
+    setIsShutDownFlag(const ndn::ptr_lib::shared_ptr<bool>& isShutDown);
+
     /**
      * Set the state of this Namespace object and call the OnStateChanged
      * callbacks for this and all parents. This does not check if this Namespace
@@ -922,8 +1644,16 @@ public:
     void
     setState(NamespaceState state);
 
+    /**
+     * Call the OnStateChanged callbacks of this node which match the state,
+     * depth and component type of the changed node.
+     * @param changedNamespace The node whose state changed.
+     * @param state The new state.
+     * @param depth The depth of changedNamespace relative to this node.
+     */
     void
-    fireOnStateChanged(Namespace& changedNamespace, NamespaceState state);
+    fireOnStateChanged
+      (Namespace& changedNamespace, NamespaceState state, int depth);
 
     /**
      * Set the validate state of this Namespace object and call the
@@ -966,7 +1696,11 @@ public:
      * children nodes for a matching Data packet, longest prefix. This calls
      * face.putData(). If an existing Data packet is not found, add the
      * Interest to the PendingIncomingInterestTable so that a later call to
-     * setData may satisfy it.
+     * setData may satisfy it, and call the OnObjectNeeded callbacks. If the
+     * table already has a pending Interest with the same name, only add this
+     * Interest's face to it since the object was already asked for. This
+     * doesn't create nodes to look up the Interest name. Nodes for the Interest
+     * name are only kept if an OnObjectNeeded callback can produce the object.
      * However, if getIsShutDown() then do nothing.
      */
     void
@@ -977,8 +1711,16 @@ public:
         const ndn::ptr_lib::shared_ptr<const ndn::InterestFilter>& filter);
 
     /**
-     * This is a helper for onInterest to find the longest-prefix match under
-     * the given Namespace.
+     * This is a helper for onInterest to find a matching Data packet under the
+     * given Namespace. This prefers the longest matching name and, among names
+     * of the same length, the leftmost. The Namespace name itself only matches
+     * if no descendant matches. This walks down the children in order but skips
+     * a child whose maxDataNameSize_ can't give a longer match, and stops when
+     * a match has the longest Data name in the subtree. So if the Data packets
+     * are fresh, the cost depends on the depth and the children skipped along
+     * the path, not on the size of the subtree. (Stale or non-matching Data
+     * packets on the path may make it search more of the subtree.) If the
+     * Interest can't be a prefix, only the Namespace node itself is checked.
      * @param nameSpace This searches this Namespace and its children.
      * @param interest This calls interest.matchesData().
      * @param nowMilliseconds The current time in milliseconds from
@@ -990,6 +1732,22 @@ public:
       (Namespace::Impl& nameSpace, const ndn::Interest& interest,
        ndn::MillisecondsSince1970 nowMilliseconds);
 
+    /**
+     * Recompute maxDataNameSize_ of this node after a Data packet in its
+     * subtree was removed, and update the ancestors which had the same maximum.
+     */
+    void
+    updateMaxDataNameSize();
+
+    /**
+     * Remove the entries in the root node's dataIndex_ for the Data packets of
+     * the descendants of this node.
+     * @param includeThisNode If true, also remove the entry for this node's
+     * Data packet.
+     */
+    void
+    removeFromDataIndex(bool includeThisNode);
+
     void
     onData(const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest,
            const ndn::ptr_lib::shared_ptr<ndn::Data>& data);
@@ -997,6 +1755,41 @@ public:
     void
     onTimeout(const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest);
 
+    /**
+     * Express the Interest with the RTO from the RttEstimator as the lifetime,
+     * calling onRetransmissionData or onRetransmissionTimeout.
+     * @param interest The Interest to express.
+     * @param face The Face for expressInterest.
+     * @param nRetransmissions The number of times this Interest was already
+     * retransmitted.
+     * @param elapsedMilliseconds The total lifetime of the previous
+     * transmissions.
+     */
+    void
+    expressInterestWithRetransmission
+      (const ndn::ptr_lib::shared_ptr<ndn::Interest>& interest, ndn::Face* face,
+       int nRetransmissions, ndn::Milliseconds elapsedMilliseconds);
+
+    /**
+     * Give an RTT sample to the RttEstimator if the Interest was not
+     * retransmitted (Karn's algorithm), then call onData.
+     */
+    void
+    onRetransmissionData
+      (const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest,
+       const ndn::ptr_lib::shared_ptr<ndn::Data>& data,
+       ndn::MillisecondsSince1970 sendTimeMilliseconds, int nRetransmissions);
+
+    /**
+     * Back off the RttEstimator and retransmit the Interest, or call onTimeout
+     * if the total time reaches getMaxInterestLifetime().
+     */
+    void
+    onRetransmissionTimeout
+      (const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest,
+       ndn::Face* face, int nRetransmissions,
+       ndn::Milliseconds elapsedMilliseconds);
+
     void
     onNetworkNack
       (const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest,
@@ -1018,18 +1811,27 @@ public:
     onNamesUpdate(const ndn::ptr_lib::shared_ptr<std::vector<ndn::Name>>& names);
 
     Namespace& outerNamespace_;
-    ndn::Name name_;
-    // parent_ and root_ may be updated by createChild.
+    // The root node has its full name here. For a child without a Data packet,
+    // getName() makes it from the parent's name and component_ when needed.
+    // Internal code uses makeName() so that it doesn't keep a name in each node.
+    mutable ndn::ptr_lib::shared_ptr<ndn::Name> name_;
+    ndn::Name::Component component_;
+    // The number of components in the full name of this node.
+    size_t nameSize_;
     Namespace::Impl* parent_;
     Namespace::Impl* root_;
-    // The key is a Name::Component. The value is the child Namespace.
-    std::map<ndn::Name::Component, ndn::ptr_lib::shared_ptr<Namespace>> children_;
+    // The child Namespace objects, sorted by name component.
+    ChildList children_;
     NamespaceState state_;
     ndn::ptr_lib::shared_ptr<ndn::NetworkNack> networkNack_;
     NamespaceValidateState validateState_;
     ndn::ptr_lib::shared_ptr<ndn::ValidationError> validationError_;
     ndn::MillisecondsSince1970 freshnessExpiryTimeMilliseconds_;
     ndn::ptr_lib::shared_ptr<ndn::Data> data_;
+    // The largest nameSize_ of a node in this subtree (including this node)
+    // which has a Data packet, or 0 if there is none. findBestMatchName uses
+    // this to skip the children which can't have the longest match.
+    size_t maxDataNameSize_;
     ndn::ptr_lib::shared_ptr<Object> object_;
     ndn::Face* face_;
     uint64_t registeredPrefixId_;
@@ -1038,8 +1840,17 @@ public:
     ndn::DecryptorV2* decryptor_;
     std::string decryptionError_;
     std::string signingError_;
-    // The key is the callback ID. The value is the OnStateChanged function.
-    std::map<uint64_t, OnStateChanged> onStateChangedCallbacks_;
+    // The key is the callback ID. The value has the OnStateChanged function.
+    std::map<uint64_t, StateChangedEntry> onStateChangedCallbacks_;
+    // The sorted IDs of the callbacks in onStateChangedCallbacks_ whose
+    // stateMask has all the NamespaceState values.
+    std::vector<uint64_t> onStateChangedAllStates_;
+    // The key is the NamespaceState. The value is the sorted IDs of the other
+    // callbacks in onStateChangedCallbacks_ whose stateMask has the state.
+    std::map<int, std::vector<uint64_t>> onStateChangedIndex_;
+    // The key is the callback ID from addOnStateChangedBatch.
+    std::map<uint64_t, ndn::ptr_lib::shared_ptr<StateChangedBatch>>
+      stateChangedBatches_;
     // The key is the callback ID. The value is the OnValidateStateChanged function.
     std::map<uint64_t, OnValidateStateChanged> onValidateStateChangedCallbacks_;
     // The key is the callback ID. The value is the OnObjectNeeded function.
@@ -1049,9 +1860,21 @@ public:
     // setFace will create this in the root Namespace node.
     ndn::ptr_lib::shared_ptr<PendingIncomingInterestTable>
       pendingIncomingInterestTable_;
+    // Only used in the root Namespace node. setFace creates
+    // pendingIncomingInterestTable_ with this capacity.
+    size_t maxPendingIncomingInterests_;
     // This will be created in the root Namespace node.
     ndn::ptr_lib::shared_ptr<ndn::FullPSync2017> fullPSync_;
+    // createChild will create this in the root Namespace node to allocate the
+    // memory for all the nodes in the tree.
+    ndn::ptr_lib::shared_ptr<NamespaceNodePool> nodePool_;
+    // Only used in the root Namespace node. The key is the name of the Data
+    // packet attached to a node in the tree (which is the node's name). The
+    // value is the node. setData adds an entry.
+    DataIndex dataIndex_;
     ndn::Milliseconds maxInterestLifetime_; // -1 if not specified.
+    ndn::ptr_lib::shared_ptr<RttEstimator> rttEstimator_;
+    bool isInterestRetransmitted_;
     int syncDepth_; // -1 if not specified.
     ndn::ptr_lib::shared_ptr<bool> isShutDown_;
   };
@@ -1064,11 +1887,16 @@ private:
   Namespace& operator=(const Namespace& other);
 
   /**
-   * This private constructor is used by Impl::createChild for passing isShutDown.
+   * This private constructor is used by Impl::createChild for passing the
+   * parent and isShutDown, and to allocate the Impl with the allocator for the
+   * root node's pool.
    */
-  Namespace(const ndn::Name& name, ndn::KeyChain* keyChain,
-            const ndn::ptr_lib::shared_ptr<bool>& isShutDown)
-  : impl_(ndn::ptr_lib::make_shared<Impl>(*this, name, keyChain, isShutDown))
+  template<class Allocator>
+  Namespace(Namespace::Impl* parent, const ndn::Name::Component& component,
+            const ndn::ptr_lib::shared_ptr<bool>& isShutDown,
+            const Allocator& allocator)
+  : impl_(ndn::ptr_lib::allocate_shared<Impl>
+          (allocator, *this, parent, component, isShutDown))
   {
   }
 
@@ -0,0 +1,202 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_SEGMENT_SINK_HPP
+#define CNL_CPP_SEGMENT_SINK_HPP
+
+#include <string>
+#include <ndn-cpp/common.hpp>
+#include <ndn-cpp/util/blob.hpp>
+
+namespace cnl_cpp {
+
+/**
+ * SegmentSink is an abstract base class for the destination of the contents of
+ * a segmented object. If you call SegmentedObjectHandler::setSink, each
+ * segment is written to the sink at its byte offset as it arrives, in any
+ * order, instead of being assembled in memory. This bounds the memory used by
+ * the consumer to roughly the segments in flight.
+ */
+class SegmentSink {
+public:
+  virtual
+  ~SegmentSink();
+
+  /**
+   * Write the segment content at the given byte offset in the object.
+   * @param offset The byte offset in the object.
+   * @param buf A pointer to the segment content.
+   * @param size The number of bytes to write.
+   * @return True if the sink can accept more segments, false if the consumer
+   * should pause fetching until you call resumeFetching() on the handler. (In
+   * either case, this segment was accepted.)
+   * @throws runtime_error for an error writing the segment.
+   */
+  virtual bool
+  write(uint64_t offset, const uint8_t* buf, size_t size) = 0;
+
+  /**
+   * Write the segment content at the given byte offset in the object. This is
+   * what SegmentedObjectHandler calls. The default implementation calls
+   * write(offset, content.buf(), content.size()). A subclass can override this
+   * to keep the Blob without copying it.
+   * @param offset The byte offset in the object.
+   * @param content The segment content.
+   * @return True if the sink can accept more segments, false to pause fetching
+   * as described in write.
+   * @throws runtime_error for an error writing the segment.
+   */
+  virtual bool
+  writeBlob(uint64_t offset, const ndn::Blob& content)
+  {
+    return write(offset, content.buf(), content.size());
+  }
+
+  /**
+   * This is called after all segments are written.
+   * @param totalSize The total number of bytes in the object.
+   * @throws runtime_error for an error finishing the object.
+   */
+  virtual void
+  finish(uint64_t totalSize) = 0;
+};
+
+/**
+ * FileDescriptorSegmentSink extends SegmentSink to write each segment to an
+ * open file descriptor with pwrite at the segment offset.
+ */
+class FileDescriptorSegmentSink : public SegmentSink {
+public:
+  /**
+   * Create a FileDescriptorSegmentSink to write to the file descriptor.
+   * @param fileDescriptor The file descriptor, open for writing. This does not
+   * close it.
+   */
+  FileDescriptorSegmentSink(int fileDescriptor)
+  : fileDescriptor_(fileDescriptor)
+  {}
+
+  virtual bool
+  write(uint64_t offset, const uint8_t* buf, size_t size);
+
+  /**
+   * Truncate the file to the totalSize.
+   */
+  virtual void
+  finish(uint64_t totalSize);
+
+private:
+  int fileDescriptor_;
+};
+
+/**
+ * MmapSegmentSink extends SegmentSink to write each segment into a file
+ * which is memory-mapped and grown as needed.
+ */
+class MmapSegmentSink : public SegmentSink {
+public:
+  /**
+   * Create an MmapSegmentSink to create or truncate the file at the path.
+   * @param filePath The path of the file.
+   * @throws runtime_error if the file can't be opened.
+   */
+  MmapSegmentSink(const std::string& filePath);
+
+  /**
+   * Unmap and close the file if finish was not called.
+   */
+  virtual
+  ~MmapSegmentSink();
+
+  virtual bool
+  write(uint64_t offset, const uint8_t* buf, size_t size);
+
+  /**
+   * Unmap the file, truncate it to the totalSize and close it.
+   */
+  virtual void
+  finish(uint64_t totalSize);
+
+private:
+  /**
+   * Grow the file and the mapping so that it is at least minimumSize.
+   */
+  void
+  ensureSize(uint64_t minimumSize);
+
+  void
+  close();
+
+  int fileDescriptor_;
+  uint8_t* map_;
+  uint64_t mapSize_;
+};
+
+/**
+ * CallbackSegmentSink extends SegmentSink to call a user function for each
+ * segment. SegmentedObjectHandler calls writeBlob, which passes the Blob of the
+ * segment content to the function without copying. (If you call write with a
+ * buffer, it is copied into a new Blob.)
+ */
+class CallbackSegmentSink : public SegmentSink {
+public:
+  typedef ndn::func_lib::function<bool
+    (uint64_t offset, const ndn::Blob& content)> OnWrite;
+  typedef ndn::func_lib::function<void(uint64_t totalSize)> OnFinish;
+
+  /**
+   * Create a CallbackSegmentSink with the given callbacks.
+   * @param onWrite This calls onWrite(offset, content) for each segment. It
+   * returns false to pause fetching, as described in SegmentSink::write.
+   * @param onFinish (optional) This calls onFinish(totalSize) after all
+   * segments are written.
+   */
+  CallbackSegmentSink
+    (const OnWrite& onWrite, const OnFinish& onFinish = OnFinish())
+  : onWrite_(onWrite), onFinish_(onFinish)
+  {}
+
+  /**
+   * Call onWrite with a copy of the buffer.
+   */
+  virtual bool
+  write(uint64_t offset, const uint8_t* buf, size_t size);
+
+  /**
+   * Call onWrite with the Blob, which shares the segment content.
+   */
+  virtual bool
+  writeBlob(uint64_t offset, const ndn::Blob& content)
+  {
+    return onWrite_(offset, content);
+  }
+
+  virtual void
+  finish(uint64_t totalSize);
+
+private:
+  OnWrite onWrite_;
+  OnFinish onFinish_;
+};
+
+}
+
+#endif
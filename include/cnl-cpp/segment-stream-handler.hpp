@@ -23,6 +23,7 @@
 #define CNL_CPP_SEGMENT_STREAM_HANDLER_HPP
 
 #include "namespace.hpp"
+#include "content-source.hpp"
 
 extern "C" {
 
@@ -37,13 +38,54 @@ cnl_cpp_getSegmentStreamHandlerManifestComponent();
 
 namespace cnl_cpp {
 
+/**
+ * A SegmentStreamWindowControl specifies how SegmentStreamHandler sets the
+ * number of outstanding segment Interests.
+ * FIXED - Always keep the Interest pipeline size outstanding.
+ * AIMD - Additive increase, multiplicative decrease with slow start, as in TCP
+ * Reno. The window grows with each segment and is halved on a timeout or
+ * network Nack.
+ * CUBIC - Slow start, then grow the window with the CUBIC function of the time
+ * since the last congestion event, as in RFC 8312, which recovers faster on
+ * links with a large bandwidth-delay product.
+ */
+enum SegmentStreamWindowControl {
+  SegmentStreamWindowControl_FIXED = 0,
+  SegmentStreamWindowControl_AIMD =  1,
+  SegmentStreamWindowControl_CUBIC = 2
+};
+
+/**
+ * A SegmentManifestResult is the result of
+ * SegmentStreamHandler::verifySegmentWithManifest.
+ * VERIFIED - The segment's implicit digest matches the signature _manifest.
+ * FAILED - The segment or a manifest packet on its path doesn't match, or is
+ *   malformed.
+ * INCOMPLETE - A manifest packet on the path to the segment hasn't arrived.
+ */
+enum SegmentManifestResult {
+  SegmentManifestResult_VERIFIED =   0,
+  SegmentManifestResult_FAILED =     1,
+  SegmentManifestResult_INCOMPLETE = 2
+};
+
+class SegmentWindowControl;
+class SignatureManifest;
+class ParallelFor;
+
 /**
  * SegmentStreamHandler extends Namespace::Handler and attaches to a Namespace
- * node to fetch and return child segments in order.
+ * node to fetch and return child segments in order. When attached, if RTT
+ * estimation is not already enabled for the Namespace (or a parent), this calls
+ * setRttEstimation(true) on it so that a lost segment is retransmitted after
+ * the retransmission timeout.
  */
 class SegmentStreamHandler : public Namespace::Handler {
 public:
   typedef ndn::func_lib::function<void(Namespace* segmentNamespace)> OnSegment;
+  typedef ndn::func_lib::function<void(Namespace& nameSpace)> OnSegmentsComplete;
+  typedef ndn::func_lib::function<void
+    (Namespace& nameSpace, const std::string& message)> OnSegmentsError;
 
   /**
    * Create a SegmentStreamHandler with the optional onSegment callback.
@@ -93,6 +135,62 @@ public:
     return impl_->addOnSegment(onSegment);
   }
 
+  /**
+   * Add an onSegmentUnordered callback. Unlike addOnSegment, this calls
+   * onSegment(segmentNamespace) as soon as each segment is ready, in the order
+   * that they arrive, so that a late segment doesn't hold back the segments
+   * after it. This is useful if you write each segment at its own offset. Each
+   * segment is supplied once and segmentNamespace is never null. Use
+   * addOnSegmentsComplete to know when all segments have been supplied. (The
+   * in-order callbacks from addOnSegment are still called as usual.)
+   * @param onSegment This calls onSegment(segmentNamespace) where
+   * segmentNamespace is the Namespace where you can use
+   * segmentNamespace.getObject(), and
+   * segmentNamespace.getNameComponent().toSegment() is the segment number.
+   * NOTE: The library will log any exceptions thrown by this callback, but for
+   * better error handling the callback should catch and properly handle any
+   * exceptions.
+   * @return The callback ID which you can use in removeCallback().
+   */
+  uint64_t
+  addOnSegmentUnordered(const OnSegment& onSegment)
+  {
+    return impl_->addOnSegmentUnordered(onSegment);
+  }
+
+  /**
+   * Add an onSegmentsComplete callback. When all segments up to the
+   * FinalBlockId are ready, this calls onSegmentsComplete(nameSpace) where
+   * nameSpace is the Namespace of this handler. This is called after the last
+   * onSegmentUnordered and onSegment callbacks.
+   * NOTE: The library will log any exceptions thrown by this callback, but for
+   * better error handling the callback should catch and properly handle any
+   * exceptions.
+   * @return The callback ID which you can use in removeCallback().
+   */
+  uint64_t
+  addOnSegmentsComplete(const OnSegmentsComplete& onSegmentsComplete)
+  {
+    return impl_->addOnSegmentsComplete(onSegmentsComplete);
+  }
+
+  /**
+   * Add an onSegmentsError callback. If fetching stops because of an error
+   * (for example, a SegmentedObjectHandler can't write to its SegmentSink),
+   * this calls onSegmentsError(nameSpace, message) where nameSpace is the
+   * Namespace of this handler and message describes the error. After this,
+   * the onSegment and onSegmentsComplete callbacks are not called.
+   * NOTE: The library will log any exceptions thrown by this callback, but for
+   * better error handling the callback should catch and properly handle any
+   * exceptions.
+   * @return The callback ID which you can use in removeCallback().
+   */
+  uint64_t
+  addOnSegmentsError(const OnSegmentsError& onSegmentsError)
+  {
+    return impl_->addOnSegmentsError(onSegmentsError);
+  }
+
   /**
    * Remove the callback with the given callbackId. This does not search for the
    * callbackId in child nodes. If the callbackId isn't found, do nothing.
@@ -102,9 +200,74 @@ public:
   void
   removeCallback(uint64_t callbackId) { impl_->removeCallback(callbackId); }
 
+  /**
+   * Stop sending Interests for new segments. Segments which are already
+   * requested are still received and supplied to the callbacks. This is used
+   * for backpressure when the application can't keep up with the segments.
+   */
+  void
+  pauseFetching() { impl_->setIsFetchingPaused(true); }
+
+  /**
+   * If pauseFetching() was called, start sending Interests for new segments
+   * again, up to the current window.
+   */
+  void
+  resumeFetching() { impl_->setIsFetchingPaused(false); }
+
+  /**
+   * Check if pauseFetching() was called without a following resumeFetching().
+   * @return True if fetching is paused.
+   */
+  bool
+  isFetchingPaused() { return impl_->getIsFetchingPaused(); }
+
+  /**
+   * Stop fetching segments, remove all callbacks of this handler, and remove
+   * the callbacks which this handler added to its Namespace so that the
+   * Namespace no longer keeps this handler's state. Segments which are already
+   * requested may still arrive in the Namespace. Call this when the fetched
+   * object is no longer wanted. You can't use this handler to fetch again.
+   */
+  void
+  detach() { impl_->stopFetching(); }
+
+  /**
+   * Get the flag for whether to verify each segment with the signature
+   * _manifest as it arrives (as described in setVerifySegments).
+   * @return True to verify each segment.
+   */
+  bool
+  getVerifySegments() { return impl_->getVerifySegments(); }
+
+  /**
+   * Set the flag for whether to verify each segment with the signature
+   * _manifest as it arrives, using verifySegmentWithManifest. If true, this
+   * fetches the _manifest along with the first segments, and fetches the
+   * manifest packets on the path to each segment as needed. A segment which
+   * has a DigestSha256Signature is only supplied to the OnSegment callbacks
+   * after it is verified. If a segment or a manifest packet on its path doesn't
+   * match, this removes the packet which doesn't match and fetches it again
+   * with the implicit digest from its parent manifest packet, up to
+   * getMAX_SEGMENT_REFETCHES() times. This uses callLater on the Face of the
+   * Namespace. If it still doesn't match, or if there is no Face, this stops
+   * fetching and calls the onSegmentsError callbacks (see addOnSegmentsError).
+   * (Segments with another type of signature are supplied as usual.) You should
+   * call this before the segments are fetched.
+   * @param verifySegments True to verify each segment, false to not verify
+   * (the default).
+   */
+  void
+  setVerifySegments(bool verifySegments)
+  {
+    impl_->setVerifySegments(verifySegments);
+  }
+
   /**
    * Get the number of outstanding interests which this maintains while fetching
-   * segments.
+   * segments with SegmentStreamWindowControl_FIXED. The adaptive window
+   * controls don't use this. Instead, their window starts at
+   * getInitialInterestCount() and grows up to getMaxCongestionWindow().
    * @return The Interest pipeline size.
    */
   int
@@ -122,6 +285,91 @@ public:
     impl_->setInterestPipelineSize(interestPipelineSize);
   }
 
+  /**
+   * Get the type of window control for the number of outstanding Interests.
+   * @return The SegmentStreamWindowControl.
+   */
+  SegmentStreamWindowControl
+  getWindowControl() { return impl_->getWindowControl(); }
+
+  /**
+   * Set the type of window control for the number of outstanding Interests.
+   * This also resets the RTT statistics. You should call this before the
+   * segments are fetched.
+   * @param windowControl The SegmentStreamWindowControl. The default is
+   * SegmentStreamWindowControl_FIXED which keeps getInterestPipelineSize()
+   * Interests outstanding.
+   */
+  void
+  setWindowControl(SegmentStreamWindowControl windowControl)
+  {
+    impl_->setWindowControl(windowControl);
+  }
+
+  /**
+   * Get the maximum congestion window for the adaptive window controls.
+   * @return The maximum number of outstanding Interests.
+   */
+  int
+  getMaxCongestionWindow() { return impl_->getMaxCongestionWindow(); }
+
+  /**
+   * Set the maximum congestion window for the adaptive window controls.
+   * @param maxCongestionWindow The maximum number of outstanding Interests.
+   * @throws runtime_error if maxCongestionWindow is less than 1.
+   */
+  void
+  setMaxCongestionWindow(int maxCongestionWindow)
+  {
+    impl_->setMaxCongestionWindow(maxCongestionWindow);
+  }
+
+  /**
+   * Get the current congestion window, which is the number of segment
+   * Interests that this keeps outstanding.
+   * @return The congestion window. For the adaptive window controls, this can
+   * have a fraction.
+   */
+  double
+  getCongestionWindow() { return impl_->getCongestionWindow(); }
+
+  /**
+   * Get the smoothed round-trip time of segment Interests, as in RFC 6298.
+   * @return The smoothed RTT in milliseconds, or -1 if no segment was received.
+   */
+  ndn::Milliseconds
+  getSmoothedRttMilliseconds() { return impl_->getSmoothedRttMilliseconds(); }
+
+  /**
+   * Get the round-trip time variation of segment Interests, as in RFC 6298.
+   * @return The RTT variation in milliseconds, or -1 if no segment was
+   * received.
+   */
+  ndn::Milliseconds
+  getRttVariationMilliseconds() { return impl_->getRttVariationMilliseconds(); }
+
+  /**
+   * Get the minimum round-trip time of segment Interests.
+   * @return The minimum RTT in milliseconds, or -1 if no segment was received.
+   */
+  ndn::Milliseconds
+  getMinRttMilliseconds() { return impl_->getMinRttMilliseconds(); }
+
+  /**
+   * Get the number of RTT samples which were used for the RTT statistics.
+   * @return The number of RTT samples.
+   */
+  uint64_t
+  getRttSampleCount() { return impl_->getRttSampleCount(); }
+
+  /**
+   * Get the number of times that the window was decreased because of a timeout
+   * or network Nack. (Losses in the same window count once.)
+   * @return The number of congestion events.
+   */
+  uint64_t
+  getCongestionEventCount() { return impl_->getCongestionEventCount(); }
+
   /**
    * Get the initial Interest count (as described in setInitialInterestCount).
    * @return The initial Interest count.
@@ -163,6 +411,32 @@ public:
     impl_->setMaxSegmentPayloadLength(maxSegmentPayloadLength);
   }
 
+  /**
+   * Get the number of threads that setObject and setObjectFromFile use to make
+   * the segment packets.
+   * @return The number of worker threads.
+   */
+  int
+  getNWorkerThreads() { return impl_->getNWorkerThreads(); }
+
+  /**
+   * Set the number of threads that setObject and setObjectFromFile use to
+   * encode the segment packets and compute their implicit digests for the
+   * signature _manifest. This uses the calling thread plus nWorkerThreads - 1
+   * temporary threads. The KeyChain and Namespace are not thread safe, so if
+   * not using a signature _manifest, each segment packet is still signed on
+   * the calling thread, and all segment packets are attached to the Namespace
+   * on the calling thread.
+   * @param nWorkerThreads The number of worker threads. If 1 (the default),
+   * make the segment packets on the calling thread.
+   * @throws runtime_error if nWorkerThreads is less than 1.
+   */
+  void
+  setNWorkerThreads(int nWorkerThreads)
+  {
+    impl_->setNWorkerThreads(nWorkerThreads);
+  }
+
   /**
    * Segment the object and create child segment packets of the given Namespace.
    * @param nameSpace The Namespace to append segment packets to. This
@@ -181,11 +455,72 @@ public:
     impl_->setObject(nameSpace, object, useSignatureManifest);
   }
 
+  /**
+   * Segment the content of the file and create child segment packets of the
+   * given Namespace, as with setObject. This memory-maps the file and makes
+   * the content of each segment packet from the mapping, so that the file is
+   * not read into memory first. Since the object is not in memory, this does
+   * not set the object of the given Namespace. To also avoid making all the
+   * segment packets now, use setObjectFromSource with an MmapContentSource.
+   * @param nameSpace The Namespace to append segment packets to. This
+   * ignores the Namespace from setNamespace().
+   * @param filePath The path of the file, which must not change while this is
+   * called.
+   * @param useSignatureManifest (optional) If true, only use a
+   * DigestSha256Signature on the segment packets and create a signed
+   * _manifest packet as a child of the given Namespace. If omitted or false,
+   * sign each segment packet individually.
+   * @throws runtime_error if the file can't be mapped or there is no KeyChain.
+   */
+  void
+  setObjectFromFile
+    (Namespace& nameSpace, const std::string& filePath,
+     bool useSignatureManifest = false)
+  {
+    impl_->setObjectFromFile(nameSpace, filePath, useSignatureManifest);
+  }
+
+  /**
+   * Prepare to produce the child segment packets of the given Namespace on
+   * demand. Unlike setObject, this does not make any segments now. Instead, it
+   * adds an OnObjectNeeded callback to the Namespace so that when an Interest
+   * for a segment arrives, this reads the segment content from the source,
+   * then makes the segment packet and signs it with the KeyChain. (This can't
+   * use a signature _manifest since that needs the digest of every segment.)
+   * To bound memory, this keeps at most maxCachedSegments produced segment
+   * packets attached to the Namespace and removes the least recently produced.
+   * The Namespace object is not set.
+   * @param nameSpace The Namespace to append segment packets to. This
+   * ignores the Namespace from setNamespace().
+   * @param source The ContentSource of the object content, which must not
+   * change while segments are produced.
+   * @param maxCachedSegments (optional) The maximum number of produced segment
+   * packets to keep. If omitted, use 1000.
+   * @throws runtime_error if there is no KeyChain.
+   */
+  void
+  setObjectFromSource
+    (Namespace& nameSpace, const ndn::ptr_lib::shared_ptr<ContentSource>& source,
+     size_t maxCachedSegments = 1000)
+  {
+    impl_->setObjectFromSource(nameSpace, source, maxCachedSegments);
+  }
+
   /**
    * Get the list of implicit digests from the _manifest packet and use it to
-   * verify the segment implicit digests.
-   * @param nameSpace The Namespace with child _manifest and segments.
-   * @return True if the segment digests verify, false if not.
+   * verify the segment implicit digests. For an object with more than 256
+   * segments, setObject makes the manifest as a tree where the signed
+   * _manifest packet has the digests of the manifest packets
+   * _manifest-tree/<level>/<index> (each with the digests of up to 256 packets
+   * at the level below). In this case, this also verifies the manifest packets.
+   * (The manifest packets are not below _manifest so that an Interest for
+   * _manifest which can be a prefix is not answered with a manifest packet. If
+   * getVerifySegments() is false, the SegmentStreamHandler fetches these
+   * manifest packets when the _manifest packet arrives.)
+   * @param nameSpace The Namespace with child _manifest and segments (and
+   * manifest packets below _manifest-tree if needed).
+   * @return True if the segment digests verify, false if not or if a packet is
+   * missing.
    */
   static bool
   verifyWithManifest(Namespace& nameSpace)
@@ -193,13 +528,83 @@ public:
     return Impl::verifyWithManifest(nameSpace);
   }
 
+  /**
+   * Verify one segment's implicit digest using only the manifest packets on
+   * the path from the _manifest packet to the segment (see
+   * verifyWithManifest), so that a segment can be verified before the other
+   * segments arrive.
+   * @param nameSpace The Namespace with child _manifest and segments.
+   * @param segmentNumber The segment number. The segment must have its Data
+   * packet.
+   * @param neededNode (optional) If the result is
+   * SegmentManifestResult_INCOMPLETE and this is not null, set *neededNode to
+   * the manifest Namespace node which is needed next. You can call
+   * objectNeeded() on it and call this again when it arrives.
+   * @return The SegmentManifestResult.
+   */
+  static SegmentManifestResult
+  verifySegmentWithManifest
+    (Namespace& nameSpace, uint64_t segmentNumber, Namespace** neededNode = 0)
+  {
+    return Impl::verifySegmentWithManifest
+      (nameSpace, segmentNumber, neededNode);
+  }
+
   static const ndn::Name::Component&
   getNAME_COMPONENT_MANIFEST() { return getValues().NAME_COMPONENT_MANIFEST; }
 
+  static const ndn::Name::Component&
+  getNAME_COMPONENT_MANIFEST_TREE()
+  {
+    return getValues().NAME_COMPONENT_MANIFEST_TREE;
+  }
+
+  /**
+   * Get the maximum number of times that a segment which doesn't match the
+   * signature _manifest is fetched again (if getVerifySegments() is true).
+   */
+  static int
+  getMAX_SEGMENT_REFETCHES() { return 3; }
+
 protected:
   virtual void
   onNamespaceSet();
 
+  /**
+   * Get a function which pauses or resumes fetching, for use by the Impl of a
+   * derived class which shouldn't keep a pointer to this outer handler.
+   * @return A function where calling it with true is the same as
+   * pauseFetching() and with false is the same as resumeFetching().
+   */
+  ndn::func_lib::function<void(bool isFetchingPaused)>
+  getSetIsFetchingPaused();
+
+  /**
+   * Get a function which stops fetching and calls the onSegmentsError
+   * callbacks, for use by the Impl of a derived class which shouldn't keep a
+   * pointer to this outer handler.
+   * @return A function to call with the error message.
+   */
+  ndn::func_lib::function<void(const std::string& message)>
+  getReportError();
+
+  /**
+   * Get a function which returns getVerifySegments(), for use by the Impl of a
+   * derived class which shouldn't keep a pointer to this outer handler.
+   * @return A function which returns the verify segments flag.
+   */
+  ndn::func_lib::function<bool()>
+  getGetVerifySegments();
+
+  /**
+   * Get a function which returns true if there are OnSegment callbacks (added
+   * with addOnSegment), for use by the Impl of a derived class which shouldn't
+   * keep a pointer to this outer handler.
+   * @return A function which returns true if there are OnSegment callbacks.
+   */
+  ndn::func_lib::function<bool()>
+  getGetHasOnSegmentCallbacks();
+
 private:
   /**
    * SegmentStreamHandler::Impl does the work of SegmentStreamHandler. It is a
@@ -217,9 +622,32 @@ private:
     uint64_t
     addOnSegment(const OnSegment& onSegment);
 
+    uint64_t
+    addOnSegmentUnordered(const OnSegment& onSegment);
+
+    uint64_t
+    addOnSegmentsComplete(const OnSegmentsComplete& onSegmentsComplete);
+
+    uint64_t
+    addOnSegmentsError(const OnSegmentsError& onSegmentsError);
+
     void
     removeCallback(uint64_t callbackId);
 
+    /**
+     * Log the error, stop fetching and call the onSegmentsError callbacks.
+     * @param message The error message.
+     */
+    void
+    reportError(const std::string& message);
+
+    /**
+     * Remove the callbacks from the Namespace and free the resources for
+     * fetching, after the segments are complete, on an error or for detach().
+     */
+    void
+    stopFetching();
+
     int
     getInterestPipelineSize() { return interestPipelineSize_; }
 
@@ -232,9 +660,60 @@ private:
     void
     setInitialInterestCount(int initialInterestCount);
 
+    SegmentStreamWindowControl
+    getWindowControl();
+
+    void
+    setWindowControl(SegmentStreamWindowControl windowControl);
+
+    int
+    getMaxCongestionWindow() { return maxCongestionWindow_; }
+
+    void
+    setMaxCongestionWindow(int maxCongestionWindow);
+
+    double
+    getCongestionWindow();
+
+    bool
+    getIsFetchingPaused() { return isFetchingPaused_; }
+
+    bool
+    getVerifySegments() { return verifySegments_; }
+
+    bool
+    getHasOnSegmentCallbacks() { return onSegmentCallbacks_.size() > 0; }
+
+    void
+    setVerifySegments(bool verifySegments) { verifySegments_ = verifySegments; }
+
+    void
+    setIsFetchingPaused(bool isFetchingPaused);
+
+    ndn::Milliseconds
+    getSmoothedRttMilliseconds();
+
+    ndn::Milliseconds
+    getRttVariationMilliseconds();
+
+    ndn::Milliseconds
+    getMinRttMilliseconds();
+
+    uint64_t
+    getRttSampleCount();
+
+    uint64_t
+    getCongestionEventCount();
+
     size_t
     getMaxSegmentPayloadLength() { return maxSegmentPayloadLength_; }
 
+    int
+    getNWorkerThreads() { return nWorkerThreads_; }
+
+    void
+    setNWorkerThreads(int nWorkerThreads);
+
     void
     setMaxSegmentPayloadLength(size_t maxSegmentPayloadLength);
 
@@ -242,9 +721,24 @@ private:
     setObject
       (Namespace& nameSpace, const ndn::Blob& object, bool useSignatureManifest);
 
+    void
+    setObjectFromFile
+      (Namespace& nameSpace, const std::string& filePath,
+       bool useSignatureManifest);
+
+    void
+    setObjectFromSource
+      (Namespace& nameSpace,
+       const ndn::ptr_lib::shared_ptr<ContentSource>& source,
+       size_t maxCachedSegments);
+
     static bool
     verifyWithManifest(Namespace& nameSpace);
 
+    static SegmentManifestResult
+    verifySegmentWithManifest
+      (Namespace& nameSpace, uint64_t segmentNumber, Namespace** neededNode);
+
     void
     onNamespaceSet(Namespace* nameSpace);
 
@@ -265,23 +759,159 @@ private:
       (Namespace& nameSpace, Namespace& changedNamespace, NamespaceState state,
        uint64_t callbackId);
 
+    /**
+     * Handle a segment which is OBJECT_READY and verified (if needed): Supply
+     * it to the onSegmentUnordered callbacks, then supply as many segments as
+     * possible in order to the onSegment callbacks.
+     * @param segmentNamespace The segment Namespace node.
+     * @return True to continue fetching, false if all segments are finished.
+     */
+    bool
+    onSegmentReady(Namespace& segmentNamespace);
+
+    /**
+     * Verify the segment with signatureManifest_. If a manifest packet is
+     * needed, fetch it and add the segment to unverifiedSegments_. If the
+     * segment or a manifest tree packet on its path doesn't match, schedule
+     * refetchNode for the packet which doesn't match (and add the segment to
+     * unverifiedSegments_ if it is a manifest packet). Call reportError after
+     * getMAX_SEGMENT_REFETCHES() re-fetches, if there is no Face to schedule
+     * the re-fetch, or if re-fetching can't help.
+     * @param segmentNumber The segment number.
+     * @return True if the segment is verified.
+     */
+    bool
+    verifySegment(uint64_t segmentNumber);
+
+    /**
+     * Remove the node with the bad segment or manifest packet and fetch it
+     * again. If the node was already removed and re-fetched, do nothing.
+     * @param name The name of the node.
+     * @param expectedDigest The implicit digest of the packet from its parent
+     * manifest packet, to put in the Interest name.
+     */
+    void
+    refetchNode(const ndn::Name& name, const ndn::Blob& expectedDigest);
+
+    /**
+     * This is called when a manifest packet is ready to verify the segments in
+     * unverifiedSegments_ again.
+     */
+    void
+    onManifestNodeReady();
+
+    /**
+     * If verifySegments_ is false, call SignatureManifest::fetchNodes once the
+     * _manifest packet and the final segment number are known, so that the
+     * manifest packets for verifyWithManifest are fetched along with the
+     * segments.
+     */
+    void
+    fetchManifestNodes();
+
+    /**
+     * Check if the node is _manifest or a manifest packet below
+     * _manifest-tree.
+     */
+    bool
+    isManifestNode(Namespace& node);
+
+    /**
+     * Request segments, starting from nextSegmentToRequest_, until there are
+     * maxRequestedSegments outstanding. This only does work for the new
+     * requests.
+     */
     void
     requestNewSegments(int maxRequestedSegments);
 
+    /**
+     * Segment the object and create child segment packets of the given
+     * Namespace, as described in setObject, but don't set the object of the
+     * Namespace.
+     */
     void
-    fireOnSegment(Namespace* segmentNamespace);
+    makeSegments
+      (Namespace& nameSpace, const uint8_t* object, size_t objectSize,
+       bool useSignatureManifest);
+
+    /**
+     * If the segment is outstanding, remove it from requestTimes_ and decrement
+     * nOutstandingSegments_.
+     * @param segmentNumber The segment number.
+     * @return The time that the Interest was sent, or -1 if the segment is not
+     * outstanding.
+     */
+    ndn::MillisecondsSince1970
+    onSegmentNotOutstanding(uint64_t segmentNumber);
 
-    int maxReportedSegmentNumber_;
-    bool didRequestFinalSegment_;
-    int finalSegmentNumber_;
+    /**
+     * Get the number of segment Interests to keep outstanding from the
+     * windowControl_.
+     */
+    int
+    getWindow();
+
+    /**
+     * Call each callback in the map with the segmentNamespace.
+     * @param callbacks The map of callbacks, such as onSegmentCallbacks_.
+     * @param segmentNamespace The Namespace for the callback.
+     */
+    void
+    fireOnSegment
+      (std::map<uint64_t, OnSegment>& callbacks, Namespace* segmentNamespace);
+
+    void
+    fireOnSegmentsComplete();
+
+    // The segments before this number have been reported to the OnSegment
+    // callbacks.
+    uint64_t nextSegmentToReport_;
+    // Only valid if hasFinalSegmentNumber_.
+    uint64_t finalSegmentNumber_;
+    bool hasFinalSegmentNumber_;
+    // The next segment number that requestNewSegments will check.
+    uint64_t nextSegmentToRequest_;
+    // The number of segments in requestTimes_ which are outstanding.
+    int nOutstandingSegments_;
     int interestPipelineSize_;
     int initialInterestCount_;
     // The key is the callback ID. The value is the OnSegment function.
     std::map<uint64_t, OnSegment> onSegmentCallbacks_;
+    std::map<uint64_t, OnSegment> onSegmentUnorderedCallbacks_;
+    // The key is the callback ID. The value is the OnSegmentsComplete function.
+    std::map<uint64_t, OnSegmentsComplete> onSegmentsCompleteCallbacks_;
+    // The key is the callback ID. The value is the OnSegmentsError function.
+    std::map<uint64_t, OnSegmentsError> onSegmentsErrorCallbacks_;
+    // The entry at index i is true if segment i is OBJECT_READY and was
+    // supplied to the onSegmentUnordered callbacks.
+    std::vector<bool> readySegments_;
+    bool isFetchingPaused_;
+    // True after stopFetching, so that no more segments are requested.
+    bool isStopped_;
     uint64_t onObjectNeededId_;
     uint64_t onStateChangedId_;
     Namespace* namespace_;
     size_t maxSegmentPayloadLength_;
+    int nWorkerThreads_;
+    // makeSegments creates this if nWorkerThreads_ is more than 1, and reuses
+    // its threads for the next object.
+    ndn::ptr_lib::shared_ptr<ParallelFor> parallelFor_;
+    bool verifySegments_;
+    ndn::ptr_lib::shared_ptr<SignatureManifest> signatureManifest_;
+    // The segments which are waiting for a manifest packet to be verified.
+    std::vector<uint64_t> unverifiedSegments_;
+    // The key is the segment number. The value is the number of re-fetches.
+    std::map<uint64_t, int> nSegmentRefetches_;
+    // True when fetchManifestNodes has requested the manifest nodes.
+    bool isManifestFetched_;
+    int maxCongestionWindow_;
+    ndn::ptr_lib::shared_ptr<SegmentWindowControl> windowControl_;
+    // The entry at index i is for segment number requestTimesOffset_ + i. If
+    // the segment is outstanding, the value is the time that the Interest was
+    // sent, for the RTT sample. Otherwise it is -1. This only holds segment
+    // numbers from nextSegmentToReport_.
+    std::deque<ndn::MillisecondsSince1970> requestTimes_;
+    uint64_t requestTimesOffset_;
   };
 
   /**
@@ -290,10 +920,12 @@ private:
   class Values {
   public:
     Values()
-    : NAME_COMPONENT_MANIFEST(cnl_cpp_getSegmentStreamHandlerManifestComponent())
+    : NAME_COMPONENT_MANIFEST(cnl_cpp_getSegmentStreamHandlerManifestComponent()),
+      NAME_COMPONENT_MANIFEST_TREE("_manifest-tree")
     {}
 
     ndn::Name::Component NAME_COMPONENT_MANIFEST;
+    ndn::Name::Component NAME_COMPONENT_MANIFEST_TREE;
   };
 
   /**
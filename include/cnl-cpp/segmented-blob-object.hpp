@@ -0,0 +1,109 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef NDN_SEGMENTED_BLOB_OBJECT_HPP
+#define NDN_SEGMENTED_BLOB_OBJECT_HPP
+
+#include <string.h>
+#include <vector>
+#include <ndn-cpp/util/blob.hpp>
+#include "object.hpp"
+
+namespace cnl_cpp {
+
+/**
+ * A SegmentedBlobObject extends Object to hold the contents of the segments of
+ * a segmented object as a list of ndn::Blob, without concatenating them. It is
+ * made by SegmentedObjectHandler if you call setConcatenateSegments(false).
+ * This is useful to process the contents with scatter-gather I/O (such as
+ * writev) without copying them into a single block of memory.
+ */
+class SegmentedBlobObject : public Object {
+public:
+  /**
+   * Create a new SegmentedBlobObject to hold the given segment contents.
+   * Objects of this type are created internally by the library, so your
+   * application normally does not call this constructor.
+   * @param segments The list of segment contents, in order. This copies the
+   * list, but each Blob shares its buffer.
+   */
+  SegmentedBlobObject(const std::vector<ndn::Blob>& segments)
+  : segments_(segments), size_(0)
+  {
+    for (size_t i = 0; i < segments_.size(); ++i)
+      size_ += segments_[i].size();
+  }
+
+  /**
+   * Get the list of segment contents.
+   * @return The list of Blob.
+   */
+  const std::vector<ndn::Blob>&
+  getSegments() const { return segments_; }
+
+  /**
+   * Get the number of segments.
+   */
+  size_t
+  getSegmentCount() const { return segments_.size(); }
+
+  /**
+   * Get the content of the segment at the given index.
+   * @param i The index of the segment, which is the segment number.
+   * @return The Blob of the segment content.
+   */
+  const ndn::Blob&
+  getSegment(size_t i) const { return segments_[i]; }
+
+  /**
+   * Return the total length of all the segment contents.
+   */
+  size_t
+  size() const { return size_; }
+
+  /**
+   * Concatenate the segment contents into a single Blob. This copies the bytes,
+   * so only use it if you need the contents in a single block of memory.
+   * @return A new Blob with the concatenated contents.
+   */
+  ndn::Blob
+  toBlob() const
+  {
+    ndn::ptr_lib::shared_ptr<std::vector<uint8_t> > content =
+      ndn::ptr_lib::make_shared<std::vector<uint8_t> >(size_);
+    size_t offset = 0;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+      if (segments_[i].size() > 0)
+        memcpy(&(*content)[offset], segments_[i].buf(), segments_[i].size());
+      offset += segments_[i].size();
+    }
+
+    return ndn::Blob(content, false);
+  }
+
+private:
+  std::vector<ndn::Blob> segments_;
+  size_t size_;
+};
+
+}
+
+#endif
@@ -23,12 +23,21 @@
 #define CNL_CPP_SEGMENTED_OBJECT_HANDLER_HPP
 
 #include "segment-stream-handler.hpp"
+#include "segmented-blob-object.hpp"
+#include "segment-sink.hpp"
 
 namespace cnl_cpp {
 
 /**
  * SegmentedObjectHandler extends SegmentStreamHandler and assembles the
- * contents of child segments into a single block of memory.
+ * contents of child segments into a single block of memory. When segment 0
+ * arrives with the FinalBlockId, this allocates the memory for all segments
+ * (up to getMAX_ALLOCATED_CONTENT_SIZE()) and copies each segment into it as it
+ * arrives, in any order. (To also free the Data packets of the copied segments,
+ * see setRemoveSegments.) If the segment sizes don't allow copying, this
+ * concatenates the segments from the child nodes when all have arrived. Alternatively, you can call setSink to write each segment to a
+ * SegmentSink (such as a file) as it arrives, without keeping the object in
+ * memory.
  */
 class SegmentedObjectHandler : public SegmentStreamHandler {
 public:
@@ -86,6 +95,83 @@ public:
     return impl_->addOnSegmentedObject(onSegmentedObject);
   }
 
+  /**
+   * Get the concatenate segments flag (as described in
+   * setConcatenateSegments).
+   * @return True to concatenate the segment contents.
+   */
+  bool
+  getConcatenateSegments() { return impl_->getConcatenateSegments(); }
+
+  /**
+   * Set the flag for whether to concatenate the segment contents into a single
+   * block of memory which is deserialized to get the object. If false, the
+   * object is a SegmentedBlobObject with the list of segment contents (and the
+   * onDeserializeNeeded callbacks are not called). You should call this before
+   * the segments are fetched.
+   * @param concatenateSegments True to concatenate the segment contents (the
+   * default), false to make a SegmentedBlobObject.
+   */
+  void
+  setConcatenateSegments(bool concatenateSegments)
+  {
+    impl_->setConcatenateSegments(concatenateSegments);
+  }
+
+  /**
+   * Get the remove segments flag (as described in setRemoveSegments).
+   * @return True to remove the segment nodes after they are copied or written.
+   */
+  bool
+  getRemoveSegments() { return impl_->getRemoveSegments(); }
+
+  /**
+   * Set the flag for whether to remove the child node of each segment (and its
+   * Data packet) from the Namespace after the segment content is copied into
+   * the object (or written to the sink), so that memory is not used twice for
+   * a large object. The removed segments can't be served again or inspected.
+   * A segment is not removed if it has a DigestSha256Signature and
+   * getVerifySegments() is false (since verifyWithManifest needs it), or while
+   * there are OnSegment callbacks added with addOnSegment (since they get the
+   * segment nodes in order after they arrive). You should call this before the
+   * segments are fetched.
+   * @param removeSegments True to remove the segment nodes, false to keep them
+   * (the default).
+   */
+  void
+  setRemoveSegments(bool removeSegments)
+  {
+    impl_->setRemoveSegments(removeSegments);
+  }
+
+  /**
+   * Get the SegmentSink given to setSink.
+   * @return The SegmentSink, or null if not set.
+   */
+  const ndn::ptr_lib::shared_ptr<SegmentSink>&
+  getSink() { return impl_->getSink(); }
+
+  /**
+   * Set the SegmentSink to write each segment to at its byte offset as it
+   * arrives, in any order. The segments are not assembled in memory and the
+   * object is not deserialized. To also bound the memory by the segments in
+   * flight, call setRemoveSegments(true). When all segments are written, this
+   * calls
+   * sink.finish(totalSize) and then the onSegmentedObject callbacks, where
+   * objectNamespace.getObject() is null. If sink.writeBlob returns false, this
+   * calls pauseFetching() and you must call resumeFetching() when the sink can
+   * accept more segments. If segment 0 has no FinalBlockId, a segment has an
+   * unexpected size or the sink throws an exception, this stops fetching and
+   * calls the onSegmentsError callbacks (see addOnSegmentsError). You should
+   * call this before the segments are fetched.
+   * @param sink The SegmentSink, or null to assemble the object in memory.
+   */
+  void
+  setSink(const ndn::ptr_lib::shared_ptr<SegmentSink>& sink)
+  {
+    impl_->setSink(sink);
+  }
+
   /**
    * Remove the callback with the given callbackId. This does not search for the
    * callbackId in child nodes. If the callbackId isn't found, do nothing.
@@ -95,6 +181,15 @@ public:
   void
   removeCallback(uint64_t callbackId) { impl_->removeCallback(callbackId); }
 
+  /**
+   * Get the maximum object size (from the FinalBlockId and the size of segment
+   * 0) for which this allocates memory when segment 0 arrives. For a larger
+   * size, this concatenates the segments when all have arrived.
+   * @return The maximum size in bytes.
+   */
+  static uint64_t
+  getMAX_ALLOCATED_CONTENT_SIZE() { return (uint64_t)1 << 30; }
+
 protected:
   virtual void
   onNamespaceSet()
@@ -135,6 +230,27 @@ private:
     void
     removeCallback(uint64_t callbackId);
 
+    bool
+    getConcatenateSegments() { return concatenateSegments_; }
+
+    void
+    setConcatenateSegments(bool concatenateSegments)
+    {
+      concatenateSegments_ = concatenateSegments;
+    }
+
+    bool
+    getRemoveSegments() { return removeSegments_; }
+
+    void
+    setRemoveSegments(bool removeSegments) { removeSegments_ = removeSegments; }
+
+    const ndn::ptr_lib::shared_ptr<SegmentSink>&
+    getSink() { return sink_; }
+
+    void
+    setSink(const ndn::ptr_lib::shared_ptr<SegmentSink>& sink) { sink_ = sink; }
+
     void
     onNamespaceSet(Namespace* nameSpace)
     {
@@ -144,14 +260,85 @@ private:
     }
 
   private:
+    /**
+     * This is called by the SegmentStreamHandler for each segment as it
+     * arrives, in any order.
+     */
     void
     onSegment(Namespace* segmentNamespace);
 
+    /**
+     * Copy the segment content into content_ at the offset for its segment
+     * number. If the node can be removed, add it to writtenSegmentNumbers_. If
+     * the segment size doesn't match segmentPayloadLength_, release content_ so
+     * that onSegmentsComplete gets the segments from the Namespace, or call
+     * reportError_ if segment nodes were already removed.
+     */
+    void
+    copySegment(Namespace& segmentNamespace);
+
+    /**
+     * Compute (finalSegmentNumber_ + 1) * segmentPayloadLength_.
+     * @param contentSize Set this to the size.
+     * @return True for success, or false if the size overflows a uint64_t.
+     */
+    bool
+    getContentSize(uint64_t& contentSize);
+
+    /**
+     * Write the segment content to sink_ at the offset for its segment number
+     * and add it to writtenSegmentNumbers_. If the segment size doesn't match
+     * segmentPayloadLength_ or the sink throws an exception, set
+     * isContentUsable_ false and call reportError_.
+     */
+    void
+    writeSegment(uint64_t segmentNumber, const ndn::Blob& segment);
+
+    /**
+     * Remove the child node of each segment in writtenSegmentNumbers_ except
+     * keepSegmentNumber, whose state change is being processed, and set
+     * isSegmentRemoved_ if any is removed. However, if removeSegments_ is false
+     * or there are OnSegment callbacks, just clear writtenSegmentNumbers_.
+     */
+    void
+    removeWrittenSegments(uint64_t keepSegmentNumber);
+
+    /**
+     * This is called by the SegmentStreamHandler when all segments have
+     * arrived.
+     */
+    void
+    onSegmentsComplete(Namespace& nameSpace);
+
     void
     fireOnSegmentedObject(Namespace& objectNamespace);
 
-    std::vector<ndn::Blob> segments_;
-    size_t totalSize_;
+    // The buffer for the concatenated segments, allocated when segment 0
+    // arrives with the FinalBlockId.
+    ndn::ptr_lib::shared_ptr<std::vector<uint8_t> > content_;
+    // The length of each segment except the final one, from segment 0.
+    size_t segmentPayloadLength_;
+    uint64_t finalSegmentNumber_;
+    // True when finalSegmentNumber_ is set from the FinalBlockId of segment 0.
+    bool hasFinalSegmentNumber_;
+    // The segments which arrived before content_ was allocated.
+    std::vector<uint64_t> pendingSegmentNumbers_;
+    // False if a segment size shows that content_ can't be used.
+    bool isContentUsable_;
+    bool concatenateSegments_;
+    bool removeSegments_;
+    uint64_t totalSize_;
+    ndn::ptr_lib::shared_ptr<SegmentSink> sink_;
+    // The segments written to sink_ or copied to content_ whose nodes are not
+    // removed yet.
+    std::vector<uint64_t> writtenSegmentNumbers_;
+    // True if a segment node was removed, so we can't concatenate from the
+    // Namespace.
+    bool isSegmentRemoved_;
+    ndn::func_lib::function<void(bool isFetchingPaused)> setIsFetchingPaused_;
+    ndn::func_lib::function<void(const std::string& message)> reportError_;
+    ndn::func_lib::function<bool()> getVerifySegments_;
+    ndn::func_lib::function<bool()> getHasOnSegmentCallbacks_;
     // The key is the callback ID. The value is the OnSegmentedObject function.
     std::map<uint64_t, OnSegmentedObject> onSegmentedObjectCallbacks_;
     Namespace* namespace_;
@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include <stdexcept>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <cnl-cpp/content-source.hpp>
+
+using namespace std;
+using namespace ndn;
+
+namespace cnl_cpp {
+
+ContentSource::~ContentSource()
+{
+}
+
+uint64_t
+BlobContentSource::size() { return blob_.size(); }
+
+Blob
+BlobContentSource::read(uint64_t offset, size_t length)
+{
+  if (offset + length > blob_.size())
+    throw runtime_error("BlobContentSource: Read past the end of the content");
+
+  return Blob(blob_.buf() + offset, length);
+}
+
+FileContentSource::FileContentSource(const string& filePath)
+{
+  fileDescriptor_ = ::open(filePath.c_str(), O_RDONLY);
+  if (fileDescriptor_ < 0)
+    throw runtime_error
+      ("FileContentSource: Can't open " + filePath + ": " + strerror(errno));
+
+  struct stat fileStat;
+  if (::fstat(fileDescriptor_, &fileStat) != 0) {
+    int error = errno;
+    ::close(fileDescriptor_);
+    throw runtime_error
+      ("FileContentSource: Can't stat " + filePath + ": " + strerror(error));
+  }
+  size_ = fileStat.st_size;
+}
+
+FileContentSource::~FileContentSource()
+{
+  ::close(fileDescriptor_);
+}
+
+Blob
+FileContentSource::read(uint64_t offset, size_t length)
+{
+  if (offset + length > size_)
+    throw runtime_error("FileContentSource: Read past the end of the content");
+
+  ptr_lib::shared_ptr<vector<uint8_t> > buffer
+    (new vector<uint8_t>(length));
+  size_t nRead = 0;
+  while (nRead < length) {
+    ssize_t result = ::pread
+      (fileDescriptor_, &buffer->front() + nRead, length - nRead,
+       offset + nRead);
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      throw runtime_error
+        (string("FileContentSource: Error in pread: ") + strerror(errno));
+    }
+    if (result == 0)
+      throw runtime_error("FileContentSource: The file is shorter than expected");
+
+    // Continue after a partial read.
+    nRead += result;
+  }
+
+  return Blob(buffer, false);
+}
+
+MmapContentSource::MmapContentSource(const string& filePath)
+: map_(0)
+{
+  int fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+  if (fileDescriptor < 0)
+    throw runtime_error
+      ("MmapContentSource: Can't open " + filePath + ": " + strerror(errno));
+
+  struct stat fileStat;
+  if (::fstat(fileDescriptor, &fileStat) != 0) {
+    int error = errno;
+    ::close(fileDescriptor);
+    throw runtime_error
+      ("MmapContentSource: Can't stat " + filePath + ": " + strerror(error));
+  }
+  size_ = fileStat.st_size;
+
+  if (size_ > 0) {
+    void* map = ::mmap(0, size_, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (map == MAP_FAILED) {
+      int error = errno;
+      ::close(fileDescriptor);
+      throw runtime_error
+        ("MmapContentSource: Can't mmap " + filePath + ": " + strerror(error));
+    }
+    map_ = (const uint8_t*)map;
+    // We usually read the segments in order.
+    ::madvise(map, size_, MADV_SEQUENTIAL);
+  }
+
+  // The mapping stays valid after closing the file.
+  ::close(fileDescriptor);
+}
+
+MmapContentSource::~MmapContentSource()
+{
+  if (map_)
+    ::munmap((void*)map_, size_);
+}
+
+Blob
+MmapContentSource::read(uint64_t offset, size_t length)
+{
+  if (offset + length > size_)
+    throw runtime_error("MmapContentSource: Read past the end of the content");
+
+  return Blob(map_ + offset, length);
+}
+
+}
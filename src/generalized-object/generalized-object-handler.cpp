@@ -41,7 +41,8 @@ GeneralizedObjectHandler::Impl::Impl(const OnGeneralizedObject& onGeneralizedObj
   // We'll call onGeneralizedObject if we don't use the SegmentedObjectHandler.
   onGeneralizedObject_(onGeneralizedObject), namespace_(0),
   nComponentsAfterObjectNamespace_(0), onObjectNeededId_(0),
-  onDeserializeNeededId_(0)
+  onDeserializeNeededId_(0), isFetchingSegments_(false),
+  onSegmentedObjectId_(0)
 {
 }
 
@@ -63,21 +64,11 @@ GeneralizedObjectHandler::Impl::setObject
     (object.size() > segmentedObjectHandler_->getMaxSegmentPayloadLength() ||
      other.size() > 0);
 
-  // Prepare the _meta packet.
-  ContentMetaInfo contentMetaInfo;
-  contentMetaInfo.setContentType(contentType);
-  contentMetaInfo.setTimestamp(ndn_getNowMilliseconds());
-  contentMetaInfo.setHasSegments(hasSegments);
-
   if (!hasSegments)
     // We don't need to segment. Put the object in the "other" field.
-    contentMetaInfo.setOther(object);
-  else if (other.size() > 0)
-    // We have an "other" field in addition to segments.
-    contentMetaInfo.setOther(other);
-
-  nameSpace[getNAME_COMPONENT_META()].serializeObject
-    (ptr_lib::make_shared<BlobObject>(contentMetaInfo.wireEncode()));
+    setMetaInfo(nameSpace, contentType, false, object);
+  else
+    setMetaInfo(nameSpace, contentType, true, other);
 
   if (hasSegments)
     segmentedObjectHandler_->setObject(nameSpace, object, true);
@@ -86,6 +77,41 @@ GeneralizedObjectHandler::Impl::setObject
     nameSpace.setObject_(ptr_lib::make_shared<BlobObject>(object));
 }
 
+void
+GeneralizedObjectHandler::Impl::setObjectFromFile
+  (Namespace& nameSpace, const string& filePath, const string& contentType,
+   const Blob& other)
+{
+  {
+    MmapContentSource source(filePath);
+    if (!(source.size() > segmentedObjectHandler_->getMaxSegmentPayloadLength() ||
+          other.size() > 0)) {
+      // The file is small enough for the _meta packet, so read it.
+      setObject(nameSpace, source.read(0, source.size()), contentType, other);
+      return;
+    }
+  }
+
+  setMetaInfo(nameSpace, contentType, true, other);
+  segmentedObjectHandler_->setObjectFromFile(nameSpace, filePath, true);
+}
+
+void
+GeneralizedObjectHandler::Impl::setMetaInfo
+  (Namespace& nameSpace, const string& contentType, bool hasSegments,
+   const Blob& other)
+{
+  ContentMetaInfo contentMetaInfo;
+  contentMetaInfo.setContentType(contentType);
+  contentMetaInfo.setTimestamp(ndn_getNowMilliseconds());
+  contentMetaInfo.setHasSegments(hasSegments);
+  if (other.size() > 0)
+    contentMetaInfo.setOther(other);
+
+  nameSpace[getNAME_COMPONENT_META()].serializeObject
+    (ptr_lib::make_shared<BlobObject>(contentMetaInfo.wireEncode()));
+}
+
 void
 GeneralizedObjectHandler::Impl::onNamespaceSet(Namespace* nameSpace)
 {
@@ -102,6 +128,43 @@ GeneralizedObjectHandler::Impl::onNamespaceSet(Namespace* nameSpace)
   // We don't attach the SegmentedObjectHandler until we need it.
 }
 
+void
+GeneralizedObjectHandler::Impl::reset
+  (const OnGeneralizedObject& onGeneralizedObject)
+{
+  if (namespace_) {
+    // These may already be removed by onDeserializeNeeded.
+    namespace_->removeCallback(onObjectNeededId_);
+    namespace_->removeCallback(onDeserializeNeededId_);
+  }
+
+  if (isFetchingSegments_) {
+    // A SegmentedObjectHandler can only be attached once, so make a new one
+    // with the same settings. Detach the old one in case it is still fetching,
+    // so that its Namespace callbacks don't keep it fetching.
+    segmentedObjectHandler_->removeCallback(onSegmentedObjectId_);
+    segmentedObjectHandler_->detach();
+    ptr_lib::shared_ptr<SegmentedObjectHandler> segmentedObjectHandler =
+      ptr_lib::make_shared<SegmentedObjectHandler>();
+    segmentedObjectHandler->setInterestPipelineSize
+      (segmentedObjectHandler_->getInterestPipelineSize());
+    segmentedObjectHandler->setInitialInterestCount
+      (segmentedObjectHandler_->getInitialInterestCount());
+    segmentedObjectHandler->setMaxSegmentPayloadLength
+      (segmentedObjectHandler_->getMaxSegmentPayloadLength());
+    segmentedObjectHandler->setNWorkerThreads
+      (segmentedObjectHandler_->getNWorkerThreads());
+    segmentedObjectHandler_ = segmentedObjectHandler;
+    isFetchingSegments_ = false;
+  }
+
+  onGeneralizedObject_ = onGeneralizedObject;
+  namespace_ = 0;
+  onObjectNeededId_ = 0;
+  onDeserializeNeededId_ = 0;
+  onSegmentedObjectId_ = 0;
+}
+
 bool
 GeneralizedObjectHandler::Impl::onObjectNeeded
   (Namespace& nameSpace, Namespace& neededNamespace, uint64_t callbackId)
@@ -125,15 +188,20 @@ GeneralizedObjectHandler::Impl::onDeserializeNeeded
    const Namespace::Handler::OnDeserialized& onDeserialized,
    uint64_t callbackId)
 {
-  if (blobNamespace.getName().size() !=
-      namespace_->getName().size() + nComponentsAfterObjectNamespace_ + 1)
+  // Walk up the parents instead of comparing full names, which a child node
+  // doesn't keep.
+  Namespace* ancestor = &blobNamespace;
+  for (int i = 0; i < nComponentsAfterObjectNamespace_ + 1 && ancestor; ++i)
+    ancestor = ancestor->getParent();
+  if (ancestor != namespace_)
     // This is not a generalized object packet at the correct level under the Namespace.
     return false;
-  if (blobNamespace.getName()[-1] != getNAME_COMPONENT_META()) {
+  const Name::Component& component = blobNamespace.getNameComponent();
+  if (component != getNAME_COMPONENT_META()) {
     // Not the _meta packet.
     if (nComponentsAfterObjectNamespace_ > 0 &&
-        (blobNamespace.getName()[-1].isSegment() ||
-         blobNamespace.getName()[-1] == SegmentedObjectHandler::getNAME_COMPONENT_MANIFEST())) {
+        (component.isSegment() ||
+         component == SegmentedObjectHandler::getNAME_COMPONENT_MANIFEST())) {
       // This is another packet type for a generalized object and we did not try
       // to fetch the _meta packet in onObjectNeeded. Try fetching it if we
       // haven't already.
@@ -157,9 +225,10 @@ GeneralizedObjectHandler::Impl::onDeserializeNeeded
   Namespace& objectNamespace = *blobNamespace.getParent();
   if (contentMetaInfo->getHasSegments()) {
     // Initiate fetching segments. This will call onGeneralizedObject.
-    segmentedObjectHandler_->addOnSegmentedObject
+    onSegmentedObjectId_ = segmentedObjectHandler_->addOnSegmentedObject
       (bind(&GeneralizedObjectHandler::Impl::onSegmentedObject,
        shared_from_this(), _1, contentMetaInfo));
+    isFetchingSegments_ = true;
     segmentedObjectHandler_->setNamespace(&objectNamespace);
     // Explicitly request segment 0 to avoid fetching _meta, etc.
     objectNamespace[Name::Component::fromSegment(0)].objectNeeded();
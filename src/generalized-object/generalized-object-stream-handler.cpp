@@ -40,7 +40,10 @@ GeneralizedObjectStreamHandler::Impl::Impl
   latestNamespace_(0), producedSequenceNumber_(-1),
   latestPacketFreshnessPeriod_(1000.0), nRequestedSequenceNumbers_(0),
   maxRequestedSequenceNumber_(0), nReportedSequenceNumbers_(0),
-  maxReportedSequenceNumber_(-1)
+  maxReportedSequenceNumber_(-1), maxRetainedObjects_(-1),
+  retentionPeriod_(-1.0), maxRetainedBytes_(0), nRetainedBytes_(0),
+  isPruneScheduled_(false), maxPrunedSequenceNumber_(-1), maxPublishedObjects_(-1),
+  maxPublishedBytes_(0), nPublishedBytes_(0)
 {
   if (pipelineSize_ < 0)
     pipelineSize_ = 0;
@@ -60,6 +63,32 @@ GeneralizedObjectStreamHandler::Impl::setObject
     (*namespace_)[Name::Component::fromSequenceNumber(producedSequenceNumber_)];
   generalizedObjectHandler_.setObject
     (sequenceNamespace, object, contentType, other);
+
+  if (hasPublishLimit()) {
+    size_t nBytes = object.size() + other.size();
+    publishedObjects_.push_back
+      (RetainedObject(sequenceNumber, ndn_getNowMilliseconds(), nBytes));
+    nPublishedBytes_ += nBytes;
+    evictPublishedObjects();
+  }
+}
+
+void
+GeneralizedObjectStreamHandler::Impl::evictPublishedObjects()
+{
+  // Usually this evicts one object per publish.
+  while (publishedObjects_.size() > 1 &&
+         ((maxPublishedObjects_ >= 0 &&
+           publishedObjects_.size() > (size_t)maxPublishedObjects_) ||
+          (maxPublishedBytes_ > 0 && nPublishedBytes_ > maxPublishedBytes_))) {
+    const RetainedObject& oldest = publishedObjects_.front();
+    nPublishedBytes_ -= oldest.getNBytes();
+    // The object will not be produced again, so also remove its pending
+    // Interests.
+    namespace_->removeChild
+      (Name::Component::fromSequenceNumber(oldest.getSequenceNumber()), true);
+    publishedObjects_.pop_front();
+  }
 }
 
 void
@@ -89,9 +118,17 @@ GeneralizedObjectStreamHandler::Impl::onNamespaceSet(Namespace* nameSpace)
   namespace_->addOnObjectNeeded
     (bind(&GeneralizedObjectStreamHandler::Impl::onObjectNeeded,
           shared_from_this(), _1, _2, _3));
-  namespace_->addOnStateChanged
+  // Only get the states handled by onStateChanged for _latest (depth 0 from
+  // latestNamespace_) and the versioned _latest (depth 1). The segments
+  // <sequence>/<segment> are at the same depth below namespace_ as
+  // <sequence>/_meta, so requestNewSequenceNumbers adds a callback on each
+  // _meta node instead of filtering by depth here.
+  latestNamespace_->addOnStateChanged
     (bind(&GeneralizedObjectStreamHandler::Impl::onStateChanged,
-          shared_from_this(), _1, _2, _3, _4));
+          shared_from_this(), _1, _2, _3, _4),
+     Namespace::getStateMask(NamespaceState_INTEREST_TIMEOUT) |
+     Namespace::getStateMask(NamespaceState_INTEREST_NETWORK_NACK) |
+     Namespace::getStateMask(NamespaceState_OBJECT_READY), 0, 1);
 }
 
 bool
@@ -120,6 +157,16 @@ GeneralizedObjectStreamHandler::Impl::onObjectNeeded
     versionedLatest.serializeObject(ptr_lib::make_shared<BlobObject>
       (delegations.wireEncode()));
 
+    if (hasPublishLimit()) {
+      // Only keep the newest _latest packet.
+      const Name::Component& versionComponent =
+        versionedLatest.getNameComponent();
+      if (latestVersionComponent_.getValue().size() > 0 &&
+          !latestVersionComponent_.equals(versionComponent))
+        latestNamespace_->removeChild(latestVersionComponent_, true);
+      latestVersionComponent_ = versionComponent;
+    }
+
     return true;
   }
 
@@ -142,11 +189,12 @@ GeneralizedObjectStreamHandler::Impl::onStateChanged
       return;
     }
     else if (pipelineSize_ > 0 &&
-        changedNamespace.getName().size() == namespace_->getName().size() + 2 &&
-        changedNamespace.getName()[-1].equals
+        changedNamespace.getNameComponent().equals
           (GeneralizedObjectHandler::getNAME_COMPONENT_META()) &&
-        changedNamespace.getName()[-2].isSequenceNumber() &&
-        changedNamespace.getName()[-2].toSequenceNumber() ==
+        changedNamespace.getParent() &&
+        changedNamespace.getParent()->getParent() == namespace_ &&
+        changedNamespace.getParent()->getNameComponent().isSequenceNumber() &&
+        changedNamespace.getParent()->getNameComponent().toSequenceNumber() ==
           maxRequestedSequenceNumber_) {
       // The highest pipelined request timed out, so request the _latest.
       // TODO: Should we do this for the lowest requested?
@@ -158,10 +206,8 @@ GeneralizedObjectStreamHandler::Impl::onStateChanged
   }
 
   if (!(state == NamespaceState_OBJECT_READY &&
-        changedNamespace.getName().size() ==
-          latestNamespace_->getName().size() + 1 &&
-        latestNamespace_->getName().isPrefixOf(changedNamespace.getName()) &&
-        changedNamespace.getName()[-1].isVersion()))
+        changedNamespace.getParent() == latestNamespace_ &&
+        changedNamespace.getNameComponent().isVersion()))
     // Not a versioned _latest, so ignore.
     return;
 
@@ -178,6 +224,10 @@ GeneralizedObjectStreamHandler::Impl::onStateChanged
         targetName[-1].isSequenceNumber()))
     // TODO: Report an error for invalid target name?
     return;
+  if (isPruned(targetName[-1].toSequenceNumber()))
+    // We already supplied and removed the target, so don't create it again.
+    // Wait for the producer to publish a new _latest.
+    return;
   Namespace& targetNamespace = (*namespace_)[targetName];
 
   // We may already have the target if this was triggered by the producer.
@@ -190,10 +240,9 @@ GeneralizedObjectStreamHandler::Impl::onStateChanged
         targetNamespace[GeneralizedObjectHandler::getNAME_COMPONENT_META()];
       // Make sure we didn't already request it.
       if (sequenceMeta.getState() < NamespaceState_INTEREST_EXPRESSED) {
-        ptr_lib::make_shared<GeneralizedObjectHandler>
-          (&targetNamespace,
-           bind(&GeneralizedObjectStreamHandler::Impl::onGeneralizedObject,
-                shared_from_this(), _1, _2, sequenceNumber));
+        // Keep the previous object in case it is still arriving.
+        releaseStaleHandlers(sequenceNumber - 1);
+        attachHandler(targetNamespace, sequenceNumber);
         sequenceMeta.objectNeeded();
       }
     }
@@ -234,6 +283,14 @@ GeneralizedObjectStreamHandler::Impl::onGeneralizedObject
     }
   }
 
+  // This is called from a callback of the handler, so release it and prune
+  // the tree later.
+  Face* face = namespace_->getFace_();
+  if (face)
+    face->callLater
+      (0, bind(&GeneralizedObjectStreamHandler::Impl::onObjectSupplied,
+               shared_from_this(), sequenceNumber));
+
   ++nReportedSequenceNumbers_;
   if (sequenceNumber > maxReportedSequenceNumber_)
     maxReportedSequenceNumber_ = sequenceNumber;
@@ -246,6 +303,9 @@ GeneralizedObjectStreamHandler::Impl::onGeneralizedObject
 void
 GeneralizedObjectStreamHandler::Impl::requestNewSequenceNumbers()
 {
+  // Objects this far behind the reported ones are not expected to finish.
+  releaseStaleHandlers(maxReportedSequenceNumber_ + 1 - pipelineSize_);
+
   ptr_lib::shared_ptr<vector<Name::Component>> childComponents =
     namespace_->getChildComponents();
   int nOutstandingSequenceNumbers = 
@@ -255,6 +315,9 @@ GeneralizedObjectStreamHandler::Impl::requestNewSequenceNumbers()
   int sequenceNumber = maxReportedSequenceNumber_;
   while (nOutstandingSequenceNumbers < pipelineSize_) {
     ++sequenceNumber;
+    if (isPruned(sequenceNumber))
+      // Already supplied and removed.
+      continue;
     Namespace& sequenceNamespace =
       (*namespace_)[Name::Component::fromSequenceNumber(sequenceNumber)];
     Namespace& sequenceMeta =
@@ -267,16 +330,153 @@ GeneralizedObjectStreamHandler::Impl::requestNewSequenceNumbers()
     ++nOutstandingSequenceNumbers;
     ++nRequestedSequenceNumbers_;
 
-    ptr_lib::make_shared<GeneralizedObjectHandler>
-      (&sequenceNamespace,
-       bind(&GeneralizedObjectStreamHandler::Impl::onGeneralizedObject,
-            shared_from_this(), _1, _2, sequenceNumber));
+    attachHandler(sequenceNamespace, sequenceNumber);
     if (sequenceNumber > maxRequestedSequenceNumber_)
       maxRequestedSequenceNumber_ = sequenceNumber;
+    // onStateChanged checks for a timeout of the highest requested _meta. The
+    // callback is removed with the node.
+    sequenceMeta.addOnStateChanged
+      (bind(&GeneralizedObjectStreamHandler::Impl::onStateChanged,
+            shared_from_this(), _1, _2, _3, _4),
+       Namespace::getStateMask(NamespaceState_INTEREST_TIMEOUT) |
+       Namespace::getStateMask(NamespaceState_INTEREST_NETWORK_NACK), 0, 0);
     sequenceMeta.objectNeeded();
   }
 }
 
+void
+GeneralizedObjectStreamHandler::Impl::attachHandler
+  (Namespace& sequenceNamespace, int sequenceNumber)
+{
+  // In case we are fetching the sequence number again.
+  releaseHandler(sequenceNumber);
+
+  ptr_lib::shared_ptr<GeneralizedObjectHandler> handler;
+  if (freeHandlers_.size() > 0) {
+    handler = freeHandlers_.back();
+    freeHandlers_.pop_back();
+  }
+  else
+    handler = ptr_lib::make_shared<GeneralizedObjectHandler>();
+
+  handler->reset
+    (bind(&GeneralizedObjectStreamHandler::Impl::onGeneralizedObject,
+          shared_from_this(), _1, _2, sequenceNumber));
+  handler->setNamespace(&sequenceNamespace);
+  activeHandlers_[sequenceNumber] = handler;
+}
+
+void
+GeneralizedObjectStreamHandler::Impl::releaseHandler(int sequenceNumber)
+{
+  map<int, ptr_lib::shared_ptr<GeneralizedObjectHandler>>::iterator entry =
+    activeHandlers_.find(sequenceNumber);
+  if (entry == activeHandlers_.end())
+    return;
+
+  ptr_lib::shared_ptr<GeneralizedObjectHandler> handler = entry->second;
+  activeHandlers_.erase(entry);
+  // This removes the callbacks, including the bound shared_from_this().
+  handler->reset();
+  if (freeHandlers_.size() < (size_t)pipelineSize_ + 1)
+    freeHandlers_.push_back(handler);
+}
+
+void
+GeneralizedObjectStreamHandler::Impl::releaseStaleHandlers(int minSequenceNumber)
+{
+  while (activeHandlers_.size() > 0 &&
+         activeHandlers_.begin()->first < minSequenceNumber)
+    releaseHandler(activeHandlers_.begin()->first);
+}
+
+void
+GeneralizedObjectStreamHandler::Impl::onObjectSupplied(int sequenceNumber)
+{
+  releaseHandler(sequenceNumber);
+
+  if (maxRetainedObjects_ < 0 && retentionPeriod_ < 0 && maxRetainedBytes_ == 0)
+    // No retention policy.
+    return;
+
+  Name::Component sequenceComponent =
+    Name::Component::fromSequenceNumber(sequenceNumber);
+  if (!namespace_->hasChild(sequenceComponent))
+    return;
+  Namespace& objectNamespace = (*namespace_)[sequenceComponent];
+
+  // Add the size of the Data packets and the assembled object.
+  size_t nBytes = 0;
+  vector<ptr_lib::shared_ptr<Data>> dataList;
+  objectNamespace.getAllData(dataList);
+  for (size_t i = 0; i < dataList.size(); ++i)
+    nBytes += dataList[i]->getDefaultWireEncoding().size();
+  ptr_lib::shared_ptr<BlobObject> blobObject =
+    ptr_lib::dynamic_pointer_cast<BlobObject>(objectNamespace.getObject());
+  if (blobObject)
+    nBytes += blobObject->getBlob().size();
+
+  retainedObjects_.push_back
+    (RetainedObject(sequenceNumber, ndn_getNowMilliseconds(), nBytes));
+  nRetainedBytes_ += nBytes;
+  pruneRetainedObjects();
+}
+
+void
+GeneralizedObjectStreamHandler::Impl::pruneRetainedObjects()
+{
+  MillisecondsSince1970 now = ndn_getNowMilliseconds();
+
+  while (retainedObjects_.size() > 0) {
+    const RetainedObject& oldest = retainedObjects_.front();
+    if (!((maxRetainedObjects_ >= 0 &&
+           retainedObjects_.size() > (size_t)maxRetainedObjects_) ||
+          (retentionPeriod_ >= 0 &&
+           now - oldest.getAddedTime() > retentionPeriod_) ||
+          (maxRetainedBytes_ > 0 && nRetainedBytes_ > maxRetainedBytes_)))
+      break;
+
+    int sequenceNumber = oldest.getSequenceNumber();
+    nRetainedBytes_ -= oldest.getNBytes();
+    retainedObjects_.pop_front();
+
+    // The handler is already released, so this only frees the subtree.
+    namespace_->removeChild
+      (Name::Component::fromSequenceNumber(sequenceNumber), true);
+    if (sequenceNumber > maxPrunedSequenceNumber_)
+      maxPrunedSequenceNumber_ = sequenceNumber;
+  }
+
+  if (retentionPeriod_ < 0 || retainedObjects_.size() == 0 ||
+      isPruneScheduled_)
+    return;
+  Face* face = namespace_->getFace_();
+  if (!face)
+    return;
+
+  // Prune when the oldest object is past the retention period, even if no new
+  // object arrives.
+  Milliseconds delayMilliseconds =
+    retainedObjects_.front().getAddedTime() + retentionPeriod_ - now + 1;
+  if (delayMilliseconds < 0)
+    delayMilliseconds = 0;
+  isPruneScheduled_ = true;
+  face->callLater
+    (delayMilliseconds,
+     bind(&GeneralizedObjectStreamHandler::Impl::onPruneTimeout,
+          shared_from_this()));
+}
+
+void
+GeneralizedObjectStreamHandler::Impl::onPruneTimeout()
+{
+  isPruneScheduled_ = false;
+  if (namespace_->getIsShutDown())
+    return;
+
+  pruneRetainedObjects();
+}
+
 GeneralizedObjectStreamHandler::Values* GeneralizedObjectStreamHandler::values_ = 0;
 
 }
@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include <stdexcept>
+#include <ndn-cpp/security/key-chain.hpp>
+#include <ndn-cpp/util/logging.hpp>
+#include "lazy-segment-producer.hpp"
+
+using namespace std;
+using namespace ndn;
+using namespace ndn::func_lib;
+
+INIT_LOGGER("cnl_cpp.LazySegmentProducer");
+
+namespace cnl_cpp {
+
+LazySegmentProducer::LazySegmentProducer
+  (Namespace& nameSpace, const ptr_lib::shared_ptr<ContentSource>& source,
+   size_t maxSegmentPayloadLength, size_t maxCachedSegments)
+: namespace_(&nameSpace), source_(source),
+  maxSegmentPayloadLength_(maxSegmentPayloadLength),
+  maxCachedSegments_(maxCachedSegments)
+{
+  uint64_t size = source_->size();
+  // Always produce segment 0, even if the content is empty.
+  finalSegment_ = size == 0 ? 0 : (size - 1) / maxSegmentPayloadLength_;
+  finalBlockId_ = Name::Component::fromSegment(finalSegment_);
+}
+
+void
+LazySegmentProducer::initialize()
+{
+  namespace_->addOnObjectNeeded
+    (bind(&LazySegmentProducer::onObjectNeeded, shared_from_this(), _1, _2, _3));
+}
+
+bool
+LazySegmentProducer::onObjectNeeded
+  (Namespace& nameSpace, Namespace& neededNamespace, uint64_t callbackId)
+{
+  if (!(neededNamespace.getParent() == namespace_ &&
+        neededNamespace.getNameComponent().isSegment()))
+    // Not a segment.
+    return false;
+  uint64_t segment = neededNamespace.getNameComponent().toSegment();
+  if (segment > finalSegment_ || neededNamespace.getData())
+    return false;
+
+  try {
+    produceSegment(neededNamespace, segment);
+  } catch (const std::exception& ex) {
+    _LOG_ERROR("LazySegmentProducer: Error producing segment " << segment <<
+               ": " << ex.what());
+    return false;
+  }
+
+  // Remove the least recently produced segments. We just added this segment
+  // at the back, so we don't remove it.
+  while (cachedSegments_.size() > maxCachedSegments_ &&
+         cachedSegments_.size() > 1) {
+    namespace_->removeChild(Name::Component::fromSegment(cachedSegments_.front()));
+    cachedSegments_.pop_front();
+  }
+
+  return true;
+}
+
+void
+LazySegmentProducer::produceSegment
+  (Namespace& segmentNamespace, uint64_t segment)
+{
+  KeyChain* keyChain = namespace_->getKeyChain_();
+  if (!keyChain)
+    throw runtime_error("LazySegmentProducer: There is no KeyChain");
+
+  uint64_t offset = segment * maxSegmentPayloadLength_;
+  size_t payloadLength = maxSegmentPayloadLength_;
+  if (offset + payloadLength > source_->size())
+    payloadLength = source_->size() - offset;
+
+  // Make the name from the prefix so that the segment node doesn't keep a copy
+  // of its name in addition to the Data packet.
+  ptr_lib::shared_ptr<Data> data = ptr_lib::make_shared<Data>
+    (Name(namespace_->getName()).append(segmentNamespace.getNameComponent()));
+  const MetaInfo* metaInfo = namespace_->getNewDataMetaInfo_();
+  if (metaInfo)
+    // Start with a copy of the provided MetaInfo.
+    data->setMetaInfo(*metaInfo);
+  data->getMetaInfo().setFinalBlockId(finalBlockId_);
+  data->setContent(source_->read(offset, payloadLength));
+  keyChain->sign(*data);
+
+  segmentNamespace.setData(data);
+  cachedSegments_.push_back(segment);
+}
+
+}
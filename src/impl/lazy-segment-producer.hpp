@@ -0,0 +1,86 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_LAZY_SEGMENT_PRODUCER_HPP
+#define CNL_CPP_LAZY_SEGMENT_PRODUCER_HPP
+
+#include <deque>
+#include <cnl-cpp/namespace.hpp>
+#include <cnl-cpp/content-source.hpp>
+
+namespace cnl_cpp {
+
+/**
+ * LazySegmentProducer is an internal class used by
+ * SegmentStreamHandler::setObjectFromSource. It adds an OnObjectNeeded callback
+ * to the object Namespace, and when an Interest for a segment arrives it reads
+ * the segment content from the ContentSource, then makes and signs the segment
+ * Data packet. It keeps at most maxCachedSegments produced segments attached
+ * to the Namespace, removing the least recently produced.
+ */
+class LazySegmentProducer
+  : public ndn::ptr_lib::enable_shared_from_this<LazySegmentProducer> {
+public:
+  /**
+   * Create a LazySegmentProducer, which should belong to a shared_ptr, then
+   * call initialize().
+   * @param nameSpace The Namespace node for the object, whose children are the
+   * segments.
+   * @param source The ContentSource of the object content.
+   * @param maxSegmentPayloadLength The maximum length of each segment content.
+   * @param maxCachedSegments The maximum number of produced segments to keep.
+   */
+  LazySegmentProducer
+    (Namespace& nameSpace, const ndn::ptr_lib::shared_ptr<ContentSource>& source,
+     size_t maxSegmentPayloadLength, size_t maxCachedSegments);
+
+  /**
+   * Add the OnObjectNeeded callback to the Namespace, which keeps a shared_ptr
+   * to this object.
+   */
+  void
+  initialize();
+
+private:
+  bool
+  onObjectNeeded
+    (Namespace& nameSpace, Namespace& neededNamespace, uint64_t callbackId);
+
+  /**
+   * Make and sign the Data packet for the segment and attach it to
+   * segmentNamespace, which satisfies the pending Interests.
+   */
+  void
+  produceSegment(Namespace& segmentNamespace, uint64_t segment);
+
+  Namespace* namespace_;
+  ndn::ptr_lib::shared_ptr<ContentSource> source_;
+  size_t maxSegmentPayloadLength_;
+  size_t maxCachedSegments_;
+  uint64_t finalSegment_;
+  ndn::Name::Component finalBlockId_;
+  // The segment numbers of produced segments, least recent first.
+  std::deque<uint64_t> cachedSegments_;
+};
+
+}
+
+#endif
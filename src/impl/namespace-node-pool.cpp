@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include "namespace-node-pool.hpp"
+
+using namespace std;
+
+namespace cnl_cpp {
+
+NamespaceNodePool::~NamespaceNodePool()
+{
+  // All blocks have been deallocated, so there are no empty slabs left except
+  // the last one for each size class.
+  for (size_t i = 0; i < sizeClasses_.size(); ++i) {
+    for (size_t j = 0; j < sizeClasses_[i].availableSlabs_.size(); ++j)
+      delete sizeClasses_[i].availableSlabs_[j];
+  }
+}
+
+void*
+NamespaceNodePool::allocate(size_t size)
+{
+  size_t blockSize =
+    ((headerSize_ + size + granularity_ - 1) / granularity_) * granularity_;
+  if (blockSize > maxBlockSize_)
+    return ::operator new(size);
+
+  size_t iSizeClass = blockSize / granularity_;
+  if (iSizeClass >= sizeClasses_.size())
+    sizeClasses_.resize(iSizeClass + 1);
+  SizeClass& sizeClass = sizeClasses_[iSizeClass];
+
+  if (sizeClass.availableSlabs_.size() == 0) {
+    sizeClass.availableSlabs_.push_back
+      (new Slab(blockSize, slabSize_ / blockSize));
+    ++sizeClass.nSlabs_;
+  }
+
+  Slab* slab = sizeClass.availableSlabs_.back();
+  uint8_t* block = static_cast<uint8_t*>(slab->allocate());
+  if (slab->isFull())
+    sizeClass.availableSlabs_.pop_back();
+
+  *reinterpret_cast<Slab**>(block) = slab;
+  return block + headerSize_;
+}
+
+void
+NamespaceNodePool::deallocate(void* block, size_t size)
+{
+  if (!block)
+    return;
+
+  size_t blockSize =
+    ((headerSize_ + size + granularity_ - 1) / granularity_) * granularity_;
+  if (blockSize > maxBlockSize_) {
+    ::operator delete(block);
+    return;
+  }
+
+  SizeClass& sizeClass = sizeClasses_[blockSize / granularity_];
+  uint8_t* blockStart = static_cast<uint8_t*>(block) - headerSize_;
+  Slab* slab = *reinterpret_cast<Slab**>(blockStart);
+
+  bool wasFull = slab->isFull();
+  slab->deallocate(blockStart);
+  if (wasFull)
+    // It has a free block again.
+    sizeClass.availableSlabs_.push_back(slab);
+
+  if (slab->isEmpty() && sizeClass.nSlabs_ > 1) {
+    // Free the memory of the slab, but keep one slab for new allocations.
+    for (size_t i = 0; i < sizeClass.availableSlabs_.size(); ++i) {
+      if (sizeClass.availableSlabs_[i] == slab) {
+        sizeClass.availableSlabs_.erase(sizeClass.availableSlabs_.begin() + i);
+        break;
+      }
+    }
+    delete slab;
+    --sizeClass.nSlabs_;
+  }
+}
+
+NamespaceNodePool::Slab::Slab(size_t blockSize, size_t nBlocks)
+: blockSize_(blockSize), nUnusedBlocks_(nBlocks), freeList_(0),
+  nAllocatedBlocks_(0)
+{
+  if (nUnusedBlocks_ < 1)
+    nUnusedBlocks_ = 1;
+  memory_ = static_cast<uint8_t*>(::operator new(blockSize_ * nUnusedBlocks_));
+  nextUnusedBlock_ = memory_;
+}
+
+NamespaceNodePool::Slab::~Slab()
+{
+  ::operator delete(memory_);
+}
+
+void*
+NamespaceNodePool::Slab::allocate()
+{
+  void* block;
+  if (freeList_) {
+    block = freeList_;
+    freeList_ = freeList_->next;
+  }
+  else if (nUnusedBlocks_ > 0) {
+    block = nextUnusedBlock_;
+    nextUnusedBlock_ += blockSize_;
+    --nUnusedBlocks_;
+  }
+  else
+    return 0;
+
+  ++nAllocatedBlocks_;
+  return block;
+}
+
+void
+NamespaceNodePool::Slab::deallocate(void* block)
+{
+  FreeBlock* freeBlock = static_cast<FreeBlock*>(block);
+  freeBlock->next = freeList_;
+  freeList_ = freeBlock;
+  --nAllocatedBlocks_;
+}
+
+}
@@ -0,0 +1,222 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_NAMESPACE_NODE_POOL_HPP
+#define CNL_CPP_NAMESPACE_NODE_POOL_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <ndn-cpp/common.hpp>
+
+namespace cnl_cpp {
+
+/**
+ * NamespaceNodePool is an internal class for the root Namespace node to
+ * allocate the memory for the Namespace and Namespace::Impl objects (and their
+ * shared_ptr control blocks) of the nodes in the tree. Blocks of the same size
+ * are carved out of large slabs so that the nodes are close together in memory
+ * and each node doesn't need separate heap allocations. When a slab has no more
+ * allocated blocks (for example, when a subtree is removed), the slab is freed.
+ * A size larger than maxBlockSize_ is allocated with operator new.
+ */
+class NamespaceNodePool {
+public:
+  ~NamespaceNodePool();
+
+  /**
+   * Allocate a block of memory.
+   * @param size The number of bytes.
+   * @return A pointer to the block, aligned for any type.
+   */
+  void*
+  allocate(size_t size);
+
+  /**
+   * Return the block to the pool.
+   * @param block The pointer returned by allocate().
+   * @param size The size that was given to allocate().
+   */
+  void
+  deallocate(void* block, size_t size);
+
+private:
+  class Slab;
+
+  /**
+   * SizeClass holds the slabs for one block size.
+   */
+  class SizeClass {
+  public:
+    SizeClass()
+    : nSlabs_(0)
+    {}
+
+    // The slabs which have a free block. The last one is used first.
+    std::vector<Slab*> availableSlabs_;
+    size_t nSlabs_;
+  };
+
+  /**
+   * A Slab holds the memory for a number of blocks of the same size, a list of
+   * blocks which are free, and the count of allocated blocks.
+   */
+  class Slab {
+  public:
+    Slab(size_t blockSize, size_t nBlocks);
+
+    ~Slab();
+
+    /**
+     * Get a free block.
+     * @return The block, or null if there are no free blocks.
+     */
+    void*
+    allocate();
+
+    void
+    deallocate(void* block);
+
+    bool
+    isFull() const { return !freeList_ && nUnusedBlocks_ == 0; }
+
+    bool
+    isEmpty() const { return nAllocatedBlocks_ == 0; }
+
+  private:
+    /**
+     * A FreeBlock is the beginning of a free block, linked to the next.
+     */
+    struct FreeBlock {
+      FreeBlock* next;
+    };
+
+    size_t blockSize_;
+    uint8_t* memory_;
+    // The blocks at the end of memory_ which have never been allocated.
+    size_t nUnusedBlocks_;
+    uint8_t* nextUnusedBlock_;
+    FreeBlock* freeList_;
+    size_t nAllocatedBlocks_;
+  };
+
+  // Each block starts with a header to point to its Slab. Use the maximum
+  // alignment so that the memory after the header is aligned for any type.
+  static const size_t headerSize_ = 16;
+  // Block sizes (including the header) are rounded up to this.
+  static const size_t granularity_ = 16;
+  static const size_t maxBlockSize_ = 4096;
+  static const size_t slabSize_ = 64 * 1024;
+
+  // The index is the block size / granularity_.
+  std::vector<SizeClass> sizeClasses_;
+};
+
+/**
+ * NamespaceNodePoolAllocator is an allocator for shared_ptr and allocate_shared
+ * which allocates from a NamespaceNodePool. Each copy holds a shared_ptr to the
+ * pool so that the pool remains as long as any allocated object.
+ */
+template<class T>
+class NamespaceNodePoolAllocator {
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template<class U>
+  struct rebind {
+    typedef NamespaceNodePoolAllocator<U> other;
+  };
+
+  NamespaceNodePoolAllocator
+    (const ndn::ptr_lib::shared_ptr<NamespaceNodePool>& pool)
+  : pool_(pool)
+  {}
+
+  template<class U>
+  NamespaceNodePoolAllocator(const NamespaceNodePoolAllocator<U>& other)
+  : pool_(other.pool_)
+  {}
+
+  T*
+  allocate(size_t n, const void* hint = 0)
+  {
+    return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+  }
+
+  void
+  deallocate(T* p, size_t n) { pool_->deallocate(p, n * sizeof(T)); }
+
+  size_t
+  max_size() const { return (size_t)-1 / sizeof(T); }
+
+  void
+  construct(T* p, const T& value) { new (p) T(value); }
+
+  void
+  destroy(T* p) { p->~T(); }
+
+  template<class U>
+  bool
+  operator==(const NamespaceNodePoolAllocator<U>& other) const
+  {
+    return pool_ == other.pool_;
+  }
+
+  template<class U>
+  bool
+  operator!=(const NamespaceNodePoolAllocator<U>& other) const
+  {
+    return pool_ != other.pool_;
+  }
+
+  ndn::ptr_lib::shared_ptr<NamespaceNodePool> pool_;
+};
+
+/**
+ * NamespaceNodePoolDeleter is a shared_ptr deleter for an object which was
+ * constructed in memory from NamespaceNodePoolAllocator::allocate(1).
+ */
+template<class T>
+class NamespaceNodePoolDeleter {
+public:
+  NamespaceNodePoolDeleter(const NamespaceNodePoolAllocator<T>& allocator)
+  : allocator_(allocator)
+  {}
+
+  void
+  operator()(T* p)
+  {
+    p->~T();
+    allocator_.deallocate(p, 1);
+  }
+
+private:
+  NamespaceNodePoolAllocator<T> allocator_;
+};
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include "parallel-for.hpp"
+
+using namespace std;
+using namespace ndn;
+
+namespace cnl_cpp {
+
+ParallelFor::~ParallelFor()
+{
+  {
+    lock_guard<mutex> lock(mutex_);
+    isShutDown_ = true;
+  }
+  workReady_.notify_all();
+
+  for (size_t i = 0; i < threads_.size(); ++i)
+    threads_[i].join();
+}
+
+void
+ParallelFor::run(int nThreads, size_t nItems, const Work& work)
+{
+  if (nItems == 0)
+    return;
+  if (nThreads < 1)
+    nThreads = 1;
+  if ((size_t)nThreads > nItems)
+    nThreads = nItems;
+  if (nThreads == 1) {
+    work(0, nItems);
+    return;
+  }
+
+  size_t rangeSize = (nItems + nThreads - 1) / nThreads;
+  size_t nRanges = (nItems + rangeSize - 1) / rangeSize;
+
+  {
+    lock_guard<mutex> lock(mutex_);
+    work_ = &work;
+    nItems_ = nItems;
+    rangeSize_ = rangeSize;
+    nRanges_ = nRanges;
+    nPending_ = nRanges - 1;
+    errors_.assign(nRanges, exception_ptr());
+    ++generation_;
+
+    // Start more worker threads if needed. A new thread waits for the lock,
+    // and then does its range for this generation.
+    while (threads_.size() < nRanges - 1)
+      threads_.push_back(thread
+        (&ParallelFor::workerLoop, this, threads_.size() + 1, generation_ - 1));
+  }
+  workReady_.notify_all();
+
+  // Do the first range on this thread.
+  try {
+    work(0, rangeSize);
+  } catch (...) {
+    errors_[0] = current_exception();
+  }
+
+  unique_lock<mutex> lock(mutex_);
+  while (nPending_ > 0)
+    workDone_.wait(lock);
+  work_ = 0;
+
+  for (size_t i = 0; i < errors_.size(); ++i) {
+    if (errors_[i]) {
+      exception_ptr error = errors_[i];
+      errors_.clear();
+      rethrow_exception(error);
+    }
+  }
+}
+
+void
+ParallelFor::workerLoop(size_t rangeIndex, uint64_t generation)
+{
+  unique_lock<mutex> lock(mutex_);
+  while (true) {
+    while (!isShutDown_ && generation_ == generation)
+      workReady_.wait(lock);
+    if (isShutDown_)
+      return;
+    generation = generation_;
+    if (rangeIndex >= nRanges_)
+      // This run() doesn't need this thread.
+      continue;
+
+    size_t begin = rangeIndex * rangeSize_;
+    size_t end = begin + rangeSize_ < nItems_ ? begin + rangeSize_ : nItems_;
+    const Work& work = *work_;
+    lock.unlock();
+    exception_ptr error;
+    try {
+      work(begin, end);
+    } catch (...) {
+      error = current_exception();
+    }
+    lock.lock();
+
+    errors_[rangeIndex] = error;
+    if (--nPending_ == 0)
+      workDone_.notify_one();
+  }
+}
+
+}
@@ -0,0 +1,105 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_PARALLEL_FOR_HPP
+#define CNL_CPP_PARALLEL_FOR_HPP
+
+#include <stddef.h>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ndn-cpp/common.hpp>
+
+namespace cnl_cpp {
+
+/**
+ * ParallelFor splits a loop over items into contiguous ranges and runs them on
+ * worker threads. It keeps the worker threads so that repeated calls to run()
+ * don't create new threads. The worker threads are stopped when this object is
+ * deleted.
+ */
+class ParallelFor {
+public:
+  typedef ndn::func_lib::function<void(size_t begin, size_t end)> Work;
+
+  ParallelFor()
+  : work_(0), nItems_(0), rangeSize_(0), nRanges_(0), nPending_(0),
+    generation_(0), isShutDown_(false)
+  {}
+
+  ~ParallelFor();
+
+  /**
+   * Split the items 0 to nItems - 1 into contiguous ranges and call work(begin,
+   * end) for each range on its own thread, using the calling thread for the
+   * first range. Return when all ranges are done. This starts more worker
+   * threads if needed and keeps them for the next call. The work function must
+   * not use objects which are not thread safe, such as a Namespace or KeyChain.
+   * Only one thread at a time may call run().
+   * @param nThreads The number of threads to use, including the calling thread.
+   * If this is 1 or less, or if nItems is 1, just call work(0, nItems) on the
+   * calling thread.
+   * @param nItems The number of items.
+   * @param work The function to process the items from begin up to (but not
+   * including) end.
+   * @throws The first exception thrown by a call to work, after all threads are
+   * done.
+   */
+  void
+  run(int nThreads, size_t nItems, const Work& work);
+
+private:
+  /**
+   * This is the loop of the worker thread for the range at rangeIndex.
+   * @param generation The value of generation_ for the run() which has already
+   * been done.
+   */
+  void
+  workerLoop(size_t rangeIndex, uint64_t generation);
+
+  // Disable the copy constructor and assignment operator.
+  ParallelFor(const ParallelFor& other);
+  ParallelFor& operator=(const ParallelFor& other);
+
+  // The worker thread at index i does the range i + 1.
+  std::vector<std::thread> threads_;
+  // The mutex guards the following members.
+  std::mutex mutex_;
+  std::condition_variable workReady_;
+  std::condition_variable workDone_;
+  // The parameters of the current run().
+  const Work* work_;
+  size_t nItems_;
+  size_t rangeSize_;
+  size_t nRanges_;
+  // The number of ranges which the worker threads have not finished.
+  size_t nPending_;
+  std::vector<std::exception_ptr> errors_;
+  // This is incremented by each run() which uses the worker threads.
+  uint64_t generation_;
+  bool isShutDown_;
+};
+
+}
+
+#endif
@@ -27,13 +27,21 @@ INIT_LOGGER("ndn.PendingIncomingInterestTable");
 
 using namespace std;
 using namespace ndn;
+using namespace ndn::func_lib;
 
 namespace cnl_cpp {
 
+const Milliseconds
+PendingIncomingInterestTable::TIMER_WHEEL_TICK_MILLISECONDS = 100.0;
+
 PendingIncomingInterestTable::Entry::Entry
   (const ptr_lib::shared_ptr<const Interest>& interest, Face& face)
-: interest_(interest), face_(face)
+: interest_(interest), node_(0), isRemoved_(false)
 {
+  faces_.push_back(&face);
+  if (interest_->getNonce().size() > 0)
+    nonces_.push_back(interest_->getNonce());
+
   // Set up timeoutTimeMilliseconds_.
   if (interest_->getInterestLifetimeMilliseconds() >= 0.0)
     timeoutTimeMilliseconds_ = ndn_getNowMilliseconds() +
@@ -43,34 +51,340 @@ PendingIncomingInterestTable::Entry::Entry
     timeoutTimeMilliseconds_ = -1.0;
 }
 
+bool
+PendingIncomingInterestTable::Entry::aggregate
+  (const Interest& interest, Face& face)
+{
+  const Blob& nonce = interest.getNonce();
+  if (nonce.size() > 0) {
+    for (size_t i = 0; i < nonces_.size(); ++i) {
+      if (nonces_[i].equals(nonce))
+        // A duplicate Interest.
+        return false;
+    }
+    nonces_.push_back(nonce);
+  }
+
+  if (std::find(faces_.begin(), faces_.end(), &face) == faces_.end())
+    faces_.push_back(&face);
+
+  // Keep the entry until the last aggregated Interest times out.
+  if (timeoutTimeMilliseconds_ >= 0.0) {
+    if (interest.getInterestLifetimeMilliseconds() >= 0.0) {
+      MillisecondsSince1970 timeoutTimeMilliseconds = ndn_getNowMilliseconds() +
+        interest.getInterestLifetimeMilliseconds();
+      if (timeoutTimeMilliseconds > timeoutTimeMilliseconds_)
+        // onTimerTick will put the entry back in the timer wheel.
+        timeoutTimeMilliseconds_ = timeoutTimeMilliseconds;
+    }
+    else
+      // No timeout.
+      timeoutTimeMilliseconds_ = -1.0;
+  }
+
+  return true;
+}
+
+PendingIncomingInterestTable::PendingIncomingInterestTable
+  (Face& face, size_t maxEntries)
+: face_(face), maxEntries_(maxEntries), nameTreeRoot_(0, Name::Component()),
+  nTimerWheelEntries_(0), timerWheelPosition_(0),
+  timerWheelTimeMilliseconds_(0), isTimerScheduled_(false), hitCount_(0),
+  expirationCount_(0), evictionCount_(0), aggregationCount_(0)
+{
+}
+
+bool
+PendingIncomingInterestTable::add
+  (const ptr_lib::shared_ptr<const Interest>& interest, Face& face)
+{
+  // Find the node for the Interest name, not including an implicit digest
+  // which satisfyInterests checks with the full Data name.
+  const Name& name = interest->getName();
+  int nComponents = name.size();
+  if (nComponents >= 1 && name[-1].isImplicitSha256Digest())
+    --nComponents;
+  NameTreeNode* node = &nameTreeRoot_;
+  for (int i = 0; i < nComponents && node; ++i) {
+    std::map<Name::Component, ptr_lib::shared_ptr<NameTreeNode> >::iterator
+      child = node->children_.find(name[i]);
+    node = (child == node->children_.end() ? 0 : child->second.get());
+  }
+
+  if (node) {
+    // Try to aggregate with an existing entry.
+    for (size_t i = 0; i < node->entries_.size(); ++i) {
+      Entry& entry = *node->entries_[i];
+      if (entry.isSameInterest(*interest)) {
+        if (entry.aggregate(*interest, face))
+          ++aggregationCount_;
+        return false;
+      }
+    }
+  }
+
+  if (maxEntries_ > 0 && arrivalOrder_.size() >= maxEntries_) {
+    _LOG_DEBUG("PendingIncomingInterestTable: Evicting the oldest entry " <<
+               arrivalOrder_.front()->interest_->getName().toUri());
+    // This may remove the node for the Interest name, so find it again below.
+    remove(ptr_lib::shared_ptr<Entry>(arrivalOrder_.front()));
+    ++evictionCount_;
+  }
+
+  ptr_lib::shared_ptr<Entry> entry = ptr_lib::make_shared<Entry>(interest, face);
+
+  // Find or create the node for the Interest name.
+  node = &nameTreeRoot_;
+  for (int i = 0; i < nComponents; ++i) {
+    ptr_lib::shared_ptr<NameTreeNode>& child = node->children_[name[i]];
+    if (!child)
+      child = ptr_lib::make_shared<NameTreeNode>(node, name[i]);
+    node = child.get();
+  }
+
+  entry->node_ = node;
+  node->entries_.push_back(entry);
+  entry->arrivalPosition_ = arrivalOrder_.insert(arrivalOrder_.end(), entry);
+
+  if (entry->timeoutTimeMilliseconds_ >= 0.0)
+    addToTimerWheel(entry);
+  return true;
+}
+
 void
 PendingIncomingInterestTable::satisfyInterests(const Data& data)
 {
-  Milliseconds nowMilliseconds = ndn_getNowMilliseconds();
+  MillisecondsSince1970 nowMilliseconds = ndn_getNowMilliseconds();
+  const Name& dataName = data.getName();
+  ptr_lib::shared_ptr<Name> fullName;
+
+  // Collect the matching entries first since sending can re-enter the table.
+  vector<ptr_lib::shared_ptr<Entry> > matches;
+  vector<ptr_lib::shared_ptr<Entry> > timedOut;
+  NameTreeNode* node = &nameTreeRoot_;
+  for (size_t i = 0; node; ++i) {
+    for (size_t j = 0; j < node->entries_.size(); ++j) {
+      const ptr_lib::shared_ptr<Entry>& pendingInterest = node->entries_[j];
+      if (pendingInterest->isTimedOut(nowMilliseconds)) {
+        // The timer wheel has not reached it yet.
+        timedOut.push_back(pendingInterest);
+        continue;
+      }
 
-  // Go backwards through the list so we can erase entries.
-  for (int i = (int)table_.size() - 1; i >= 0; --i) {
-    Entry& pendingInterest = *table_[i];
-    if (pendingInterest.isTimedOut(nowMilliseconds)) {
-      table_.erase(table_.begin() + i);
+      // TODO: Use matchesData to match selectors?
+      const Name& interestName = pendingInterest->interest_->getName();
+      bool isMatch;
+      if (interestName.size() >= 1 && interestName[-1].isImplicitSha256Digest()) {
+        if (!fullName)
+          fullName = data.getFullName();
+        isMatch = pendingInterest->interest_->matchesName(*fullName);
+      }
+      else
+        isMatch = pendingInterest->interest_->matchesName(dataName);
+
+      if (isMatch)
+        matches.push_back(pendingInterest);
+    }
+
+    if (i >= dataName.size())
+      break;
+    std::map<Name::Component, ptr_lib::shared_ptr<NameTreeNode> >::iterator
+      child = node->children_.find(dataName[i]);
+    node = (child == node->children_.end() ? 0 : child->second.get());
+  }
+
+  for (size_t i = 0; i < timedOut.size(); ++i) {
+    remove(timedOut[i]);
+    ++expirationCount_;
+  }
+
+  // Get the faces to send to, without duplicates.
+  vector<Face*> faces;
+  for (size_t i = 0; i < matches.size(); ++i) {
+    Entry& pendingInterest = *matches[i];
+    if (pendingInterest.isRemoved_)
       continue;
+    remove(matches[i]);
+    ++hitCount_;
+
+    for (size_t j = 0; j < pendingInterest.faces_.size(); ++j) {
+      Face* face = pendingInterest.faces_[j];
+      if (std::find(faces.begin(), faces.end(), face) == faces.end())
+        faces.push_back(face);
     }
+  }
 
-    // TODO: Use matchesData to match selectors?
-    if (pendingInterest.getInterest()->matchesName(data.getName())) {
-      try {
-        // Send to the same face from the original call to the OnInterest
-        // callback. wireEncode returns the cached encoding if available.
-        pendingInterest.getFace().send(data.wireEncode());
-      } catch (const std::exception& ex) {
-        _LOG_ERROR("PendingIncomingInterestTable: Error sending data: " << ex.what());
-      } catch (...) {
-        _LOG_ERROR("PendingIncomingInterestTable: Error sending data.");
-      }
+  if (faces.size() == 0)
+    return;
+  // wireEncode returns the cached encoding if available.
+  SignedBlob encoding = data.wireEncode();
+  for (size_t i = 0; i < faces.size(); ++i) {
+    try {
+      // Send to the same face from the original call to the OnInterest
+      // callback.
+      faces[i]->send(encoding);
+    } catch (const std::exception& ex) {
+      _LOG_ERROR("PendingIncomingInterestTable: Error sending data: " << ex.what());
+    } catch (...) {
+      _LOG_ERROR("PendingIncomingInterestTable: Error sending data.");
+    }
+  }
+}
+
+void
+PendingIncomingInterestTable::setMaxEntries(size_t maxEntries)
+{
+  maxEntries_ = maxEntries;
+
+  while (maxEntries_ > 0 && arrivalOrder_.size() > maxEntries_) {
+    _LOG_DEBUG("PendingIncomingInterestTable: Evicting the oldest entry " <<
+               arrivalOrder_.front()->interest_->getName().toUri());
+    remove(ptr_lib::shared_ptr<Entry>(arrivalOrder_.front()));
+    ++evictionCount_;
+  }
+}
+
+size_t
+PendingIncomingInterestTable::removeUnderPrefix(const Name& prefix)
+{
+  NameTreeNode* node = &nameTreeRoot_;
+  for (size_t i = 0; i < prefix.size(); ++i) {
+    std::map<Name::Component, ptr_lib::shared_ptr<NameTreeNode> >::iterator
+      child = node->children_.find(prefix[i]);
+    if (child == node->children_.end())
+      // No entries under the prefix.
+      return 0;
+    node = child->second.get();
+  }
+
+  // Collect the entries first since remove() deletes empty tree nodes.
+  vector<ptr_lib::shared_ptr<Entry> > entries;
+  vector<NameTreeNode*> nodes;
+  nodes.push_back(node);
+  while (nodes.size() > 0) {
+    NameTreeNode* subtreeNode = nodes.back();
+    nodes.pop_back();
+    entries.insert
+      (entries.end(), subtreeNode->entries_.begin(), subtreeNode->entries_.end());
+    for (std::map<Name::Component, ptr_lib::shared_ptr<NameTreeNode> >::iterator
+           child = subtreeNode->children_.begin();
+         child != subtreeNode->children_.end(); ++child)
+      nodes.push_back(child->second.get());
+  }
+
+  for (size_t i = 0; i < entries.size(); ++i)
+    remove(entries[i]);
+
+  return entries.size();
+}
+
+void
+PendingIncomingInterestTable::remove(const ptr_lib::shared_ptr<Entry>& entry)
+{
+  if (entry->isRemoved_)
+    return;
+  entry->isRemoved_ = true;
 
-      table_.erase(table_.begin() + i);
+  // Keep a reference since erasing from the containers may release it.
+  ptr_lib::shared_ptr<Entry> entryCopy(entry);
+  arrivalOrder_.erase(entryCopy->arrivalPosition_);
+
+  NameTreeNode* node = entryCopy->node_;
+  entryCopy->node_ = 0;
+  vector<ptr_lib::shared_ptr<Entry> >& entries = node->entries_;
+  entries.erase(std::find(entries.begin(), entries.end(), entryCopy));
+
+  // Remove nodes which no longer have entries or children.
+  while (node->parent_ && node->entries_.size() == 0 &&
+         node->children_.size() == 0) {
+    NameTreeNode* parent = node->parent_;
+    // This deletes node.
+    parent->children_.erase(node->component_);
+    node = parent;
+  }
+}
+
+void
+PendingIncomingInterestTable::addToTimerWheel
+  (const ptr_lib::shared_ptr<Entry>& entry)
+{
+  if (!isTimerScheduled_) {
+    // Start the wheel at the current time.
+    timerWheelTimeMilliseconds_ = ndn_getNowMilliseconds();
+    isTimerScheduled_ = true;
+    face_.callLater
+      (TIMER_WHEEL_TICK_MILLISECONDS,
+       bind(&PendingIncomingInterestTable::onTimerTick, shared_from_this()));
+  }
+
+  // Put the entry in the slot of the first tick at or after its timeout. If
+  // this is more than one turn of the wheel, onTimerTick keeps it for later.
+  int nTicks = (int)((entry->timeoutTimeMilliseconds_ -
+                      timerWheelTimeMilliseconds_) /
+                     TIMER_WHEEL_TICK_MILLISECONDS) + 1;
+  if (nTicks < 1)
+    nTicks = 1;
+  if (nTicks > TIMER_WHEEL_SIZE)
+    nTicks = TIMER_WHEEL_SIZE;
+  timerWheel_[(timerWheelPosition_ + nTicks) % TIMER_WHEEL_SIZE].push_back
+    (entry);
+  ++nTimerWheelEntries_;
+}
+
+void
+PendingIncomingInterestTable::onTimerTick()
+{
+  MillisecondsSince1970 nowMilliseconds = ndn_getNowMilliseconds();
+
+  // The callback may be late, so process each slot for the elapsed time, but
+  // at most one turn of the wheel.
+  int nTicks = 0;
+  while (nTicks < TIMER_WHEEL_SIZE &&
+         timerWheelTimeMilliseconds_ + TIMER_WHEEL_TICK_MILLISECONDS <=
+           nowMilliseconds) {
+    timerWheelTimeMilliseconds_ += TIMER_WHEEL_TICK_MILLISECONDS;
+    ++nTicks;
+  }
+  if (nTicks == TIMER_WHEEL_SIZE)
+    // We skipped more than a turn. Don't try to catch up the wheel time.
+    timerWheelTimeMilliseconds_ = nowMilliseconds;
+
+  vector<ptr_lib::shared_ptr<Entry> > later;
+  for (int i = 0; i < nTicks; ++i) {
+    timerWheelPosition_ = (timerWheelPosition_ + 1) % TIMER_WHEEL_SIZE;
+    vector<ptr_lib::shared_ptr<Entry> > slot;
+    slot.swap(timerWheel_[timerWheelPosition_]);
+    nTimerWheelEntries_ -= slot.size();
+
+    for (size_t j = 0; j < slot.size(); ++j) {
+      const ptr_lib::shared_ptr<Entry>& entry = slot[j];
+      if (entry->isRemoved_)
+        continue;
+
+      if (entry->timeoutTimeMilliseconds_ < 0.0)
+        // aggregate() removed the timeout.
+        continue;
+      if (entry->isTimedOut(nowMilliseconds)) {
+        _LOG_DEBUG("PendingIncomingInterestTable: Timed out " <<
+                   entry->interest_->getName().toUri());
+        remove(entry);
+        ++expirationCount_;
+      }
+      else
+        // The timeout is on a later turn of the wheel.
+        later.push_back(entry);
     }
   }
+
+  isTimerScheduled_ = false;
+  if (nTimerWheelEntries_ > 0 || later.size() > 0) {
+    isTimerScheduled_ = true;
+    face_.callLater
+      (TIMER_WHEEL_TICK_MILLISECONDS,
+       bind(&PendingIncomingInterestTable::onTimerTick, shared_from_this()));
+  }
+  for (size_t i = 0; i < later.size(); ++i)
+    addToTimerWheel(later[i]);
 }
 
 }
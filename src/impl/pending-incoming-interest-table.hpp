@@ -22,19 +22,31 @@
 #ifndef NDN_PENDING_INCOMING_INTEREST_TABLE_HPP
 #define NDN_PENDING_INCOMING_INTEREST_TABLE_HPP
 
+#include <map>
+#include <list>
 #include <ndn-cpp/face.hpp>
 
 namespace cnl_cpp {
 
 /**
  * PendingImcomingInterestTable is an internal class to hold a list of
- * Interests which OnInterest received but could not satisfy.
+ * Interests which OnInterest received but could not satisfy. The entries are
+ * indexed by a tree of the Interest name components, so that matching a Data
+ * packet only visits the entries whose Interest name is a prefix of the Data
+ * name. Timed-out entries are removed by a timer wheel which is driven by
+ * Face::callLater.
  */
-class PendingIncomingInterestTable {
+class PendingIncomingInterestTable
+  : public ndn::ptr_lib::enable_shared_from_this<PendingIncomingInterestTable> {
+private:
+  class NameTreeNode;
+
 public:
   /**
    * Entry holds the Interest and other fields for an entry in the pending
-   * interest table.
+   * interest table. Like the PIT of a forwarder, one entry aggregates all the
+   * Interests with the same name and selectors, and records the faces and
+   * nonces from each.
    */
   class Entry {
   public:
@@ -59,11 +71,26 @@ public:
     getInterest() { return interest_; }
 
     /**
-     * Get the face given to the constructor.
-     * @return The face.
+     * Get the faces of the aggregated Interests, without duplicates. The first
+     * is the face given to the constructor.
+     * @return The faces.
      */
-    ndn::Face&
-    getFace() { return face_; }
+    const std::vector<ndn::Face*>&
+    getFaces() { return faces_; }
+
+    /**
+     * Check if the other Interest has the same name and selectors as the
+     * Interest of this entry, so that it can be aggregated.
+     * @param interest The other Interest.
+     * @return True if the Interest can be aggregated with this entry.
+     */
+    bool
+    isSameInterest(const ndn::Interest& interest)
+    {
+      return interest.getName().equals(interest_->getName()) &&
+             interest.getCanBePrefix() == interest_->getCanBePrefix() &&
+             interest.getMustBeFresh() == interest_->getMustBeFresh();
+    }
 
     /**
      * Check if this Interest is timed out.
@@ -77,41 +104,208 @@ public:
              nowMilliseconds >= timeoutTimeMilliseconds_;
     }
 
+    /**
+     * Get the time when this Interest times out.
+     * @return The time in milliseconds since 1/1/1970 UTC, or -1 if the
+     * Interest has no lifetime.
+     */
+    ndn::MillisecondsSince1970
+    getTimeoutTimeMilliseconds() { return timeoutTimeMilliseconds_; }
+
   private:
+    friend class PendingIncomingInterestTable;
+
+    /**
+     * Add the face and nonce of another Interest for which isSameInterest is
+     * true, and extend the timeout time to its lifetime.
+     * @param interest The other Interest.
+     * @param face The face from the OnInterest callback.
+     * @return True if the Interest was added, or false if the entry already has
+     * its nonce so that it is a duplicate (or looped) Interest.
+     */
+    bool
+    aggregate(const ndn::Interest& interest, ndn::Face& face);
+
     ndn::ptr_lib::shared_ptr<const ndn::Interest> interest_;
-    ndn::Face& face_;
+    std::vector<ndn::Face*> faces_;
+    std::vector<ndn::Blob> nonces_;
     ndn::MillisecondsSince1970 timeoutTimeMilliseconds_;
+    // The following are maintained by the PendingIncomingInterestTable.
+    NameTreeNode* node_;
+    std::list<ndn::ptr_lib::shared_ptr<Entry> >::iterator arrivalPosition_;
+    bool isRemoved_;
   };
 
+  /**
+   * Create a PendingIncomingInterestTable.
+   * @param face The Face whose callLater is used to remove timed-out entries.
+   * @param maxEntries (optional) The maximum number of entries. When a new
+   * entry would exceed this, the oldest entry is evicted. If omitted, use
+   * getDEFAULT_MAX_ENTRIES().
+   */
+  PendingIncomingInterestTable
+    (ndn::Face& face, size_t maxEntries = getDEFAULT_MAX_ENTRIES());
+
   /**
    * Store an interest from an OnInterest callback in the internal pending
    * interest table. Use satisfyInterests(data) to check if the Data packet
-   * satisfies any pending interest.
+   * satisfies any pending interest. If there is already an entry with the same
+   * name and selectors, add the face and nonce to it instead of making a new
+   * entry. If the table is full, this first evicts the oldest entry.
    * @param interest The Interest for which we don't have a Data packet yet.
    * You should not modify the interest after calling this.
    * @param face The Face from the OnInterest callback with the connection which
    * received the Interest and to which satisfyInterests will send the Data
    * packet.
+   * @return True if this made a new entry, or false if the Interest was
+   * aggregated with an existing entry (or is a duplicate). Only a new entry
+   * needs to ask for the object to be produced.
    */
-  void
+  bool
   add
     (const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest,
-     ndn::Face& face)
-  {
-    table_.push_back(ndn::ptr_lib::make_shared<Entry>(interest, face));
-  }
+     ndn::Face& face);
 
   /**
-   * Remove timed-out Interests, then for each pending Interest that the Data
-   * packet matches, send the Data packet through the face and remove the
-   * pending Interest.
+   * For each pending Interest that the Data packet matches, send the Data
+   * packet through the faces and remove the pending Interest. This sends the
+   * Data packet once to each face, even if the face has more than one matching
+   * Interest. This only checks the entries whose Interest name is a prefix of
+   * the Data name.
    * @param data The Data packet to send if it satisfies an Interest.
    */
   void
   satisfyInterests(const ndn::Data& data);
 
+  /**
+   * Remove the entries whose Interest name has the given prefix, for example
+   * because the Namespace subtree for the prefix was removed and can't
+   * satisfy them. This only visits the entries under the prefix.
+   * @param prefix The name prefix.
+   * @return The number of removed entries.
+   */
+  size_t
+  removeUnderPrefix(const ndn::Name& prefix);
+
+  /**
+   * Get the number of entries in the table. This counts an entry with
+   * aggregated Interests once.
+   * @return The number of entries.
+   */
+  size_t
+  size() const { return arrivalOrder_.size(); }
+
+  /**
+   * Get the number of pending Interests which were satisfied by
+   * satisfyInterests.
+   * @return The number of hits.
+   */
+  uint64_t
+  getHitCount() const { return hitCount_; }
+
+  /**
+   * Get the number of entries which were removed because they timed out.
+   * @return The number of expirations.
+   */
+  uint64_t
+  getExpirationCount() const { return expirationCount_; }
+
+  /**
+   * Get the number of entries which were removed because the table was full.
+   * @return The number of evictions.
+   */
+  uint64_t
+  getEvictionCount() const { return evictionCount_; }
+
+  /**
+   * Get the number of Interests which add() aggregated with an existing entry.
+   * @return The number of aggregated Interests.
+   */
+  uint64_t
+  getAggregationCount() const { return aggregationCount_; }
+
+  /**
+   * Get the maximum number of entries.
+   * @return The maximum number of entries, or 0 for no limit.
+   */
+  size_t
+  getMaxEntries() const { return maxEntries_; }
+
+  /**
+   * Set the maximum number of entries. If the table has more entries than
+   * this, evict the oldest entries now.
+   * @param maxEntries The maximum number of entries, or 0 for no limit.
+   */
+  void
+  setMaxEntries(size_t maxEntries);
+
+  static size_t
+  getDEFAULT_MAX_ENTRIES() { return 10000; }
+
 private:
-  std::vector<ndn::ptr_lib::shared_ptr<Entry> > table_;
+  /**
+   * NameTreeNode is a node in the tree of Interest name components. It holds
+   * the entries whose Interest name (without an implicit digest) ends at this
+   * node.
+   */
+  class NameTreeNode {
+  public:
+    NameTreeNode(NameTreeNode* parent, const ndn::Name::Component& component)
+    : parent_(parent), component_(component)
+    {}
+
+    NameTreeNode* parent_;
+    ndn::Name::Component component_;
+    std::map<ndn::Name::Component, ndn::ptr_lib::shared_ptr<NameTreeNode> >
+      children_;
+    std::vector<ndn::ptr_lib::shared_ptr<Entry> > entries_;
+  };
+
+  /**
+   * Remove the entry from its node in the name tree and from arrivalOrder_,
+   * and remove tree nodes which are now empty. Mark the entry as removed so
+   * that the timer wheel will drop it.
+   * @param entry The entry to remove.
+   */
+  void
+  remove(const ndn::ptr_lib::shared_ptr<Entry>& entry);
+
+  /**
+   * Put the entry in the timer wheel slot for its timeout time, and schedule
+   * the timer if it is not already scheduled.
+   * @param entry The entry, which must have a timeout time.
+   */
+  void
+  addToTimerWheel(const ndn::ptr_lib::shared_ptr<Entry>& entry);
+
+  /**
+   * This is called by Face::callLater to advance the timer wheel over the
+   * slots for the elapsed time and remove entries which are timed out.
+   */
+  void
+  onTimerTick();
+
+  static const int TIMER_WHEEL_SIZE = 64;
+  static const ndn::Milliseconds TIMER_WHEEL_TICK_MILLISECONDS;
+
+  ndn::Face& face_;
+  size_t maxEntries_;
+  NameTreeNode nameTreeRoot_;
+  // All entries, oldest first. This is used to evict the oldest entry.
+  std::list<ndn::ptr_lib::shared_ptr<Entry> > arrivalOrder_;
+  // Each slot has the entries which time out when the wheel reaches the slot
+  // (or on a later turn of the wheel, which is checked when it is reached).
+  // Removed entries stay in the wheel until their slot is reached.
+  std::vector<ndn::ptr_lib::shared_ptr<Entry> >
+    timerWheel_[TIMER_WHEEL_SIZE];
+  size_t nTimerWheelEntries_;
+  int timerWheelPosition_;
+  ndn::MillisecondsSince1970 timerWheelTimeMilliseconds_;
+  bool isTimerScheduled_;
+  uint64_t hitCount_;
+  uint64_t expirationCount_;
+  uint64_t evictionCount_;
+  uint64_t aggregationCount_;
 };
 
 }
@@ -0,0 +1,68 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "rtt-estimator.hpp"
+
+using namespace std;
+using namespace ndn;
+
+namespace cnl_cpp {
+
+RttEstimator::RttEstimator()
+: smoothedRttMilliseconds_(-1), rttVariationMilliseconds_(-1),
+  minRttMilliseconds_(-1), retransmissionTimeoutMilliseconds_(getINITIAL_RTO()),
+  sampleCount_(0)
+{
+}
+
+void
+RttEstimator::addMeasurement(Milliseconds rttMilliseconds)
+{
+  if (sampleCount_ == 0) {
+    smoothedRttMilliseconds_ = rttMilliseconds;
+    rttVariationMilliseconds_ = rttMilliseconds / 2;
+    minRttMilliseconds_ = rttMilliseconds;
+  }
+  else {
+    // Use alpha = 1/8 and beta = 1/4 from RFC 6298.
+    rttVariationMilliseconds_ = 0.75 * rttVariationMilliseconds_ +
+      0.25 * fabs(smoothedRttMilliseconds_ - rttMilliseconds);
+    smoothedRttMilliseconds_ =
+      0.875 * smoothedRttMilliseconds_ + 0.125 * rttMilliseconds;
+    minRttMilliseconds_ = min(minRttMilliseconds_, rttMilliseconds);
+  }
+  ++sampleCount_;
+
+  retransmissionTimeoutMilliseconds_ = min
+    (max(smoothedRttMilliseconds_ + 4 * rttVariationMilliseconds_, getMIN_RTO()),
+     getMAX_RTO());
+}
+
+void
+RttEstimator::onTimeout()
+{
+  retransmissionTimeoutMilliseconds_ =
+    min(retransmissionTimeoutMilliseconds_ * 2, getMAX_RTO());
+}
+
+}
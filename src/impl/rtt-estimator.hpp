@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_RTT_ESTIMATOR_HPP
+#define CNL_CPP_RTT_ESTIMATOR_HPP
+
+#include <ndn-cpp/common.hpp>
+
+namespace cnl_cpp {
+
+/**
+ * RttEstimator is an internal class to keep the smoothed round-trip time and
+ * RTT variation of Interests, and to compute the retransmission timeout from
+ * them, as in RFC 6298.
+ */
+class RttEstimator {
+public:
+  RttEstimator();
+
+  /**
+   * Update the estimate with a new RTT sample. Following Karn's algorithm, the
+   * caller should not give a sample for a retransmitted Interest. This also
+   * clears the backoff from onTimeout().
+   * @param rttMilliseconds The RTT sample in milliseconds.
+   */
+  void
+  addMeasurement(ndn::Milliseconds rttMilliseconds);
+
+  /**
+   * Double the retransmission timeout after an Interest times out, up to
+   * getMAX_RTO().
+   */
+  void
+  onTimeout();
+
+  /**
+   * Get the retransmission timeout to use as the Interest lifetime.
+   * @return The RTO in milliseconds.
+   */
+  ndn::Milliseconds
+  getRetransmissionTimeoutMilliseconds() const
+  {
+    return retransmissionTimeoutMilliseconds_;
+  }
+
+  /**
+   * Get the smoothed RTT.
+   * @return The smoothed RTT in milliseconds, or -1 if there are no samples.
+   */
+  ndn::Milliseconds
+  getSmoothedRttMilliseconds() const { return smoothedRttMilliseconds_; }
+
+  /**
+   * Get the RTT variation.
+   * @return The RTT variation in milliseconds, or -1 if there are no samples.
+   */
+  ndn::Milliseconds
+  getRttVariationMilliseconds() const { return rttVariationMilliseconds_; }
+
+  /**
+   * Get the minimum RTT sample.
+   * @return The minimum RTT in milliseconds, or -1 if there are no samples.
+   */
+  ndn::Milliseconds
+  getMinRttMilliseconds() const { return minRttMilliseconds_; }
+
+  uint64_t
+  getSampleCount() const { return sampleCount_; }
+
+  static ndn::Milliseconds
+  getINITIAL_RTO() { return 1000.0; }
+
+  static ndn::Milliseconds
+  getMIN_RTO() { return 200.0; }
+
+  static ndn::Milliseconds
+  getMAX_RTO() { return 60000.0; }
+
+private:
+  ndn::Milliseconds smoothedRttMilliseconds_;
+  ndn::Milliseconds rttVariationMilliseconds_;
+  ndn::Milliseconds minRttMilliseconds_;
+  ndn::Milliseconds retransmissionTimeoutMilliseconds_;
+  uint64_t sampleCount_;
+};
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "segment-window-control.hpp"
+
+using namespace std;
+using namespace ndn;
+
+namespace cnl_cpp {
+
+const double SegmentWindowControl::AIMD_BETA = 0.5;
+const double SegmentWindowControl::CUBIC_BETA = 0.7;
+const double SegmentWindowControl::CUBIC_C = 0.4;
+
+SegmentWindowControl::SegmentWindowControl(SegmentStreamWindowControl type)
+: type_(type), maxWindow_(1), window_(1), slowStartThreshold_(-1),
+  cubicMaxWindow_(0), lastDecreaseTimeMilliseconds_(-1),
+  congestionEventCount_(0)
+{
+}
+
+void
+SegmentWindowControl::reset(int initialWindow, int maxWindow)
+{
+  maxWindow_ = max(maxWindow, 1);
+  if (type_ == SegmentStreamWindowControl_FIXED)
+    window_ = maxWindow_;
+  else
+    window_ = min(max(initialWindow, 1), maxWindow_);
+  // Start in slow start.
+  slowStartThreshold_ = -1;
+  cubicMaxWindow_ = 0;
+  lastDecreaseTimeMilliseconds_ = -1;
+}
+
+void
+SegmentWindowControl::onData
+  (Milliseconds rttMilliseconds, MillisecondsSince1970 nowMilliseconds)
+{
+  if (rttMilliseconds >= 0)
+    rttEstimator_.addMeasurement(rttMilliseconds);
+
+  if (type_ == SegmentStreamWindowControl_FIXED)
+    return;
+
+  if (slowStartThreshold_ < 0 || window_ < slowStartThreshold_)
+    // Slow start.
+    window_ += 1;
+  else if (type_ == SegmentStreamWindowControl_CUBIC)
+    increaseCubic(nowMilliseconds);
+  else
+    increaseAimd();
+
+  window_ = min(window_, (double)maxWindow_);
+}
+
+void
+SegmentWindowControl::onCongestion(MillisecondsSince1970 nowMilliseconds)
+{
+  if (type_ == SegmentStreamWindowControl_FIXED)
+    return;
+
+  Milliseconds smoothedRttMilliseconds =
+    rttEstimator_.getSmoothedRttMilliseconds();
+  if (lastDecreaseTimeMilliseconds_ >= 0 && smoothedRttMilliseconds >= 0 &&
+      nowMilliseconds - lastDecreaseTimeMilliseconds_ < smoothedRttMilliseconds)
+    // Already decreased for Interests in the same window.
+    return;
+
+  ++congestionEventCount_;
+  lastDecreaseTimeMilliseconds_ = nowMilliseconds;
+  if (type_ == SegmentStreamWindowControl_CUBIC) {
+    cubicMaxWindow_ = window_;
+    window_ *= CUBIC_BETA;
+  }
+  else
+    window_ *= AIMD_BETA;
+
+  window_ = max(window_, 1.0);
+  slowStartThreshold_ = max(window_, 2.0);
+}
+
+void
+SegmentWindowControl::increaseAimd()
+{
+  // Congestion avoidance increases the window by about 1 each RTT.
+  window_ += 1.0 / window_;
+}
+
+void
+SegmentWindowControl::increaseCubic(MillisecondsSince1970 nowMilliseconds)
+{
+  Milliseconds smoothedRttMilliseconds =
+    rttEstimator_.getSmoothedRttMilliseconds();
+  if (lastDecreaseTimeMilliseconds_ < 0 || smoothedRttMilliseconds < 0) {
+    // Slow start ended without a congestion event, so there is no CUBIC curve.
+    increaseAimd();
+    return;
+  }
+
+  // The CUBIC window function W(t) = C(t - K)^3 + W_max from RFC 8312, with t
+  // and K in seconds. Aim for the value one RTT ahead.
+  double t = (nowMilliseconds - lastDecreaseTimeMilliseconds_ +
+              smoothedRttMilliseconds) / 1000.0;
+  double k = cbrt(cubicMaxWindow_ * (1 - CUBIC_BETA) / CUBIC_C);
+  double target = CUBIC_C * (t - k) * (t - k) * (t - k) + cubicMaxWindow_;
+
+  // Don't be slower than AIMD (the "TCP-friendly region").
+  double aimdWindow = cubicMaxWindow_ * CUBIC_BETA +
+    3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * (t * 1000.0) /
+    smoothedRttMilliseconds;
+  target = max(target, aimdWindow);
+
+  if (target > window_)
+    // Grow toward the target over one RTT.
+    window_ += (target - window_) / window_;
+  else
+    // Grow very slowly while at the plateau.
+    window_ += 0.01 / window_;
+}
+
+}
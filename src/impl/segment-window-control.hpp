@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_SEGMENT_WINDOW_CONTROL_HPP
+#define CNL_CPP_SEGMENT_WINDOW_CONTROL_HPP
+
+#include <ndn-cpp/common.hpp>
+#include <cnl-cpp/segment-stream-handler.hpp>
+#include "rtt-estimator.hpp"
+
+namespace cnl_cpp {
+
+/**
+ * SegmentWindowControl is an internal class for SegmentStreamHandler to keep
+ * the congestion window, which is the number of segment Interests to keep
+ * outstanding, and statistics of the round-trip time of segment Interests. The
+ * window is adjusted with each segment Data packet and each timeout or network
+ * Nack, based on the SegmentStreamWindowControl type.
+ */
+class SegmentWindowControl {
+public:
+  /**
+   * Create a SegmentWindowControl. You must call reset() before using it.
+   * @param type The type of window control.
+   */
+  SegmentWindowControl(SegmentStreamWindowControl type);
+
+  SegmentStreamWindowControl
+  getType() const { return type_; }
+
+  /**
+   * Set the window to the initial window and clear the slow start threshold,
+   * for example to start fetching a new stream. This does not reset the RTT
+   * statistics.
+   * @param initialWindow The initial window.
+   * @param maxWindow The maximum window. For SegmentStreamWindowControl_FIXED,
+   * the window is always maxWindow.
+   */
+  void
+  reset(int initialWindow, int maxWindow);
+
+  /**
+   * Get the current window, rounded down.
+   * @return The window, which is at least 1.
+   */
+  int
+  getWindow() const { return (int)window_; }
+
+  /**
+   * Get the current window as a real number, which grows by fractions in
+   * congestion avoidance.
+   * @return The window.
+   */
+  double
+  getWindowDouble() const { return window_; }
+
+  /**
+   * Update the RTT statistics and increase the window for a received segment.
+   * @param rttMilliseconds The RTT sample in milliseconds, or -1 if there is
+   * no valid sample (for example, the Interest was retransmitted).
+   * @param nowMilliseconds The current time.
+   */
+  void
+  onData
+    (ndn::Milliseconds rttMilliseconds,
+     ndn::MillisecondsSince1970 nowMilliseconds);
+
+  /**
+   * Decrease the window for a timeout or network Nack. This only decreases
+   * once per RTT, so that losing many Interests from the same window is one
+   * congestion event.
+   * @param nowMilliseconds The current time.
+   */
+  void
+  onCongestion(ndn::MillisecondsSince1970 nowMilliseconds);
+
+  /**
+   * Get the smoothed RTT, as in RFC 6298.
+   * @return The smoothed RTT in milliseconds, or -1 if there are no samples.
+   */
+  ndn::Milliseconds
+  getSmoothedRttMilliseconds() const
+  {
+    return rttEstimator_.getSmoothedRttMilliseconds();
+  }
+
+  /**
+   * Get the RTT variation, as in RFC 6298.
+   * @return The RTT variation in milliseconds, or -1 if there are no samples.
+   */
+  ndn::Milliseconds
+  getRttVariationMilliseconds() const
+  {
+    return rttEstimator_.getRttVariationMilliseconds();
+  }
+
+  /**
+   * Get the minimum RTT sample.
+   * @return The minimum RTT in milliseconds, or -1 if there are no samples.
+   */
+  ndn::Milliseconds
+  getMinRttMilliseconds() const { return rttEstimator_.getMinRttMilliseconds(); }
+
+  uint64_t
+  getRttSampleCount() const { return rttEstimator_.getSampleCount(); }
+
+  uint64_t
+  getCongestionEventCount() const { return congestionEventCount_; }
+
+private:
+  void
+  increaseAimd();
+
+  void
+  increaseCubic(ndn::MillisecondsSince1970 nowMilliseconds);
+
+  // The multiplicative decrease factors.
+  static const double AIMD_BETA;
+  static const double CUBIC_BETA;
+  // The CUBIC scaling constant, for the window in segments and time in seconds.
+  static const double CUBIC_C;
+
+  SegmentStreamWindowControl type_;
+  int maxWindow_;
+  double window_;
+  double slowStartThreshold_;
+  // The window before the last decrease, for CUBIC.
+  double cubicMaxWindow_;
+  ndn::MillisecondsSince1970 lastDecreaseTimeMilliseconds_;
+  RttEstimator rttEstimator_;
+  uint64_t congestionEventCount_;
+};
+
+}
+
+#endif
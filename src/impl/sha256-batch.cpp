@@ -0,0 +1,57 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include <stdexcept>
+#include <ndn-cpp/c/common.h>
+#include "sha256-batch.hpp"
+
+using namespace std;
+using namespace ndn;
+
+namespace cnl_cpp {
+
+Sha256Batch::Sha256Batch()
+: context_(EVP_MD_CTX_create())
+{
+  if (!context_)
+    throw runtime_error("Sha256Batch: Can't create the digest context");
+}
+
+Sha256Batch::~Sha256Batch()
+{
+  EVP_MD_CTX_destroy(context_);
+}
+
+void
+Sha256Batch::digest(const Blob* blobs, size_t nBlobs, uint8_t* digests)
+{
+  const EVP_MD* sha256 = EVP_sha256();
+  for (size_t i = 0; i < nBlobs; ++i) {
+    unsigned int digestLength;
+    if (EVP_DigestInit_ex(context_, sha256, 0) != 1 ||
+        EVP_DigestUpdate(context_, blobs[i].buf(), blobs[i].size()) != 1 ||
+        EVP_DigestFinal_ex
+          (context_, digests + i * ndn_SHA256_DIGEST_SIZE, &digestLength) != 1)
+      throw runtime_error("Sha256Batch: Error computing the digest");
+  }
+}
+
+}
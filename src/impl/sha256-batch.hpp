@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_SHA256_BATCH_HPP
+#define CNL_CPP_SHA256_BATCH_HPP
+
+#include <openssl/evp.h>
+#include <ndn-cpp/util/blob.hpp>
+
+namespace cnl_cpp {
+
+/**
+ * Sha256Batch is an internal class to compute the SHA-256 digests of a list of
+ * buffers, such as the wire encodings of segment packets for their implicit
+ * digests. This is not a multi-buffer engine: it hashes the buffers one after
+ * the other with one OpenSSL digest context (where OpenSSL selects the SHA
+ * extensions for the CPU if available). Compared to calling
+ * Data::getFullName() for each packet, it avoids creating a digest context and
+ * a new Name for each packet, so keep a Sha256Batch to reuse it for later
+ * calls. (See examples/bench-sha256-batch.cpp.) A Sha256Batch is not thread
+ * safe, so to split a list across threads, make one for each thread.
+ */
+class Sha256Batch {
+public:
+  /**
+   * Create a Sha256Batch with a new digest context.
+   * @throws runtime_error if the context can't be created.
+   */
+  Sha256Batch();
+
+  ~Sha256Batch();
+
+  /**
+   * Compute the SHA-256 digest of each Blob in order on this thread.
+   * @param blobs A pointer to the first Blob.
+   * @param nBlobs The number of Blobs.
+   * @param digests The output buffer of nBlobs * ndn_SHA256_DIGEST_SIZE bytes,
+   * where the digest of blobs[i] is at i * ndn_SHA256_DIGEST_SIZE.
+   * @throws runtime_error for an error computing the digest.
+   */
+  void
+  digest(const ndn::Blob* blobs, size_t nBlobs, uint8_t* digests);
+
+private:
+  // Don't allow copying since this frees the context.
+  Sha256Batch(const Sha256Batch& other);
+  Sha256Batch& operator=(const Sha256Batch& other);
+
+  EVP_MD_CTX* context_;
+};
+
+}
+
+#endif
@@ -0,0 +1,316 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include <string.h>
+#include <ndn-cpp/c/common.h>
+#include "sha256-batch.hpp"
+#include "signature-manifest.hpp"
+
+using namespace std;
+using namespace ndn;
+
+namespace cnl_cpp {
+
+uint64_t
+SignatureManifest::getSpan(int level)
+{
+  uint64_t span = 1;
+  for (int i = 0; i < level; ++i)
+    span *= getFANOUT();
+  return span;
+}
+
+uint64_t
+SignatureManifest::getNNodes(uint64_t nSegments, int level)
+{
+  uint64_t span = getSpan(level + 1);
+  return nSegments / span + (nSegments % span == 0 ? 0 : 1);
+}
+
+int
+SignatureManifest::getNLevels(uint64_t nSegments)
+{
+  int nLevels = 0;
+  while (getNNodes(nSegments, nLevels - 1) > getFANOUT())
+    ++nLevels;
+  return nLevels;
+}
+
+Blob
+SignatureManifest::makeNodes
+  (Namespace& nameSpace, const vector<uint8_t>& segmentDigests,
+   const Signature& digestSignature, const MetaInfo* metaInfo)
+{
+  Namespace& treeNamespace =
+    nameSpace[SegmentStreamHandler::getNAME_COMPONENT_MANIFEST_TREE()];
+  ptr_lib::shared_ptr<vector<uint8_t> > digests
+    (new vector<uint8_t>(segmentDigests));
+  Sha256Batch sha256Batch;
+
+  for (int level = 0;
+       digests->size() / ndn_SHA256_DIGEST_SIZE > getFANOUT(); ++level) {
+    size_t nDigests = digests->size() / ndn_SHA256_DIGEST_SIZE;
+    size_t nNodes = (nDigests + getFANOUT() - 1) / getFANOUT();
+    Namespace& levelNamespace =
+      treeNamespace[Name::Component::fromNumber(level)];
+    Name::Component finalBlockId = Name::Component::fromSegment(nNodes - 1);
+
+    vector<ptr_lib::shared_ptr<Data> > nodes(nNodes);
+    vector<Blob> encodings(nNodes);
+    for (size_t i = 0; i < nNodes; ++i) {
+      size_t begin = i * getFANOUT();
+      size_t end = begin + getFANOUT() < nDigests ? begin + getFANOUT() : nDigests;
+
+      ptr_lib::shared_ptr<Data> node = ptr_lib::make_shared<Data>
+        (Name(levelNamespace.getName()).appendSegment(i));
+      if (metaInfo)
+        // Start with a copy of the provided MetaInfo.
+        node->setMetaInfo(*metaInfo);
+      node->getMetaInfo().setFinalBlockId(finalBlockId);
+      node->setContent(Blob
+        (&(*digests)[begin * ndn_SHA256_DIGEST_SIZE],
+         (end - begin) * ndn_SHA256_DIGEST_SIZE));
+      node->setSignature(digestSignature);
+      encodings[i] = node->wireEncode();
+      nodes[i] = node;
+    }
+
+    // The digests of these nodes are the content of the next level up.
+    digests->resize(nNodes * ndn_SHA256_DIGEST_SIZE);
+    sha256Batch.digest(&encodings[0], nNodes, &(*digests)[0]);
+    for (size_t i = 0; i < nNodes; ++i)
+      levelNamespace[Name::Component::fromSegment(i)].setData(nodes[i]);
+  }
+
+  return Blob(digests, false);
+}
+
+bool
+SignatureManifest::verifyAll(Namespace& nameSpace)
+{
+  Name::Component manifestComponent =
+    SegmentStreamHandler::getNAME_COMPONENT_MANIFEST();
+  if (!nameSpace.hasChild(manifestComponent))
+    return false;
+  Namespace& manifestNamespace = nameSpace[manifestComponent];
+  if (!manifestNamespace.getData())
+    return false;
+  const Blob& manifestContent = manifestNamespace.getData()->getContent();
+
+  // Get the number of segments from segment 0.
+  uint64_t nSegments = 0;
+  Name::Component segment0Component = Name::Component::fromSegment(0);
+  if (nameSpace.hasChild(segment0Component) &&
+      nameSpace[segment0Component].getData()) {
+    const Name::Component& finalBlockId =
+      nameSpace[segment0Component].getData()->getMetaInfo().getFinalBlockId();
+    if (!(finalBlockId.getValue().size() > 0 && finalBlockId.isSegment()))
+      return false;
+    nSegments = finalBlockId.toSegment() + 1;
+  }
+
+  int nLevels = getNLevels(nSegments);
+  if (manifestContent.size() == nSegments * ndn_SHA256_DIGEST_SIZE)
+    // A flat manifest, also from a producer which doesn't make a tree.
+    nLevels = 0;
+
+  Name::Component treeComponent =
+    SegmentStreamHandler::getNAME_COMPONENT_MANIFEST_TREE();
+  if (nLevels > 0 && !nameSpace.hasChild(treeComponent))
+    return false;
+
+  // Compute the digests from the bottom up and compare with the content of the
+  // level above.
+  Sha256Batch sha256Batch;
+  vector<uint8_t> digests;
+  for (int level = -1; level < nLevels; ++level) {
+    uint64_t nNodes = getNNodes(nSegments, level);
+    vector<Blob> encodings(nNodes);
+
+    for (uint64_t i = 0; i < nNodes; ++i) {
+      Namespace* node;
+      if (level < 0) {
+        Name::Component segmentComponent = Name::Component::fromSegment(i);
+        if (!nameSpace.hasChild(segmentComponent))
+          return false;
+        node = &nameSpace[segmentComponent];
+      }
+      else {
+        Name::Component levelComponent = Name::Component::fromNumber(level);
+        Name::Component indexComponent = Name::Component::fromSegment(i);
+        Namespace& treeNamespace = nameSpace[treeComponent];
+        if (!treeNamespace.hasChild(levelComponent) ||
+            !treeNamespace[levelComponent].hasChild(indexComponent))
+          return false;
+        node = &treeNamespace[levelComponent][indexComponent];
+      }
+      if (!node->getData())
+        return false;
+
+      encodings[i] = node->getData()->wireEncode();
+      if (level >= 0) {
+        // Check that this node has the digests computed for the level below.
+        const Blob& content = node->getData()->getContent();
+        size_t offset = i * getFANOUT() * ndn_SHA256_DIGEST_SIZE;
+        if (offset + content.size() > digests.size() ||
+            (i + 1 < nNodes &&
+             content.size() != getFANOUT() * ndn_SHA256_DIGEST_SIZE) ||
+            memcmp(content.buf(), &digests[offset], content.size()) != 0)
+          return false;
+      }
+    }
+
+    digests.resize(nNodes * ndn_SHA256_DIGEST_SIZE);
+    if (nNodes > 0)
+      sha256Batch.digest(&encodings[0], nNodes, &digests[0]);
+  }
+
+  return manifestContent.size() == digests.size() &&
+         (digests.size() == 0 ||
+          memcmp(manifestContent.buf(), &digests[0], digests.size()) == 0);
+}
+
+bool
+SignatureManifest::fetchNodes(Namespace& nameSpace, uint64_t nSegments)
+{
+  Name::Component manifestComponent =
+    SegmentStreamHandler::getNAME_COMPONENT_MANIFEST();
+  if (!nameSpace.hasChild(manifestComponent))
+    return false;
+  Namespace& manifestNamespace = nameSpace[manifestComponent];
+  if (!manifestNamespace.getData())
+    return false;
+
+  if (manifestNamespace.getData()->getContent().size() ==
+      nSegments * ndn_SHA256_DIGEST_SIZE)
+    // A flat manifest.
+    return true;
+
+  Namespace& treeNamespace =
+    nameSpace[SegmentStreamHandler::getNAME_COMPONENT_MANIFEST_TREE()];
+  int nLevels = getNLevels(nSegments);
+  for (int level = 0; level < nLevels; ++level) {
+    Namespace& levelNamespace =
+      treeNamespace[Name::Component::fromNumber(level)];
+    uint64_t nNodes = getNNodes(nSegments, level);
+    for (uint64_t i = 0; i < nNodes; ++i) {
+      Namespace& node = levelNamespace[Name::Component::fromSegment(i)];
+      if (!node.getData() &&
+          node.getState() < NamespaceState_INTEREST_EXPRESSED)
+        node.objectNeeded();
+    }
+  }
+
+  return true;
+}
+
+SegmentManifestResult
+SignatureManifest::verifySegment
+  (Namespace& nameSpace, uint64_t segmentNumber, Namespace** neededNode,
+   Namespace** failedNode, Blob* expectedDigest)
+{
+  if (failedNode)
+    *failedNode = 0;
+
+  Namespace& segmentNamespace =
+    nameSpace[Name::Component::fromSegment(segmentNumber)];
+  if (!segmentNamespace.getData())
+    return SegmentManifestResult_FAILED;
+  const Name::Component& finalBlockId =
+    segmentNamespace.getData()->getMetaInfo().getFinalBlockId();
+  if (!(finalBlockId.getValue().size() > 0 && finalBlockId.isSegment()))
+    return SegmentManifestResult_FAILED;
+  uint64_t nSegments = finalBlockId.toSegment() + 1;
+  if (segmentNumber >= nSegments)
+    return SegmentManifestResult_FAILED;
+
+  Namespace& manifestNamespace =
+    nameSpace[SegmentStreamHandler::getNAME_COMPONENT_MANIFEST()];
+  if (!manifestNamespace.getData()) {
+    if (neededNode)
+      *neededNode = &manifestNamespace;
+    return SegmentManifestResult_INCOMPLETE;
+  }
+  const Blob& manifestContent = manifestNamespace.getData()->getContent();
+
+  int nLevels = getNLevels(nSegments);
+  if (manifestContent.size() == nSegments * ndn_SHA256_DIGEST_SIZE)
+    // A flat manifest, also from a producer which doesn't make a tree.
+    nLevels = 0;
+  if (manifestContent.size() !=
+      getNNodes(nSegments, nLevels - 1) * ndn_SHA256_DIGEST_SIZE)
+    return SegmentManifestResult_FAILED;
+
+  // Follow the path from the _manifest down to the segment.
+  uint8_t digest[ndn_SHA256_DIGEST_SIZE];
+  const uint8_t* parentDigest = manifestContent.buf() +
+    (segmentNumber / getSpan(nLevels)) * ndn_SHA256_DIGEST_SIZE;
+  for (int level = nLevels - 1; level >= 0; --level) {
+    uint64_t index = segmentNumber / getSpan(level + 1);
+    Namespace& node = nameSpace
+      [SegmentStreamHandler::getNAME_COMPONENT_MANIFEST_TREE()]
+      [Name::Component::fromNumber(level)][Name::Component::fromSegment(index)];
+    if (!node.getData()) {
+      if (neededNode)
+        *neededNode = &node;
+      return SegmentManifestResult_INCOMPLETE;
+    }
+
+    pair<int, uint64_t> key(level, index);
+    if (verifiedNodes_.find(key) == verifiedNodes_.end()) {
+      Blob encoding = node.getData()->wireEncode();
+      sha256Batch_.digest(&encoding, 1, digest);
+      if (memcmp(digest, parentDigest, ndn_SHA256_DIGEST_SIZE) != 0) {
+        setFailedNode(node, parentDigest, failedNode, expectedDigest);
+        return SegmentManifestResult_FAILED;
+      }
+      verifiedNodes_.insert(key);
+    }
+
+    const Blob& content = node.getData()->getContent();
+    size_t offset =
+      ((segmentNumber / getSpan(level)) % getFANOUT()) * ndn_SHA256_DIGEST_SIZE;
+    if (offset + ndn_SHA256_DIGEST_SIZE > content.size())
+      return SegmentManifestResult_FAILED;
+    parentDigest = content.buf() + offset;
+  }
+
+  Blob encoding = segmentNamespace.getData()->wireEncode();
+  sha256Batch_.digest(&encoding, 1, digest);
+  if (memcmp(digest, parentDigest, ndn_SHA256_DIGEST_SIZE) != 0) {
+    setFailedNode(segmentNamespace, parentDigest, failedNode, expectedDigest);
+    return SegmentManifestResult_FAILED;
+  }
+  return SegmentManifestResult_VERIFIED;
+}
+
+void
+SignatureManifest::setFailedNode
+  (Namespace& node, const uint8_t* parentDigest, Namespace** failedNode,
+   Blob* expectedDigest)
+{
+  if (failedNode)
+    *failedNode = &node;
+  if (expectedDigest)
+    *expectedDigest = Blob(parentDigest, ndn_SHA256_DIGEST_SIZE);
+}
+
+}
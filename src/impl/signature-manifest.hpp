@@ -0,0 +1,156 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef CNL_CPP_SIGNATURE_MANIFEST_HPP
+#define CNL_CPP_SIGNATURE_MANIFEST_HPP
+
+#include <set>
+#include <vector>
+#include <cnl-cpp/segment-stream-handler.hpp>
+#include "sha256-batch.hpp"
+
+namespace cnl_cpp {
+
+/**
+ * SignatureManifest is an internal class for the signature _manifest of a
+ * segmented object, which holds the implicit digests of the segments. If there
+ * are at most getFANOUT() segments, the _manifest packet content is the list of
+ * segment digests. Otherwise the manifest is a tree. The manifest node
+ * <object>/_manifest-tree/<level>/<index> (where level is a number component
+ * and index is a segment component) has a DigestSha256Signature like the
+ * segments. A node at level 0 has the digests of segments index * FANOUT to
+ * (index + 1) * FANOUT - 1. A node at level L > 0 has the implicit digests of
+ * those nodes at level L - 1. The signed _manifest packet has the implicit
+ * digests of the nodes at the top level, of which there are at most FANOUT. (The
+ * nodes are not below _manifest, since an Interest for _manifest may be a prefix
+ * and must not be answered with a manifest node.) A segment can be verified as
+ * soon as the nodes on the path from the _manifest to the segment have arrived.
+ */
+class SignatureManifest {
+public:
+  /**
+   * Get the number of manifest levels below the _manifest packet.
+   * @param nSegments The number of segments.
+   * @return The number of levels, or 0 for a flat manifest.
+   */
+  static int
+  getNLevels(uint64_t nSegments);
+
+  /**
+   * Make the manifest nodes below the _manifest packet and attach them to the
+   * object Namespace. The KeyChain is not used.
+   * @param nameSpace The Namespace of the object.
+   * @param segmentDigests The implicit digests of all segments.
+   * @param digestSignature The DigestSha256Signature for the nodes.
+   * @param metaInfo If not null, the MetaInfo to copy for the nodes.
+   * @return The content for the _manifest packet.
+   */
+  static ndn::Blob
+  makeNodes
+    (Namespace& nameSpace, const std::vector<uint8_t>& segmentDigests,
+     const ndn::Signature& digestSignature, const ndn::MetaInfo* metaInfo);
+
+  /**
+   * Verify all the segments of the object, from the bottom of the manifest up.
+   * @param nameSpace The Namespace of the object with the _manifest, manifest
+   * node and segment children.
+   * @return True if all segments and manifest nodes verify, false if not or if
+   * a packet is missing.
+   */
+  static bool
+  verifyAll(Namespace& nameSpace);
+
+  /**
+   * If the _manifest packet has arrived and its content is not the flat list
+   * of segment digests, call objectNeeded() on each manifest node below it
+   * which is not already requested, so that verifyAll has all the packets.
+   * @param nameSpace The Namespace of the object.
+   * @param nSegments The number of segments.
+   * @return True if the _manifest packet has arrived (whether or not there are
+   * nodes to fetch), false if it is still needed.
+   */
+  static bool
+  fetchNodes(Namespace& nameSpace, uint64_t nSegments);
+
+  /**
+   * Verify one segment using the nodes on the path from the _manifest. This
+   * remembers the verified manifest nodes so that they are not hashed again
+   * for the next segment.
+   * @param nameSpace The Namespace of the object.
+   * @param segmentNumber The number of the segment, which must have its Data
+   * packet.
+   * @param neededNode If the result is INCOMPLETE, set this to the Namespace
+   * node of the manifest packet which is needed next.
+   * @param failedNode (optional) If not null and the result is FAILED because
+   * the segment or a manifest tree packet doesn't match the digest in its
+   * verified parent, set this to the Namespace node of the packet which doesn't
+   * match. Otherwise, if the result is FAILED, set this to null.
+   * @param expectedDigest (optional) If not null and this sets failedNode, set
+   * this to the implicit digest of the packet from its parent.
+   * @return The SegmentManifestResult.
+   */
+  SegmentManifestResult
+  verifySegment
+    (Namespace& nameSpace, uint64_t segmentNumber, Namespace** neededNode,
+     Namespace** failedNode = 0, ndn::Blob* expectedDigest = 0);
+
+  /**
+   * Forget the verified manifest nodes, for example when fetching a new object.
+   */
+  void
+  clear() { verifiedNodes_.clear(); }
+
+  static size_t
+  getFANOUT() { return 256; }
+
+private:
+  /**
+   * Get the number of segments covered by one entry at the given level.
+   * @return getFANOUT() to the power of level.
+   */
+  static uint64_t
+  getSpan(int level);
+
+  /**
+   * Get the number of digests at the given level (where level -1 is the
+   * segments).
+   */
+  static uint64_t
+  getNNodes(uint64_t nSegments, int level);
+
+  /**
+   * Set the failedNode and expectedDigest outputs of verifySegment, if not
+   * null.
+   */
+  static void
+  setFailedNode
+    (Namespace& node, const uint8_t* parentDigest, Namespace** failedNode,
+     ndn::Blob* expectedDigest);
+
+  // The (level, index) of the manifest nodes which are verified.
+  std::set<std::pair<int, uint64_t> > verifiedNodes_;
+  // Reused by verifySegment so that it doesn't make a context for each segment.
+  Sha256Batch sha256Batch_;
+};
+
+}
+
+#endif
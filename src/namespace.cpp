@@ -19,10 +19,14 @@
  * A copy of the GNU Lesser General Public License is in the file COPYING.
  */
 
+#include <algorithm>
+#include <iterator>
 #include <sstream>
 #include <ndn-cpp/util/exponential-re-express.hpp>
 #include <ndn-cpp/util/logging.hpp>
 #include "impl/pending-incoming-interest-table.hpp"
+#include "impl/namespace-node-pool.hpp"
+#include "impl/rtt-estimator.hpp"
 #include <cnl-cpp/namespace.hpp>
 
 using namespace std;
@@ -70,13 +74,86 @@ Namespace::getNextCallbackId()
 Namespace::Impl::Impl
   (Namespace& outerNamespace, const Name& name, KeyChain* keyChain,
    const ndn::ptr_lib::shared_ptr<bool>& isShutDown)
-: outerNamespace_(outerNamespace), name_(name), keyChain_(keyChain), parent_(0),
-  root_(this), state_(NamespaceState_NAME_EXISTS),
-  validateState_(NamespaceValidateState_WAITING_FOR_DATA), 
-  freshnessExpiryTimeMilliseconds_(-1.0), face_(0), decryptor_(0),
-  maxInterestLifetime_(-1), syncDepth_(-1), registeredPrefixId_(0),
+: outerNamespace_(outerNamespace), name_(ptr_lib::make_shared<Name>(name)),
+  nameSize_(name.size()), parent_(0), root_(this),
+  state_(NamespaceState_NAME_EXISTS),
+  validateState_(NamespaceValidateState_WAITING_FOR_DATA),
+  freshnessExpiryTimeMilliseconds_(-1.0), maxDataNameSize_(0), face_(0),
+  registeredPrefixId_(0), keyChain_(keyChain), decryptor_(0),
+  maxPendingIncomingInterests_
+    (PendingIncomingInterestTable::getDEFAULT_MAX_ENTRIES()),
+  maxInterestLifetime_(-1), isInterestRetransmitted_(false), syncDepth_(-1),
   isShutDown_(isShutDown)
 {
+  if (name.size() > 0)
+    component_ = name[-1];
+}
+
+Namespace::Impl::Impl
+  (Namespace& outerNamespace, Namespace::Impl* parent,
+   const Name::Component& component,
+   const ndn::ptr_lib::shared_ptr<bool>& isShutDown)
+: outerNamespace_(outerNamespace), component_(component),
+  nameSize_(parent->nameSize_ + 1), parent_(parent), root_(parent->root_),
+  state_(NamespaceState_NAME_EXISTS),
+  validateState_(NamespaceValidateState_WAITING_FOR_DATA),
+  freshnessExpiryTimeMilliseconds_(-1.0), maxDataNameSize_(0), face_(0),
+  registeredPrefixId_(0), keyChain_(0), decryptor_(0),
+  maxPendingIncomingInterests_
+    (PendingIncomingInterestTable::getDEFAULT_MAX_ENTRIES()),
+  maxInterestLifetime_(-1), isInterestRetransmitted_(false), syncDepth_(-1),
+  isShutDown_(isShutDown)
+{
+}
+
+const Name&
+Namespace::Impl::getName() const
+{
+  const Name* storedName = getStoredName();
+  if (storedName)
+    return *storedName;
+
+  // Keep the name since we return a reference.
+  name_ = ptr_lib::make_shared<Name>(makeName());
+  return *name_;
+}
+
+Name
+Namespace::Impl::makeName() const
+{
+  // Collect the components of this and each parent, until a node which has
+  // its full name (at least the root).
+  vector<const Name::Component*> components;
+  const Namespace::Impl* impl = this;
+  const Name* storedName;
+  while (!(storedName = impl->getStoredName())) {
+    components.push_back(&impl->component_);
+    impl = impl->parent_;
+  }
+
+  Name name(*storedName);
+  for (size_t i = components.size(); i > 0; --i)
+    name.append(*components[i - 1]);
+  return name;
+}
+
+bool
+Namespace::Impl::isPrefixOf(const Name& name) const
+{
+  if (name.size() < nameSize_)
+    return false;
+
+  // Compare the component of this and each parent, until a node which has its
+  // full name (at least the root).
+  const Namespace::Impl* impl = this;
+  const Name* storedName;
+  while (!(storedName = impl->getStoredName())) {
+    if (!impl->component_.equals(name[(int)impl->nameSize_ - 1]))
+      return false;
+    impl = impl->parent_;
+  }
+
+  return storedName->isPrefixOf(name);
 }
 
 Namespace*
@@ -86,6 +163,9 @@ Namespace::Impl::getParent()
     throw runtime_error
       ("Cannot get the parent of this Namespace node because it is shut down");
 
+  if (!parent_)
+    // This is the root.
+    return 0;
   return &parent_->outerNamespace_;
 }
 
@@ -102,35 +182,38 @@ Namespace::Impl::getRoot()
 bool
 Namespace::Impl::hasChild(const Name& descendantName)
 {
-  if (!name_.isPrefixOf(descendantName))
+  if (!isPrefixOf(descendantName))
     throw runtime_error
       ("The name of this node is not a prefix of the descendant name");
 
-  if (descendantName.size() == name_.size())
+  if (descendantName.size() == nameSize_)
     // A trivial case where it is already the name of this node.
     return true;
 
-  // Find the child node whose name equals the descendantName. We know the name
-  // of the descendant Namespace is a prefix, so we can just go by component count
-  // instead of a full compare.
-  Namespace::Impl* descendantImpl = this;
-  while (true) {
-    const Name::Component& nextComponent =
-      descendantName[descendantImpl->name_.size()];
-    if (!descendantImpl->hasChild(nextComponent))
-      return false;
+  return findDeepestImpl(descendantName)->nameSize_ == descendantName.size();
+}
 
-    if (descendantImpl->name_.size() + 1 == descendantName.size())
-      // nextComponent is the final component.
-      return true;
-    descendantImpl = descendantImpl->children_[nextComponent]->impl_.get();
+Namespace::Impl*
+Namespace::Impl::findDeepestImpl(const Name& descendantName)
+{
+  // We know the name of this node is a prefix, so we can just go by component
+  // count instead of a full compare.
+  Namespace::Impl* descendantImpl = this;
+  while (descendantImpl->nameSize_ < descendantName.size()) {
+    Namespace* child = descendantImpl->children_.find
+      (descendantName[descendantImpl->nameSize_]);
+    if (!child)
+      break;
+    descendantImpl = child->impl_.get();
   }
+
+  return descendantImpl;
 }
 
 Namespace::Impl&
 Namespace::Impl::getChildImpl(const Name& descendantName)
 {
-  if (!name_.isPrefixOf(descendantName))
+  if (!isPrefixOf(descendantName))
     throw runtime_error
       ("The name of this node is not a prefix of the descendant name");
 
@@ -138,18 +221,17 @@ Namespace::Impl::getChildImpl(const Name& descendantName)
   // the name of the descendant Namespace is a prefix, so we can just go by
   // component count instead of a full compare.
   Namespace::Impl* descendantImpl = this;
-  while (descendantImpl->name_.size() < descendantName.size()) {
+  while (descendantImpl->nameSize_ < descendantName.size()) {
     const Name::Component& nextComponent =
-      descendantName[descendantImpl->name_.size()];
+      descendantName[descendantImpl->nameSize_];
 
-    map<Name::Component, ptr_lib::shared_ptr<Namespace>>::iterator
-      child = descendantImpl->children_.find(nextComponent);
-    if (child != descendantImpl->children_.end())
-      descendantImpl = child->second->impl_.get();
+    Namespace* child = descendantImpl->children_.find(nextComponent);
+    if (child)
+      descendantImpl = child->impl_.get();
     else {
       // Only fire the callbacks for the leaf node.
       bool isLeaf =
-        (descendantImpl->name_.size() == descendantName.size() - 1);
+        (descendantImpl->nameSize_ == descendantName.size() - 1);
       descendantImpl = descendantImpl->createChild
         (nextComponent, isLeaf).impl_.get();
     }
@@ -163,9 +245,12 @@ Namespace::Impl::getChildComponents()
 {
   ptr_lib::shared_ptr<vector<Name::Component>> result =
     ptr_lib::make_shared<vector<Name::Component>>();
-  for (map<Name::Component, ptr_lib::shared_ptr<Namespace>>::iterator i = children_.begin();
-       i != children_.end(); ++i)
-    result->push_back(i->first);
+  vector<Namespace*> children;
+  children.reserve(children_.size());
+  children_.getChildren(children);
+  result->reserve(children.size());
+  for (size_t i = 0; i < children.size(); ++i)
+    result->push_back(children[i]->impl_->component_);
 
   return result;
 }
@@ -191,12 +276,12 @@ Namespace::Impl::serializeObject(const ptr_lib::shared_ptr<Object>& object)
   if (!keyChain)
     throw runtime_error
       ("serializeObject: There is no KeyChain, so can't serialize " +
-       name_.toUri());
+       makeName().toUri());
 
   // TODO: Encrypt and set state ENCRYPTING.
 
   // Prepare the Data packet.
-  ptr_lib::shared_ptr<Data> data = ptr_lib::make_shared<Data>(name_);
+  ptr_lib::shared_ptr<Data> data = ptr_lib::make_shared<Data>(makeName());
   data->setContent(blobObject->getBlob());
   const MetaInfo* metaInfo = getNewDataMetaInfo_();
   if (metaInfo)
@@ -226,7 +311,7 @@ Namespace::Impl::setData(const ptr_lib::shared_ptr<Data>& data)
   if (data_)
     // We already have an attached object.
     return false;
-  if (!data->getName().equals(name_))
+  if (!(data->getName().size() == nameSize_ && isPrefixOf(data->getName())))
     throw runtime_error
       ("The Data packet name does not equal the name of this Namespace node");
 
@@ -241,6 +326,11 @@ Namespace::Impl::setData(const ptr_lib::shared_ptr<Data>& data)
     // Does not expire.
     freshnessExpiryTimeMilliseconds_ = -1.0;
   data_ = data;
+  // Key by the name in data_ which stays allocated while this node has it.
+  root_->dataIndex_[&data_->getName()] = this;
+  for (Namespace::Impl* impl = this;
+       impl && impl->maxDataNameSize_ < nameSize_; impl = impl->parent_)
+    impl->maxDataNameSize_ = nameSize_;
 
   return true;
 }
@@ -249,21 +339,54 @@ void
 Namespace::Impl::getAllData
   (std::vector<ndn::ptr_lib::shared_ptr<ndn::Data>>& dataList)
 {
-  if (data_)
-    dataList.push_back(data_);
+  // The index is in canonical order, so the names with this prefix are in the
+  // range starting at this name. This is the same order as a depth-first walk
+  // of the sorted children.
+  DataIndex& dataIndex = root_->dataIndex_;
+  Name name(makeName());
+  for (DataIndex::iterator i = dataIndex.lower_bound(&name);
+       i != dataIndex.end() && name.isPrefixOf(*i->first); ++i)
+    dataList.push_back(i->second->data_);
+}
 
-  if (children_.size() > 0) {
-    for (map<Name::Component, ptr_lib::shared_ptr<Namespace>>::iterator i = children_.begin();
-         i != children_.end(); ++i)
-      i->second->impl_->getAllData(dataList);
+uint64_t
+Namespace::Impl::addOnStateChanged
+  (const OnStateChanged& onStateChanged, uint32_t stateMask, int minDepth,
+   int maxDepth, int componentType)
+{
+  uint64_t callbackId = getNextCallbackId();
+  onStateChangedCallbacks_.insert(make_pair(callbackId, StateChangedEntry
+    (onStateChanged, stateMask, minDepth, maxDepth, componentType)));
+
+  // Callback IDs increase, so pushing to the back keeps each list sorted.
+  if ((stateMask & getALL_STATES_MASK()) == getALL_STATES_MASK())
+    // Don't add an unfiltered callback to the list for every state.
+    onStateChangedAllStates_.push_back(callbackId);
+  else {
+    for (int state = 0; state <= NamespaceState_OBJECT_READY_BUT_STALE;
+         ++state) {
+      if (stateMask & getStateMask((NamespaceState)state))
+        onStateChangedIndex_[state].push_back(callbackId);
+    }
   }
+
+  return callbackId;
 }
 
 uint64_t
-Namespace::Impl::addOnStateChanged(const OnStateChanged& onStateChanged)
+Namespace::Impl::addOnStateChangedBatch
+  (const OnStateChangedBatch& onStateChangedBatch, uint32_t stateMask,
+   int minDepth, int maxDepth)
 {
   uint64_t callbackId = getNextCallbackId();
-  onStateChangedCallbacks_[callbackId] = onStateChanged;
+  ptr_lib::shared_ptr<StateChangedBatch> batch =
+    ptr_lib::make_shared<StateChangedBatch>(onStateChangedBatch, callbackId);
+  // This node holds the callback, so the batch doesn't need to hold this.
+  batch->setOnStateChangedId(addOnStateChanged
+    (bind(&StateChangedBatch::onStateChanged, batch.get(), _1, _2, _3),
+     stateMask, minDepth, maxDepth, -1));
+  stateChangedBatches_[callbackId] = batch;
+
   return callbackId;
 }
 
@@ -312,10 +435,11 @@ Namespace::Impl::setFace
       // Data packet to a Namespace node, we will also check if it satisfies a
       // pending Interest.
       root_->pendingIncomingInterestTable_ =
-        ptr_lib::make_shared<PendingIncomingInterestTable>();
+        ptr_lib::make_shared<PendingIncomingInterestTable>
+          (*face, root_->maxPendingIncomingInterests_);
 
     registeredPrefixId_ = face->registerPrefix
-      (name_,
+      (getName(),
        bind(&Namespace::Impl::onInterest, shared_from_this(), _1, _2, _3, _4, _5),
        onRegisterFailed, onRegisterSuccess);
   }
@@ -343,13 +467,16 @@ Namespace::Impl::enableSync(int depth)
 }
 
 void
-Namespace::Impl::objectNeeded(bool mustBeFresh)
+Namespace::Impl::objectNeeded(bool mustBeFresh, const Blob& implicitDigest)
 {
   if (getIsShutDown())
     return;
 
   // Check if we already have the object.
-  Interest interest(name_);
+  Name interestName(makeName());
+  if (implicitDigest.size() > 0)
+    interestName.appendImplicitSha256Digest(implicitDigest);
+  Interest interest(interestName);
   // TODO: Make the lifetime configurable.
   interest.setInterestLifetimeMilliseconds(4000.0);
   interest.setMustBeFresh(mustBeFresh);
@@ -385,6 +512,13 @@ Namespace::Impl::objectNeeded(bool mustBeFresh)
     throw runtime_error("A Face object has not been set for this or a parent");
   // TODO: What if the state is already INTEREST_EXPRESSED?
   setState(NamespaceState_INTEREST_EXPRESSED);
+  isInterestRetransmitted_ = false;
+  if (getRttEstimator()) {
+    expressInterestWithRetransmission
+      (ptr_lib::make_shared<Interest>(interest), face, 0, 0);
+    return;
+  }
+
   face->expressInterest
     (interest,
      bind(&Namespace::Impl::onData, shared_from_this(), _1, _2),
@@ -398,8 +532,41 @@ Namespace::Impl::objectNeeded(bool mustBeFresh)
 void
 Namespace::Impl::removeCallback(uint64_t callbackId)
 {
-  onStateChangedCallbacks_.erase(callbackId);
+  map<uint64_t, StateChangedEntry>::iterator entry =
+    onStateChangedCallbacks_.find(callbackId);
+  if (entry != onStateChangedCallbacks_.end()) {
+    onStateChangedAllStates_.erase(remove
+      (onStateChangedAllStates_.begin(), onStateChangedAllStates_.end(),
+       callbackId),
+      onStateChangedAllStates_.end());
+    for (map<int, vector<uint64_t>>::iterator index =
+           onStateChangedIndex_.begin();
+         index != onStateChangedIndex_.end(); ) {
+      vector<uint64_t>& callbackIds = index->second;
+      if (entry->second.getStateMask() & ((uint32_t)1 << index->first))
+        callbackIds.erase(remove
+          (callbackIds.begin(), callbackIds.end(), callbackId),
+          callbackIds.end());
+
+      if (callbackIds.empty())
+        onStateChangedIndex_.erase(index++);
+      else
+        ++index;
+    }
+
+    onStateChangedCallbacks_.erase(entry);
+  }
   onValidateStateChangedCallbacks_.erase(callbackId);
+
+  map<uint64_t, ptr_lib::shared_ptr<StateChangedBatch>>::iterator batch =
+    stateChangedBatches_.find(callbackId);
+  if (batch != stateChangedBatches_.end()) {
+    // A flush may still be scheduled, so mark the batch as removed.
+    batch->second->remove();
+    uint64_t onStateChangedId = batch->second->getOnStateChangedId();
+    stateChangedBatches_.erase(batch);
+    removeCallback(onStateChangedId);
+  }
 }
 
 void
@@ -482,6 +649,93 @@ Namespace::Impl::getSyncNode()
   return 0;
 }
 
+void
+Namespace::Impl::setRttEstimation(bool enabled)
+{
+  if (enabled) {
+    if (!rttEstimator_)
+      rttEstimator_ = ptr_lib::make_shared<RttEstimator>();
+  }
+  else
+    rttEstimator_.reset();
+}
+
+void
+Namespace::Impl::setMaxPendingIncomingInterests
+  (size_t maxPendingIncomingInterests)
+{
+  root_->maxPendingIncomingInterests_ = maxPendingIncomingInterests;
+  if (root_->pendingIncomingInterestTable_)
+    root_->pendingIncomingInterestTable_->setMaxEntries
+      (maxPendingIncomingInterests);
+}
+
+size_t
+Namespace::Impl::getPendingIncomingInterestCount()
+{
+  if (!root_->pendingIncomingInterestTable_)
+    return 0;
+  return root_->pendingIncomingInterestTable_->size();
+}
+
+uint64_t
+Namespace::Impl::getPendingIncomingInterestHitCount()
+{
+  if (!root_->pendingIncomingInterestTable_)
+    return 0;
+  return root_->pendingIncomingInterestTable_->getHitCount();
+}
+
+uint64_t
+Namespace::Impl::getPendingIncomingInterestExpirationCount()
+{
+  if (!root_->pendingIncomingInterestTable_)
+    return 0;
+  return root_->pendingIncomingInterestTable_->getExpirationCount();
+}
+
+uint64_t
+Namespace::Impl::getPendingIncomingInterestEvictionCount()
+{
+  if (!root_->pendingIncomingInterestTable_)
+    return 0;
+  return root_->pendingIncomingInterestTable_->getEvictionCount();
+}
+
+uint64_t
+Namespace::Impl::getPendingIncomingInterestAggregationCount()
+{
+  if (!root_->pendingIncomingInterestTable_)
+    return 0;
+  return root_->pendingIncomingInterestTable_->getAggregationCount();
+}
+
+Milliseconds
+Namespace::Impl::getRetransmissionTimeout()
+{
+  if (getIsShutDown())
+    throw runtime_error
+      ("Cannot get the RetransmissionTimeout of this Namespace node because it is shut down");
+
+  RttEstimator* rttEstimator = getRttEstimator();
+  if (!rttEstimator)
+    return -1;
+  return rttEstimator->getRetransmissionTimeoutMilliseconds();
+}
+
+RttEstimator*
+Namespace::Impl::getRttEstimator()
+{
+  Namespace::Impl* impl = this;
+  while (impl) {
+    if (impl->rttEstimator_)
+      return impl->rttEstimator_.get();
+    impl = impl->parent_;
+  }
+
+  return 0;
+}
+
 Milliseconds
 Namespace::Impl::getMaxInterestLifetime()
 {
@@ -575,34 +829,116 @@ Namespace::Impl::createChild(const Name::Component& component, bool fireCallback
     throw runtime_error
       ("Cannot create a child of this Namespace node because it is shut down");
 
-  // Every child has a shared_ptr to the same isShutDown_ flag.
-  ptr_lib::shared_ptr<Namespace> child(new Namespace
-    (Name(name_).append(component), (KeyChain *)0, isShutDown_));
-  child->impl_->parent_ = this;
-  child->impl_->root_ = root_;
-  children_[component] = child;
-
-  if (fireCallbacks) {
-    child->impl_->setState(NamespaceState_NAME_EXISTS);
-    
-    // Sync this name under the same conditions that we report a NAME_EXISTS.
-    if (root_->fullPSync_) {
-      Namespace::Impl* syncNode = child->impl_->getSyncNode();
-      if (syncNode) {
-        // Only sync names to the specified depth.
-        int depth = child->impl_->name_.size() - syncNode->name_.size();
-
-        if (depth <= syncNode->syncDepth_)
-          // If createChild is called when onNamesUpdate receives a name from
-          //   fullPSync_, then publishName already has it and will ignore it.
-          root_->fullPSync_->publishName(child->impl_->name_);
-      }
-    }
+  if (!root_->nodePool_)
+    root_->nodePool_ = ptr_lib::make_shared<NamespaceNodePool>();
+  // Allocate the Namespace, its Impl and both shared_ptr control blocks from
+  // the pool.
+  NamespaceNodePoolAllocator<Namespace> allocator(root_->nodePool_);
+  Namespace* childNamespace = allocator.allocate(1);
+  try {
+    // Every child has a shared_ptr to the same isShutDown_ flag.
+    new (childNamespace) Namespace(this, component, isShutDown_, allocator);
+  } catch (...) {
+    allocator.deallocate(childNamespace, 1);
+    throw;
   }
+  ptr_lib::shared_ptr<Namespace> child
+    (childNamespace, NamespaceNodePoolDeleter<Namespace>(allocator), allocator);
+  children_.insert(child);
+
+  if (fireCallbacks)
+    child->impl_->announceNameExists();
 
   return *child;
 }
 
+void
+Namespace::Impl::announceNameExists()
+{
+  setState(NamespaceState_NAME_EXISTS);
+
+  // Sync this name under the same conditions that we report a NAME_EXISTS.
+  if (root_->fullPSync_) {
+    Namespace::Impl* syncNode = getSyncNode();
+    if (syncNode) {
+      // Only sync names to the specified depth.
+      int depth = nameSize_ - syncNode->nameSize_;
+
+      if (depth <= syncNode->syncDepth_)
+        // If createChild is called when onNamesUpdate receives a name from
+        //   fullPSync_, then publishName already has it and will ignore it.
+        root_->fullPSync_->publishName(makeName());
+    }
+  }
+}
+
+void
+Namespace::Impl::removeChild
+  (const Name::Component& component, bool removePendingInterests)
+{
+  if (!children_.find(component))
+    return;
+  // Supply collected state changes before the nodes can be deleted. This runs
+  // application callbacks, so look up the child afterwards.
+  if (!flushStateChangedBatchesToRoot())
+    return;
+  Namespace* childNamespace = children_.find(component);
+  if (!childNamespace)
+    return;
+
+  Namespace::Impl* child = childNamespace->impl_.get();
+  size_t childMaxDataNameSize = child->maxDataNameSize_;
+  child->removeFromDataIndex(true);
+  if (removePendingInterests && root_->pendingIncomingInterestTable_)
+    root_->pendingIncomingInterestTable_->removeUnderPrefix(child->makeName());
+  // Shut down the removed nodes with their own flag so that the rest of the
+  // tree is not affected.
+  child->setIsShutDownFlag(ptr_lib::make_shared<bool>(true));
+  // This may delete the child if there are no other references.
+  children_.remove(component);
+
+  if (childMaxDataNameSize > 0 && childMaxDataNameSize == maxDataNameSize_)
+    // The removed child may have had the longest Data name.
+    updateMaxDataNameSize();
+}
+
+void
+Namespace::Impl::experimentalClear()
+{
+  // Supply collected state changes before the children are deleted.
+  if (!flushStateChangedBatchesToRoot())
+    return;
+
+  object_.reset();
+  // Don't leave index entries which point into the removed children.
+  removeFromDataIndex(false);
+  // Shut down the removed nodes so that their batches don't supply changes.
+  vector<Namespace*> children;
+  children_.getChildren(children);
+  for (size_t i = 0; i < children.size(); ++i)
+    children[i]->impl_->setIsShutDownFlag(ptr_lib::make_shared<bool>(true));
+  children_.clear();
+  updateMaxDataNameSize();
+}
+
+void
+Namespace::Impl::setIsShutDownFlag(const ptr_lib::shared_ptr<bool>& isShutDown)
+{
+  isShutDown_ = isShutDown;
+  if (*isShutDown) {
+    // The node is removed, so don't supply any more state changes.
+    for (map<uint64_t, ptr_lib::shared_ptr<StateChangedBatch>>::iterator i =
+           stateChangedBatches_.begin();
+         i != stateChangedBatches_.end(); ++i)
+      i->second->remove();
+  }
+
+  vector<Namespace*> children;
+  children_.getChildren(children);
+  for (size_t i = 0; i < children.size(); ++i)
+    children[i]->impl_->setIsShutDownFlag(isShutDown);
+}
+
 void
 Namespace::Impl::setState(NamespaceState state)
 {
@@ -613,33 +949,56 @@ Namespace::Impl::setState(NamespaceState state)
 
   // Fire callbacks.
   Namespace::Impl* impl = this;
+  int depth = 0;
   while (impl) {
-    impl->fireOnStateChanged(outerNamespace_, state);
+    impl->fireOnStateChanged(outerNamespace_, state, depth);
     impl = impl->parent_;
+    ++depth;
   }
 }
 
 void
 Namespace::Impl::fireOnStateChanged
-  (Namespace& changedNamespace, NamespaceState state)
+  (Namespace& changedNamespace, NamespaceState state, int depth)
 {
+  if (onStateChangedIndex_.empty() && onStateChangedAllStates_.empty())
+    // Most nodes have no callbacks.
+    return;
   if (getIsShutDown())
     return;
 
-  // Copy the keys before iterating since callbacks can change the list.
+  // Merge the callbacks for all states with the callbacks for this state so
+  // that they are called in the order they were added.
+  vector<uint64_t> callbackIds;
+  map<int, vector<uint64_t>>::iterator index = onStateChangedIndex_.find(state);
+  if (index == onStateChangedIndex_.end())
+    callbackIds = onStateChangedAllStates_;
+  else {
+    callbackIds.reserve
+      (onStateChangedAllStates_.size() + index->second.size());
+    merge(onStateChangedAllStates_.begin(), onStateChangedAllStates_.end(),
+          index->second.begin(), index->second.end(),
+          back_inserter(callbackIds));
+  }
+
+  // Copy the matching keys before iterating since callbacks can change the list.
   vector<uint64_t> keys;
-  keys.reserve(onStateChangedCallbacks_.size());
-  for (map<uint64_t, OnStateChanged>::iterator i = onStateChangedCallbacks_.begin();
-       i != onStateChangedCallbacks_.end(); ++i)
-    keys.push_back(i->first);
+  for (size_t i = 0; i < callbackIds.size(); ++i) {
+    map<uint64_t, StateChangedEntry>::iterator entry =
+      onStateChangedCallbacks_.find(callbackIds[i]);
+    if (entry != onStateChangedCallbacks_.end() &&
+        entry->second.matches(changedNamespace, depth))
+      keys.push_back(entry->first);
+  }
 
   for (size_t i = 0; i < keys.size(); ++i) {
     // A callback on a previous pass may have removed this callback, so check.
-    map<uint64_t, OnStateChanged>::iterator entry =
+    map<uint64_t, StateChangedEntry>::iterator entry =
       onStateChangedCallbacks_.find(keys[i]);
     if (entry != onStateChangedCallbacks_.end()) {
       try {
-        entry->second(outerNamespace_, changedNamespace, state, entry->first);
+        entry->second.getOnStateChanged()
+          (outerNamespace_, changedNamespace, state, entry->first);
       } catch (const std::exception& ex) {
         _LOG_ERROR("Namespace::fireOnStateChanged: Error in onStateChanged: " <<
                    ex.what());
@@ -650,6 +1009,88 @@ Namespace::Impl::fireOnStateChanged
   }
 }
 
+void
+Namespace::Impl::StateChangedBatch::onStateChanged
+  (Namespace& nameSpace, Namespace& changedNamespace, NamespaceState state)
+{
+  if (isRemoved_)
+    return;
+
+  changes_.push_back(StateChange(&changedNamespace, state));
+  if (isFlushScheduled_)
+    return;
+
+  namespaceImpl_ = nameSpace.impl_;
+  Face* face = nameSpace.getFace_();
+  if (!face) {
+    // There is no event loop, so supply the change now.
+    flush();
+    return;
+  }
+
+  isFlushScheduled_ = true;
+  face->callLater
+    (0, bind(&Namespace::Impl::StateChangedBatch::flush, shared_from_this()));
+}
+
+void
+Namespace::Impl::StateChangedBatch::flush()
+{
+  isFlushScheduled_ = false;
+  if (isRemoved_ || changes_.size() == 0)
+    return;
+  // The node may have been deleted while the flush was scheduled.
+  ptr_lib::shared_ptr<Namespace::Impl> namespaceImpl = namespaceImpl_.lock();
+  if (!namespaceImpl || namespaceImpl->getIsShutDown())
+    return;
+
+  // The callback may cause more state changes, so collect them in changes_.
+  vector<StateChange> changes;
+  changes.swap(changes_);
+  try {
+    onStateChangedBatch_
+      (namespaceImpl->outerNamespace_, changes, callbackId_);
+  } catch (const std::exception& ex) {
+    _LOG_ERROR("Namespace::StateChangedBatch::flush: Error in onStateChangedBatch: " <<
+               ex.what());
+  } catch (...) {
+    _LOG_ERROR("Namespace::StateChangedBatch::flush: Error in onStateChangedBatch.");
+  }
+}
+
+void
+Namespace::Impl::flushStateChangedBatches()
+{
+  if (stateChangedBatches_.empty())
+    return;
+
+  // Copy the batches since a callback can change the list.
+  vector<ptr_lib::shared_ptr<StateChangedBatch>> batches;
+  for (map<uint64_t, ptr_lib::shared_ptr<StateChangedBatch>>::iterator i =
+         stateChangedBatches_.begin();
+       i != stateChangedBatches_.end(); ++i)
+    batches.push_back(i->second);
+
+  for (size_t i = 0; i < batches.size(); ++i)
+    batches[i]->flush();
+}
+
+bool
+Namespace::Impl::flushStateChangedBatchesToRoot()
+{
+  bool wasShutDown = getIsShutDown();
+  // Keep references since a callback can remove nodes.
+  vector<ptr_lib::shared_ptr<Namespace::Impl>> impls;
+  for (Namespace::Impl* impl = this; impl; impl = impl->parent_)
+    impls.push_back(impl->shared_from_this());
+
+  for (size_t i = 0; i < impls.size(); ++i)
+    impls[i]->flushStateChangedBatches();
+
+  // A tree which was already shut down doesn't supply changes.
+  return wasShutDown || !getIsShutDown();
+}
+
 void
 Namespace::Impl::setValidateState(NamespaceValidateState validateState)
 {
@@ -805,15 +1246,17 @@ Namespace::Impl::onInterest
     // Strip the implicit digest.
     interestName = interestName.getPrefix(-1);
 
-  if (!name_.isPrefixOf(interestName))
+  if (!isPrefixOf(interestName))
     // No match.
     return;
 
-  // Check if the Namespace node exists and has a matching Data packet.
-  Namespace::Impl& interestNamespaceImpl = getChildImpl(interestName);
-  if (hasChild(interestName)) {
+  // Check if the Namespace node exists and has a matching Data packet. Don't
+  // create nodes for the lookup, so that Interests for names we don't have
+  // don't grow the tree.
+  Namespace::Impl* deepestImpl = findDeepestImpl(interestName);
+  if (deepestImpl->nameSize_ == interestName.size()) {
     Namespace::Impl* bestMatch = findBestMatchName
-      (interestNamespaceImpl, *interest, ndn_getNowMilliseconds());
+      (*deepestImpl, *interest, ndn_getNowMilliseconds());
     if (bestMatch) {
       // findBestMatchName makes sure there is a data_ packet.
       face.putData(*bestMatch->data_);
@@ -821,19 +1264,39 @@ Namespace::Impl::onInterest
     }
   }
 
-  // No Data packet found, so save the pending Interest.
-  root_->pendingIncomingInterestTable_->add(interest, face);
+  // No Data packet found, so save the pending Interest. If it is aggregated
+  // with a pending Interest for the same name, then we already asked to
+  // produce the object.
+  if (!root_->pendingIncomingInterestTable_->add(interest, face))
+    return;
+
+  // The OnObjectNeeded callbacks need the node for the Interest name, so make
+  // any missing nodes without firing callbacks. Only keep them if a callback
+  // can produce.
+  Namespace::Impl* interestImpl = deepestImpl;
+  while (interestImpl->nameSize_ < interestName.size())
+    interestImpl = interestImpl->createChild
+      (interestName[interestImpl->nameSize_], false).impl_.get();
 
   // Ask all OnObjectNeeded callbacks if they can produce.
   bool canProduce = false;
-  Namespace::Impl* impl = &interestNamespaceImpl;
+  Namespace::Impl* impl = interestImpl;
   while (impl) {
-    if (impl->fireOnObjectNeeded(interestNamespaceImpl.outerNamespace_))
+    if (impl->fireOnObjectNeeded(interestImpl->outerNamespace_))
       canProduce = true;
     impl = impl->parent_;
   }
-  if (canProduce)
-    interestNamespaceImpl.setState(NamespaceState_PRODUCING_OBJECT);
+
+  if (canProduce) {
+    if (interestImpl != deepestImpl)
+      // As with getChildImpl, only fire the callbacks for the leaf node.
+      interestImpl->announceNameExists();
+    interestImpl->setState(NamespaceState_PRODUCING_OBJECT);
+  }
+  else if (interestImpl != deepestImpl)
+    // Remove the nodes that we made for the lookup.
+    // Keep the pending Interest in case the Data is set later.
+    deepestImpl->removeChild(interestName[deepestImpl->nameSize_], false);
 }
 
 Namespace::Impl*
@@ -841,26 +1304,38 @@ Namespace::Impl::findBestMatchName
   (Namespace::Impl& nameSpace, const Interest& interest,
    MillisecondsSince1970 nowMilliseconds)
 {
-  Namespace::Impl *bestMatch = 0;
+  if (nameSpace.maxDataNameSize_ == 0)
+    // There is no Data packet in the subtree.
+    return 0;
+
+  if (interest.getCanBePrefix() &&
+      nameSpace.maxDataNameSize_ > nameSpace.nameSize_) {
+    Namespace::Impl *bestMatch = 0;
+    // Search the children from left to right so that the leftmost match is
+    // kept among names of the same length. Skip a child whose subtree can't
+    // have a longer match, and stop when the match has the longest Data name
+    // in the subtree since the other children can only tie it.
+    nameSpace.children_.forEach([&](Namespace& childNamespace) {
+      Namespace::Impl& child = *childNamespace.impl_;
+      if (child.maxDataNameSize_ > (bestMatch ? bestMatch->nameSize_ : 0)) {
+        Namespace::Impl* childBestMatch = findBestMatchName
+          (child, interest, nowMilliseconds);
+        if (childBestMatch &&
+            (!bestMatch || childBestMatch->nameSize_ > bestMatch->nameSize_))
+          bestMatch = childBestMatch;
+      }
 
-  // Search the children backwards which will result in a "less than" name
-  // among names of the same length.
-  for (map<Name::Component, ptr_lib::shared_ptr<Namespace>>::reverse_iterator
-        i = nameSpace.children_.rbegin();
-       i != nameSpace.children_.rend(); ++i) {
-    Namespace::Impl& child = *i->second->impl_;
-    Namespace::Impl* childBestMatch = findBestMatchName
-      (child, interest, nowMilliseconds);
+      return !(bestMatch &&
+               bestMatch->nameSize_ == nameSpace.maxDataNameSize_);
+    });
 
-    if (childBestMatch &&
-        (!bestMatch ||
-         childBestMatch->name_.size() >= bestMatch->name_.size()))
-      bestMatch = childBestMatch;
+    if (bestMatch)
+      // We have a child match, and it is longer than this name, so return it.
+      return bestMatch;
   }
 
-  if (bestMatch)
-    // We have a child match, and it is longer than this name, so return it.
-    return bestMatch;
+  if (!nameSpace.data_)
+    return 0;
 
   if (interest.getMustBeFresh() &&
       nameSpace.freshnessExpiryTimeMilliseconds_ >= 0 &&
@@ -869,12 +1344,55 @@ Namespace::Impl::findBestMatchName
     // Debug: When to set the state to OBJECT_READY_BUT_STALE?
     return 0;
 
-  if (nameSpace.data_ && interest.matchesData(*nameSpace.data_))
+  if (interest.matchesData(*nameSpace.data_))
     return &nameSpace;
 
   return 0;
 }
 
+void
+Namespace::Impl::updateMaxDataNameSize()
+{
+  Namespace::Impl* impl = this;
+  while (impl) {
+    size_t oldMaxDataNameSize = impl->maxDataNameSize_;
+    size_t maxDataNameSize = impl->data_ ? impl->nameSize_ : 0;
+    if (maxDataNameSize < oldMaxDataNameSize)
+      // Stop at a child with the old maximum, since it can't be larger.
+      impl->children_.forEach([&](Namespace& child) {
+        if (child.impl_->maxDataNameSize_ > maxDataNameSize)
+          maxDataNameSize = child.impl_->maxDataNameSize_;
+        return maxDataNameSize < oldMaxDataNameSize;
+      });
+
+    if (maxDataNameSize == oldMaxDataNameSize)
+      return;
+    impl->maxDataNameSize_ = maxDataNameSize;
+
+    if (!(impl->parent_ &&
+          impl->parent_->maxDataNameSize_ == oldMaxDataNameSize))
+      // The parent's maximum is from another node.
+      return;
+    impl = impl->parent_;
+  }
+}
+
+void
+Namespace::Impl::removeFromDataIndex(bool includeThisNode)
+{
+  DataIndex& dataIndex = root_->dataIndex_;
+  Name name(makeName());
+  DataIndex::iterator i = dataIndex.lower_bound(&name);
+  if (!includeThisNode && i != dataIndex.end() && i->second == this)
+    // Skip the entry for this node.
+    ++i;
+
+  DataIndex::iterator end = i;
+  while (end != dataIndex.end() && name.isPrefixOf(*end->first))
+    ++end;
+  dataIndex.erase(i, end);
+}
+
 void
 Namespace::Impl::onData
   (const ptr_lib::shared_ptr<const Interest>& interest,
@@ -928,6 +1446,70 @@ Namespace::Impl::onTimeout(const ptr_lib::shared_ptr<const Interest>& interest)
   setState(NamespaceState_INTEREST_TIMEOUT);
 }
 
+void
+Namespace::Impl::expressInterestWithRetransmission
+  (const ptr_lib::shared_ptr<Interest>& interest, Face* face,
+   int nRetransmissions, Milliseconds elapsedMilliseconds)
+{
+  // Don't let the total time exceed the maximum lifetime.
+  Milliseconds lifetime = min
+    (getRttEstimator()->getRetransmissionTimeoutMilliseconds(),
+     getMaxInterestLifetime() - elapsedMilliseconds);
+  interest->setInterestLifetimeMilliseconds(lifetime);
+
+  face->expressInterest
+    (*interest,
+     bind(&Namespace::Impl::onRetransmissionData, shared_from_this(), _1, _2,
+          ndn_getNowMilliseconds(), nRetransmissions),
+     bind(&Namespace::Impl::onRetransmissionTimeout, shared_from_this(), _1,
+          face, nRetransmissions, elapsedMilliseconds),
+     bind(&Namespace::Impl::onNetworkNack, shared_from_this(), _1, _2));
+}
+
+void
+Namespace::Impl::onRetransmissionData
+  (const ptr_lib::shared_ptr<const Interest>& interest,
+   const ptr_lib::shared_ptr<Data>& data,
+   MillisecondsSince1970 sendTimeMilliseconds, int nRetransmissions)
+{
+  if (getIsShutDown())
+    return;
+
+  RttEstimator* rttEstimator = getRttEstimator();
+  // We can't tell which transmission a retransmitted Interest's Data answers,
+  // so only sample the first.
+  if (rttEstimator && nRetransmissions == 0)
+    rttEstimator->addMeasurement(ndn_getNowMilliseconds() - sendTimeMilliseconds);
+
+  onData(interest, data);
+}
+
+void
+Namespace::Impl::onRetransmissionTimeout
+  (const ptr_lib::shared_ptr<const Interest>& interest, Face* face,
+   int nRetransmissions, Milliseconds elapsedMilliseconds)
+{
+  if (getIsShutDown())
+    return;
+
+  RttEstimator* rttEstimator = getRttEstimator();
+  elapsedMilliseconds += interest->getInterestLifetimeMilliseconds();
+  if (!rttEstimator || elapsedMilliseconds >= getMaxInterestLifetime()) {
+    onTimeout(interest);
+    return;
+  }
+
+  rttEstimator->onTimeout();
+  isInterestRetransmitted_ = true;
+  _LOG_DEBUG("Namespace: Retransmitting " << interest->getName().toUri() <<
+             " after " << elapsedMilliseconds << " ms");
+  ptr_lib::shared_ptr<Interest> newInterest =
+    ptr_lib::make_shared<Interest>(*interest);
+  newInterest->refreshNonce();
+  expressInterestWithRetransmission
+    (newInterest, face, nRetransmissions + 1, elapsedMilliseconds);
+}
+
 void
 Namespace::Impl::onNetworkNack
   (const ptr_lib::shared_ptr<const Interest>& interest,
@@ -963,7 +1545,7 @@ Namespace::Impl::onNamesUpdate
 
   for (vector<Name>::const_iterator name = names->begin(); name != names->end();
        ++name) {
-    if (!name_.isPrefixOf(*name)) {
+    if (!isPrefixOf(*name)) {
       _LOG_DEBUG("The Namespace root name is not a prefix of the sync update name " <<
                  *name);
       continue;
@@ -974,6 +1556,195 @@ Namespace::Impl::onNamesUpdate
   }
 }
 
+Namespace*
+Namespace::Impl::ChildList::find(const Name::Component& component) const
+{
+  if (nDenseChildren_ > 0 && isDenseType(component)) {
+    uint64_t number = getDenseNumber(component);
+    if (number >= denseOffset_ && number - denseOffset_ < denseChildren_.size()) {
+      const ptr_lib::shared_ptr<Namespace>& child =
+        denseChildren_[number - denseOffset_];
+      // A component with a non-standard encoding of the same number is held
+      // in sortedChildren_, so check.
+      if (child && getComponent(child).equals(component))
+        return child.get();
+    }
+  }
+
+  if (sortedChildren_.size() <= maxLinearSearchSize_) {
+    for (size_t i = 0; i < sortedChildren_.size(); ++i) {
+      if (getComponent(sortedChildren_[i]).equals(component))
+        return sortedChildren_[i].get();
+    }
+
+    return 0;
+  }
+
+  vector<ptr_lib::shared_ptr<Namespace>>::const_iterator child = lower_bound
+    (sortedChildren_.begin(), sortedChildren_.end(), component, &isLessThan);
+  if (child != sortedChildren_.end() && getComponent(*child).equals(component))
+    return child->get();
+  else
+    return 0;
+}
+
+void
+Namespace::Impl::ChildList::insert(const ptr_lib::shared_ptr<Namespace>& child)
+{
+  const Name::Component& component = getComponent(child);
+
+  if (nDenseChildren_ == 0) {
+    // The first segment or sequence number child chooses the dense type.
+    if (component.isSegment())
+      denseType_ = DENSE_SEGMENT;
+    else if (component.isSequenceNumber())
+      denseType_ = DENSE_SEQUENCE_NUMBER;
+  }
+  if (isDenseType(component)) {
+    uint64_t number = getDenseNumber(component);
+    // Only use the dense array for the standard encoding of the number.
+    Name::Component standardComponent = (denseType_ == DENSE_SEGMENT ?
+      Name::Component::fromSegment(number) :
+      Name::Component::fromSequenceNumber(number));
+    if (standardComponent.equals(component) && insertDense(number, child))
+      return;
+  }
+
+  if (sortedChildren_.size() == 0 ||
+      getComponent(sortedChildren_.back()).compare(component) < 0)
+    // The new child sorts after the others, so just append.
+    sortedChildren_.push_back(child);
+  else
+    sortedChildren_.insert
+      (lower_bound(sortedChildren_.begin(), sortedChildren_.end(), component,
+                   &isLessThan),
+       child);
+}
+
+bool
+Namespace::Impl::ChildList::insertDense
+  (uint64_t number, const ptr_lib::shared_ptr<Namespace>& child)
+{
+  if (denseChildren_.size() == 0)
+    denseOffset_ = number;
+  else if (number < denseOffset_) {
+    if (denseOffset_ - number > maxDenseGap_)
+      return false;
+    denseChildren_.insert
+      (denseChildren_.begin(), denseOffset_ - number,
+       ptr_lib::shared_ptr<Namespace>());
+    denseOffset_ = number;
+  }
+  else if (number - denseOffset_ >= denseChildren_.size()) {
+    if (number - denseOffset_ - denseChildren_.size() > maxDenseGap_)
+      return false;
+  }
+
+  if (number - denseOffset_ >= denseChildren_.size())
+    denseChildren_.resize(number - denseOffset_ + 1);
+  denseChildren_[number - denseOffset_] = child;
+  ++nDenseChildren_;
+  return true;
+}
+
+ptr_lib::shared_ptr<Namespace>
+Namespace::Impl::ChildList::remove(const Name::Component& component)
+{
+  ptr_lib::shared_ptr<Namespace> result;
+
+  if (nDenseChildren_ > 0 && isDenseType(component)) {
+    uint64_t number = getDenseNumber(component);
+    if (number >= denseOffset_ && number - denseOffset_ < denseChildren_.size()) {
+      ptr_lib::shared_ptr<Namespace>& child = denseChildren_[number - denseOffset_];
+      if (child && getComponent(child).equals(component)) {
+        result = child;
+        child.reset();
+        --nDenseChildren_;
+
+        if (nDenseChildren_ == 0) {
+          denseChildren_.clear();
+          denseType_ = DENSE_NONE;
+          denseOffset_ = 0;
+        }
+        else {
+          // Trim empty entries at the ends.
+          while (!denseChildren_.front()) {
+            denseChildren_.pop_front();
+            ++denseOffset_;
+          }
+          while (!denseChildren_.back())
+            denseChildren_.pop_back();
+        }
+
+        return result;
+      }
+    }
+  }
+
+  vector<ptr_lib::shared_ptr<Namespace>>::iterator child = lower_bound
+    (sortedChildren_.begin(), sortedChildren_.end(), component, &isLessThan);
+  if (child != sortedChildren_.end() && getComponent(*child).equals(component)) {
+    result = *child;
+    sortedChildren_.erase(child);
+  }
+
+  return result;
+}
+
+void
+Namespace::Impl::ChildList::getChildren(vector<Namespace*>& children) const
+{
+  // Merge the dense children, which are in order of their number (which is
+  // also the canonical order), with the sorted children.
+  vector<ptr_lib::shared_ptr<Namespace>>::const_iterator sortedChild =
+    sortedChildren_.begin();
+  for (size_t i = 0; i < denseChildren_.size(); ++i) {
+    const ptr_lib::shared_ptr<Namespace>& denseChild = denseChildren_[i];
+    if (!denseChild)
+      continue;
+
+    while (sortedChild != sortedChildren_.end() &&
+           getComponent(*sortedChild).compare(getComponent(denseChild)) < 0) {
+      children.push_back(sortedChild->get());
+      ++sortedChild;
+    }
+    children.push_back(denseChild.get());
+  }
+
+  for (; sortedChild != sortedChildren_.end(); ++sortedChild)
+    children.push_back(sortedChild->get());
+}
+
+bool
+Namespace::Impl::ChildList::forEach
+  (const func_lib::function<bool(Namespace& child)>& visit) const
+{
+  // Merge the dense children with the sorted children, as in getChildren.
+  vector<ptr_lib::shared_ptr<Namespace>>::const_iterator sortedChild =
+    sortedChildren_.begin();
+  for (size_t i = 0; i < denseChildren_.size(); ++i) {
+    const ptr_lib::shared_ptr<Namespace>& denseChild = denseChildren_[i];
+    if (!denseChild)
+      continue;
+
+    while (sortedChild != sortedChildren_.end() &&
+           getComponent(*sortedChild).compare(getComponent(denseChild)) < 0) {
+      if (!visit(**sortedChild))
+        return false;
+      ++sortedChild;
+    }
+    if (!visit(*denseChild))
+      return false;
+  }
+
+  for (; sortedChild != sortedChildren_.end(); ++sortedChild) {
+    if (!visit(**sortedChild))
+      return false;
+  }
+
+  return true;
+}
+
 #ifdef NDN_CPP_HAVE_BOOST_ASIO
 boost::atomic_uint64_t Namespace::lastCallbackId_;
 #else
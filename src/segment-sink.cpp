@@ -0,0 +1,181 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/**
+ * Copyright (C) 2020 Regents of the University of California.
+ * @author: Jeff Thompson <jefft0@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include <stdexcept>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if NDN_CPP_HAVE_MEMORY_H
+#include <memory.h>
+#else
+#include <string.h>
+#endif
+#include <cnl-cpp/segment-sink.hpp>
+
+using namespace std;
+using namespace ndn;
+
+namespace cnl_cpp {
+
+SegmentSink::~SegmentSink()
+{
+}
+
+bool
+FileDescriptorSegmentSink::write
+  (uint64_t offset, const uint8_t* buf, size_t size)
+{
+  while (size > 0) {
+    ssize_t nBytes = ::pwrite(fileDescriptor_, buf, size, offset);
+    if (nBytes < 0) {
+      if (errno == EINTR)
+        continue;
+      throw runtime_error
+        (string("FileDescriptorSegmentSink: Error in pwrite: ") +
+         strerror(errno));
+    }
+
+    // Continue after a partial write.
+    buf += nBytes;
+    size -= nBytes;
+    offset += nBytes;
+  }
+
+  return true;
+}
+
+void
+FileDescriptorSegmentSink::finish(uint64_t totalSize)
+{
+  if (::ftruncate(fileDescriptor_, totalSize) != 0)
+    throw runtime_error
+      (string("FileDescriptorSegmentSink: Error in ftruncate: ") +
+       strerror(errno));
+}
+
+MmapSegmentSink::MmapSegmentSink(const string& filePath)
+: map_(0), mapSize_(0)
+{
+  fileDescriptor_ = ::open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fileDescriptor_ < 0)
+    throw runtime_error
+      ("MmapSegmentSink: Can't open " + filePath + ": " + strerror(errno));
+}
+
+MmapSegmentSink::~MmapSegmentSink()
+{
+  close();
+}
+
+bool
+MmapSegmentSink::write(uint64_t offset, const uint8_t* buf, size_t size)
+{
+  if (size == 0)
+    return true;
+
+  ensureSize(offset + size);
+  memcpy(map_ + offset, buf, size);
+  return true;
+}
+
+void
+MmapSegmentSink::finish(uint64_t totalSize)
+{
+  if (fileDescriptor_ < 0)
+    throw runtime_error("MmapSegmentSink: finish was already called");
+
+  if (map_) {
+    ::munmap(map_, mapSize_);
+    map_ = 0;
+    mapSize_ = 0;
+  }
+  int result = ::ftruncate(fileDescriptor_, totalSize);
+  int error = errno;
+  close();
+  if (result != 0)
+    throw runtime_error
+      (string("MmapSegmentSink: Error in ftruncate: ") + strerror(error));
+}
+
+void
+MmapSegmentSink::ensureSize(uint64_t minimumSize)
+{
+  if (minimumSize <= mapSize_)
+    return;
+  if (fileDescriptor_ < 0)
+    throw runtime_error("MmapSegmentSink: write called after finish");
+
+  // Double the size to amortize remapping, rounded up to the page size.
+  uint64_t newSize = mapSize_ * 2;
+  if (newSize < 1024 * 1024)
+    newSize = 1024 * 1024;
+  if (newSize < minimumSize)
+    newSize = minimumSize;
+  uint64_t pageSize = ::sysconf(_SC_PAGESIZE);
+  newSize = (newSize + pageSize - 1) / pageSize * pageSize;
+
+  if (map_) {
+    ::munmap(map_, mapSize_);
+    map_ = 0;
+    mapSize_ = 0;
+  }
+  if (::ftruncate(fileDescriptor_, newSize) != 0)
+    throw runtime_error
+      (string("MmapSegmentSink: Error in ftruncate: ") + strerror(errno));
+
+  void* map = ::mmap
+    (0, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor_, 0);
+  if (map == MAP_FAILED)
+    throw runtime_error
+      (string("MmapSegmentSink: Error in mmap: ") + strerror(errno));
+  map_ = (uint8_t*)map;
+  mapSize_ = newSize;
+}
+
+void
+MmapSegmentSink::close()
+{
+  if (map_) {
+    ::munmap(map_, mapSize_);
+    map_ = 0;
+    mapSize_ = 0;
+  }
+  if (fileDescriptor_ >= 0) {
+    ::close(fileDescriptor_);
+    fileDescriptor_ = -1;
+  }
+}
+
+bool
+CallbackSegmentSink::write(uint64_t offset, const uint8_t* buf, size_t size)
+{
+  return onWrite_(offset, Blob(buf, size));
+}
+
+void
+CallbackSegmentSink::finish(uint64_t totalSize)
+{
+  if (onFinish_)
+    onFinish_(totalSize);
+}
+
+}
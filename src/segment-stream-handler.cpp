@@ -19,14 +19,21 @@
  * A copy of the GNU Lesser General Public License is in the file COPYING.
  */
 
+#include <algorithm>
 #if NDN_CPP_HAVE_MEMORY_H
 #include <memory.h>
 #else
 #include <string.h>
 #endif
+#include <sstream>
 #include <ndn-cpp/util/logging.hpp>
 #include <ndn-cpp/digest-sha256-signature.hpp>
 #include <cnl-cpp/segment-stream-handler.hpp>
+#include "impl/segment-window-control.hpp"
+#include "impl/lazy-segment-producer.hpp"
+#include "impl/parallel-for.hpp"
+#include "impl/sha256-batch.hpp"
+#include "impl/signature-manifest.hpp"
 
 using namespace std;
 using namespace ndn;
@@ -51,12 +58,46 @@ SegmentStreamHandler::onNamespaceSet()
   impl_->onNamespaceSet(&getNamespace());
 }
 
+function<void(bool isFetchingPaused)>
+SegmentStreamHandler::getSetIsFetchingPaused()
+{
+  return bind(&SegmentStreamHandler::Impl::setIsFetchingPaused, impl_, _1);
+}
+
+ndn::func_lib::function<void(const string& message)>
+SegmentStreamHandler::getReportError()
+{
+  return bind(&SegmentStreamHandler::Impl::reportError, impl_, _1);
+}
+
+function<bool()>
+SegmentStreamHandler::getGetVerifySegments()
+{
+  return bind(&SegmentStreamHandler::Impl::getVerifySegments, impl_);
+}
+
+function<bool()>
+SegmentStreamHandler::getGetHasOnSegmentCallbacks()
+{
+  return bind(&SegmentStreamHandler::Impl::getHasOnSegmentCallbacks, impl_);
+}
+
 SegmentStreamHandler::Impl::Impl(const OnSegment& onSegment)
-: maxReportedSegmentNumber_(-1), didRequestFinalSegment_(false),
-  finalSegmentNumber_(-1), interestPipelineSize_(8), initialInterestCount_(1),
-  onObjectNeededId_(0), onStateChangedId_(0), namespace_(0),
-  maxSegmentPayloadLength_(8192)
+: nextSegmentToReport_(0), finalSegmentNumber_(0),
+  hasFinalSegmentNumber_(false), nextSegmentToRequest_(0),
+  nOutstandingSegments_(0), interestPipelineSize_(8), initialInterestCount_(1),
+  isFetchingPaused_(false), isStopped_(false), onObjectNeededId_(0),
+  onStateChangedId_(0), namespace_(0), maxSegmentPayloadLength_(8192),
+  nWorkerThreads_(1), verifySegments_(false),
+  signatureManifest_(ptr_lib::make_shared<SignatureManifest>()),
+  isManifestFetched_(false), maxCongestionWindow_(1000),
+  windowControl_(ptr_lib::make_shared<SegmentWindowControl>
+                 (SegmentStreamWindowControl_FIXED)),
+  requestTimesOffset_(0)
 {
+  // Set the initial window in case segments are fetched without onObjectNeeded.
+  windowControl_->reset(initialInterestCount_, maxCongestionWindow_);
+
   if (onSegment)
     addOnSegment(onSegment);
 }
@@ -69,10 +110,74 @@ SegmentStreamHandler::Impl::addOnSegment(const OnSegment& onSegment)
   return callbackId;
 }
 
+void
+SegmentStreamHandler::Impl::setIsFetchingPaused(bool isFetchingPaused)
+{
+  bool wasPaused = isFetchingPaused_;
+  isFetchingPaused_ = isFetchingPaused;
+  if (wasPaused && !isFetchingPaused_ && nextSegmentToRequest_ > 0)
+    // Fetching was started, so continue.
+    requestNewSegments(getWindow());
+}
+
+uint64_t
+SegmentStreamHandler::Impl::addOnSegmentUnordered(const OnSegment& onSegment)
+{
+  uint64_t callbackId = Namespace::getNextCallbackId();
+  onSegmentUnorderedCallbacks_[callbackId] = onSegment;
+  return callbackId;
+}
+
+uint64_t
+SegmentStreamHandler::Impl::addOnSegmentsComplete
+  (const OnSegmentsComplete& onSegmentsComplete)
+{
+  uint64_t callbackId = Namespace::getNextCallbackId();
+  onSegmentsCompleteCallbacks_[callbackId] = onSegmentsComplete;
+  return callbackId;
+}
+
+uint64_t
+SegmentStreamHandler::Impl::addOnSegmentsError
+  (const OnSegmentsError& onSegmentsError)
+{
+  uint64_t callbackId = Namespace::getNextCallbackId();
+  onSegmentsErrorCallbacks_[callbackId] = onSegmentsError;
+  return callbackId;
+}
+
 void
 SegmentStreamHandler::Impl::removeCallback(uint64_t callbackId)
 {
   onSegmentCallbacks_.erase(callbackId);
+  onSegmentUnorderedCallbacks_.erase(callbackId);
+  onSegmentsCompleteCallbacks_.erase(callbackId);
+  onSegmentsErrorCallbacks_.erase(callbackId);
+}
+
+void
+SegmentStreamHandler::Impl::reportError(const string& message)
+{
+  if (isStopped_)
+    // Already finished or reported.
+    return;
+
+  _LOG_ERROR("SegmentStreamHandler: " << message);
+  // stopFetching clears the callbacks, so copy them first.
+  map<uint64_t, OnSegmentsError> callbacks(onSegmentsErrorCallbacks_);
+  stopFetching();
+
+  for (map<uint64_t, OnSegmentsError>::iterator i = callbacks.begin();
+       i != callbacks.end(); ++i) {
+    try {
+      i->second(*namespace_, message);
+    } catch (const std::exception& ex) {
+      _LOG_ERROR("SegmentStreamHandler::reportError: Error in onSegmentsError: " <<
+                 ex.what());
+    } catch (...) {
+      _LOG_ERROR("SegmentStreamHandler::reportError: Error in onSegmentsError.");
+    }
+  }
 }
 
 void
@@ -91,6 +196,66 @@ SegmentStreamHandler::Impl::setInitialInterestCount(int initialInterestCount)
   initialInterestCount_ = initialInterestCount;
 }
 
+SegmentStreamWindowControl
+SegmentStreamHandler::Impl::getWindowControl()
+{
+  return windowControl_->getType();
+}
+
+void
+SegmentStreamHandler::Impl::setWindowControl
+  (SegmentStreamWindowControl windowControl)
+{
+  windowControl_ = ptr_lib::make_shared<SegmentWindowControl>(windowControl);
+  windowControl_->reset(initialInterestCount_, maxCongestionWindow_);
+}
+
+void
+SegmentStreamHandler::Impl::setMaxCongestionWindow(int maxCongestionWindow)
+{
+  if (maxCongestionWindow < 1)
+    throw runtime_error("The maximum congestion window must be at least 1");
+  maxCongestionWindow_ = maxCongestionWindow;
+}
+
+double
+SegmentStreamHandler::Impl::getCongestionWindow()
+{
+  if (windowControl_->getType() == SegmentStreamWindowControl_FIXED)
+    return interestPipelineSize_;
+  return windowControl_->getWindowDouble();
+}
+
+Milliseconds
+SegmentStreamHandler::Impl::getSmoothedRttMilliseconds()
+{
+  return windowControl_->getSmoothedRttMilliseconds();
+}
+
+Milliseconds
+SegmentStreamHandler::Impl::getRttVariationMilliseconds()
+{
+  return windowControl_->getRttVariationMilliseconds();
+}
+
+Milliseconds
+SegmentStreamHandler::Impl::getMinRttMilliseconds()
+{
+  return windowControl_->getMinRttMilliseconds();
+}
+
+uint64_t
+SegmentStreamHandler::Impl::getRttSampleCount()
+{
+  return windowControl_->getRttSampleCount();
+}
+
+uint64_t
+SegmentStreamHandler::Impl::getCongestionEventCount()
+{
+  return windowControl_->getCongestionEventCount();
+}
+
 void
 SegmentStreamHandler::Impl::setMaxSegmentPayloadLength
   (size_t maxSegmentPayloadLength)
@@ -100,31 +265,54 @@ SegmentStreamHandler::Impl::setMaxSegmentPayloadLength
   maxSegmentPayloadLength_ = maxSegmentPayloadLength;
 }
 
+void
+SegmentStreamHandler::Impl::setNWorkerThreads(int nWorkerThreads)
+{
+  if (nWorkerThreads < 1)
+    throw runtime_error("The number of worker threads must be at least 1");
+  nWorkerThreads_ = nWorkerThreads;
+}
+
 void
 SegmentStreamHandler::Impl::setObject
   (Namespace& nameSpace, const ndn::Blob& object, bool useSignatureManifest)
+{
+  makeSegments(nameSpace, object.buf(), object.size(), useSignatureManifest);
+
+  // TODO: Do this in a canSerialize callback from Namespace.serializeObject?
+  nameSpace.setObject_(ptr_lib::make_shared<BlobObject>(object));
+}
+
+void
+SegmentStreamHandler::Impl::setObjectFromFile
+  (Namespace& nameSpace, const string& filePath, bool useSignatureManifest)
+{
+  // Each segment copies from the mapping, so the file is not read into memory
+  // first. The mapping is released when we return.
+  MmapContentSource source(filePath);
+  makeSegments(nameSpace, source.buf(), source.size(), useSignatureManifest);
+}
+
+void
+SegmentStreamHandler::Impl::makeSegments
+  (Namespace& nameSpace, const uint8_t* object, size_t objectSize,
+   bool useSignatureManifest)
 {
   KeyChain* keyChain = nameSpace.getKeyChain_();
   if (!keyChain)
     throw runtime_error("SegmentStreamHandler.setObject: There is no KeyChain");
 
-  // Get the final block ID.
-  uint64_t finalSegment = 0;
-  // Instead of a brute calculation, imitate the loop we will use below.
-  uint64_t segment = 0;
-  for (size_t offset = 0; offset < object.size();
-       offset += maxSegmentPayloadLength_) {
-    finalSegment = segment;
-    ++segment;
-  }
+  // Get the final block ID. (An empty object has no segments.)
+  size_t nSegments = objectSize == 0 ?
+    0 : (objectSize - 1) / maxSegmentPayloadLength_ + 1;
+  uint64_t finalSegment = nSegments == 0 ? 0 : nSegments - 1;
   Name::Component finalBlockId = Name().appendSegment(finalSegment)[0];
 
-  ptr_lib::shared_ptr<vector<uint8_t> > manifestContent;
+  vector<uint8_t> segmentDigests;
   DigestSha256Signature digestSignature;
   if (useSignatureManifest) {
     // Get ready to save the segment implicit digests.
-    manifestContent.reset
-      (new vector<uint8_t>((finalSegment + 1) * ndn_SHA256_DIGEST_SIZE));
+    segmentDigests.resize(nSegments * ndn_SHA256_DIGEST_SIZE);
 
     // Use a DigestSha256Signature with all zeros.
     ptr_lib::shared_ptr<vector<uint8_t> > zeros
@@ -133,86 +321,121 @@ SegmentStreamHandler::Impl::setObject
     digestSignature.setSignature(Blob(zeros, false));
   }
 
-  segment = 0;
-  for (size_t offset = 0; offset < object.size();
-       offset += maxSegmentPayloadLength_) {
-    size_t payloadLength = maxSegmentPayloadLength_;
-    if (offset + payloadLength > object.size())
-      payloadLength = object.size() - offset;
-
-    // Make the Data packet.
-    Namespace& segmentNamespace = nameSpace[Name::Component::fromSegment(segment)];
-    ptr_lib::shared_ptr<Data> data =
-      ptr_lib::make_shared<Data>(segmentNamespace.getName());
-
-    const MetaInfo* metaInfo = nameSpace.getNewDataMetaInfo_();
-    if (metaInfo)
-      // Start with a copy of the provided MetaInfo.
-      data->setMetaInfo(*metaInfo);
-    data->getMetaInfo().setFinalBlockId(finalBlockId);
-    data->setContent(Blob(object.buf() + offset, payloadLength));
-
-    if (useSignatureManifest) {
-      data->setSignature(digestSignature);
-
-      // Append the implicit digest to the manifestContent.
-      const Blob& implicitDigest = (*data->getFullName())[-1].getValue();
-      size_t digestOffset = segment * ndn_SHA256_DIGEST_SIZE;
-      memcpy
-        (&manifestContent->front() + digestOffset, implicitDigest.buf(),
-         ndn_SHA256_DIGEST_SIZE);
+  // Make the Data packets and compute the implicit digests for the manifest.
+  // This doesn't use the Namespace or KeyChain, so it can run on worker
+  // threads. Each thread writes to its own range of segments and
+  // segmentDigests.
+  vector<ptr_lib::shared_ptr<Data> > segments(nSegments);
+  vector<Blob> encodings(useSignatureManifest ? nSegments : 0);
+  const Name& prefix = nameSpace.getName();
+  const MetaInfo* metaInfo = nameSpace.getNewDataMetaInfo_();
+  size_t maxSegmentPayloadLength = maxSegmentPayloadLength_;
+  auto makeSegmentRange = [&] (size_t begin, size_t end) {
+    for (size_t segment = begin; segment < end; ++segment) {
+      size_t offset = segment * maxSegmentPayloadLength;
+      size_t payloadLength = maxSegmentPayloadLength;
+      if (offset + payloadLength > objectSize)
+        payloadLength = objectSize - offset;
+
+      // Make the Data packet.
+      ptr_lib::shared_ptr<Data> data =
+        ptr_lib::make_shared<Data>(Name(prefix).appendSegment(segment));
+      if (metaInfo)
+        // Start with a copy of the provided MetaInfo.
+        data->setMetaInfo(*metaInfo);
+      data->getMetaInfo().setFinalBlockId(finalBlockId);
+      data->setContent(Blob(object + offset, payloadLength));
+
+      if (useSignatureManifest) {
+        data->setSignature(digestSignature);
+        // This also saves the encoding in the Data packet for sending.
+        encodings[segment] = data->wireEncode();
+      }
+
+      segments[segment] = data;
     }
-    else
-      keyChain->sign(*data);
 
-    segmentNamespace.setData(data);
+    if (useSignatureManifest)
+      // Put the implicit digests for this range in segmentDigests.
+      Sha256Batch().digest
+        (&encodings[begin], end - begin,
+         &segmentDigests[begin * ndn_SHA256_DIGEST_SIZE]);
+  };
+  if (nWorkerThreads_ > 1 && !parallelFor_)
+    parallelFor_ = ptr_lib::make_shared<ParallelFor>();
+  if (parallelFor_)
+    parallelFor_->run(nWorkerThreads_, nSegments, makeSegmentRange);
+  else
+    makeSegmentRange(0, nSegments);
+  encodings.clear();
+
+  // The KeyChain and Namespace are not thread safe, so sign and attach the
+  // Data packets on this thread.
+  for (size_t segment = 0; segment < nSegments; ++segment) {
+    if (!useSignatureManifest)
+      keyChain->sign(*segments[segment]);
 
-    ++segment;
+    nameSpace[Name::Component::fromSegment(segment)].setData(segments[segment]);
+    // Free the Data packet reference as we go.
+    segments[segment].reset();
   }
 
   if (useSignatureManifest)
-    // Create the _manifest data packet.
+    // Create the manifest nodes for a large object, then the signed _manifest
+    // packet.
     nameSpace[getNAME_COMPONENT_MANIFEST()].serializeObject
-      (ptr_lib::make_shared<BlobObject>(Blob(manifestContent, false)));
+      (ptr_lib::make_shared<BlobObject>(SignatureManifest::makeNodes
+        (nameSpace, segmentDigests, digestSignature, metaInfo)));
+}
 
-  // TODO: Do this in a canSerialize callback from Namespace.serializeObject?
-  nameSpace.setObject_(ptr_lib::make_shared<BlobObject>(object));
+void
+SegmentStreamHandler::Impl::setObjectFromSource
+  (Namespace& nameSpace, const ptr_lib::shared_ptr<ContentSource>& source,
+   size_t maxCachedSegments)
+{
+  if (!nameSpace.getKeyChain_())
+    throw runtime_error
+      ("SegmentStreamHandler.setObjectFromSource: There is no KeyChain");
+
+  // The Namespace callback keeps a shared_ptr to the producer.
+  ptr_lib::make_shared<LazySegmentProducer>
+    (nameSpace, source, maxSegmentPayloadLength_, maxCachedSegments)
+    ->initialize();
 }
 
 bool
 SegmentStreamHandler::Impl::verifyWithManifest(Namespace& nameSpace)
 {
-  Blob manifestContent = nameSpace[getNAME_COMPONENT_MANIFEST()].getBlobObject();
-  size_t nSegments = manifestContent.size() / ndn_SHA256_DIGEST_SIZE;
-  if (manifestContent.size() != nSegments * ndn_SHA256_DIGEST_SIZE)
-    // The manifest size is not a multiple of the digest size as expected.
-    return false;
-
-  for (size_t segment = 0; segment < nSegments; ++segment) {
-    Namespace& segmentNamespace = nameSpace[Name::Component::fromSegment(segment)];
-    const Blob& segmentDigest = (*segmentNamespace.getData()->getFullName())[-1].getValue();
-    if (segmentDigest.size() != ndn_SHA256_DIGEST_SIZE)
-      // We don't expect this.
-      return false;
-    // To avoid copying, use memcmp directly instead of making a Blob.
-    if (memcmp(segmentDigest.buf(),
-               manifestContent.buf() + segment * ndn_SHA256_DIGEST_SIZE,
-               ndn_SHA256_DIGEST_SIZE) != 0)
-      return false;
-  }
+  return SignatureManifest::verifyAll(nameSpace);
+}
 
-  return true;
+SegmentManifestResult
+SegmentStreamHandler::Impl::verifySegmentWithManifest
+  (Namespace& nameSpace, uint64_t segmentNumber, Namespace** neededNode)
+{
+  return SignatureManifest().verifySegment
+    (nameSpace, segmentNumber, neededNode);
 }
 
 void
 SegmentStreamHandler::Impl::onNamespaceSet(Namespace* nameSpace)
 {
   namespace_ = nameSpace;
+  if (namespace_->getRetransmissionTimeout() < 0)
+    // Retransmit a lost segment after the RTO so that it doesn't stall the
+    // stream for the whole Interest lifetime.
+    namespace_->setRttEstimation(true);
 
   onObjectNeededId_ = namespace_->addOnObjectNeeded
     (bind(&SegmentStreamHandler::Impl::onObjectNeeded, shared_from_this(), _1, _2, _3));
+  // Only get the states handled by onStateChanged for the segments and
+  // _manifest (depth 1) and the manifest packets (depth 3).
   onStateChangedId_ = namespace_->addOnStateChanged
-    (bind(&SegmentStreamHandler::Impl::onStateChanged, shared_from_this(), _1, _2, _3, _4));
+    (bind(&SegmentStreamHandler::Impl::onStateChanged, shared_from_this(), _1, _2, _3, _4),
+     Namespace::getStateMask(NamespaceState_DATA_RECEIVED) |
+     Namespace::getStateMask(NamespaceState_INTEREST_TIMEOUT) |
+     Namespace::getStateMask(NamespaceState_INTEREST_NETWORK_NACK) |
+     Namespace::getStateMask(NamespaceState_OBJECT_READY), 1, 3);
 }
 
 bool
@@ -222,6 +445,22 @@ SegmentStreamHandler::Impl::onObjectNeeded
   if (&nameSpace != &neededNamespace)
     return false;
 
+  windowControl_->reset(initialInterestCount_, maxCongestionWindow_);
+  nextSegmentToRequest_ = nextSegmentToReport_;
+  nOutstandingSegments_ = 0;
+  requestTimes_.clear();
+  requestTimesOffset_ = nextSegmentToRequest_;
+  isManifestFetched_ = false;
+  if (verifySegments_) {
+    signatureManifest_->clear();
+    unverifiedSegments_.clear();
+    nSegmentRefetches_.clear();
+
+    // Fetch the signature _manifest along with the first segments.
+    Namespace& manifestNamespace = (*namespace_)[getNAME_COMPONENT_MANIFEST()];
+    if (manifestNamespace.getState() < NamespaceState_INTEREST_EXPRESSED)
+      manifestNamespace.objectNeeded();
+  }
   requestNewSegments(initialInterestCount_);
   return true;
 }
@@ -231,85 +470,320 @@ SegmentStreamHandler::Impl::onStateChanged
   (Namespace& nameSpace, Namespace& changedNamespace, NamespaceState state,
    uint64_t callbackId)
 {
-  if (!(state == NamespaceState_OBJECT_READY &&
-        changedNamespace.getName().size() == namespace_->getName().size() + 1 &&
-        changedNamespace.getName()[-1].isSegment()))
+  if (state == NamespaceState_OBJECT_READY &&
+      isManifestNode(changedNamespace)) {
+    if (verifySegments_)
+      onManifestNodeReady();
+    else
+      fetchManifestNodes();
+    return;
+  }
+
+  if (!(changedNamespace.getParent() == namespace_ &&
+        changedNamespace.getNameComponent().isSegment()))
     // Not a segment, ignore.
     return;
 
-  MetaInfo& metaInfo = changedNamespace.getData()->getMetaInfo();
+  if (state == NamespaceState_DATA_RECEIVED) {
+    // Use the time from sending the Interest for an RTT sample.
+    MillisecondsSince1970 nowMilliseconds = ndn_getNowMilliseconds();
+    MillisecondsSince1970 requestTime = onSegmentNotOutstanding
+      (changedNamespace.getNameComponent().toSegment());
+    if (changedNamespace.getIsInterestRetransmitted_())
+      // Karn's algorithm: Don't take a sample for a retransmitted Interest.
+      requestTime = -1;
+
+    windowControl_->onData
+      (requestTime >= 0 ? nowMilliseconds - requestTime : -1, nowMilliseconds);
+    return;
+  }
+
+  if (state == NamespaceState_INTEREST_TIMEOUT ||
+      state == NamespaceState_INTEREST_NETWORK_NACK) {
+    _LOG_DEBUG("SegmentStreamHandler: Got timeout or nack for " <<
+               changedNamespace.getName());
+    onSegmentNotOutstanding(changedNamespace.getNameComponent().toSegment());
+    windowControl_->onCongestion(ndn_getNowMilliseconds());
+    return;
+  }
+
+  if (state != NamespaceState_OBJECT_READY)
+    return;
+
+  uint64_t segmentNumber = changedNamespace.getNameComponent().toSegment();
+  // objectNeeded may have found the object without receiving a Data packet.
+  onSegmentNotOutstanding(segmentNumber);
+
+  if (segmentNumber < readySegments_.size() && readySegments_[segmentNumber])
+    // Only handle each segment once, even if its state is set again.
+    return;
+
+  bool isDigestSignature = (dynamic_cast<const DigestSha256Signature *>
+    (changedNamespace.getData()->getSignature()) != 0);
+  if (verifySegments_ && isDigestSignature) {
+    if (!verifySegment(segmentNumber)) {
+      // Wait for the manifest or the re-fetched segment.
+      requestNewSegments(getWindow());
+      return;
+    }
+  }
+  else if (isDigestSignature) {
+    // Assume we are using a signature _manifest.
+    Namespace& manifestNamespace = (*namespace_)[getNAME_COMPONENT_MANIFEST()];
+    if (manifestNamespace.getState() < NamespaceState_INTEREST_EXPRESSED)
+      // We haven't requested the signature _manifest yet.
+      manifestNamespace.objectNeeded();
+  }
+
+  if (!verifySegments_ && isDigestSignature)
+    fetchManifestNodes();
+
+  if (onSegmentReady(changedNamespace))
+    requestNewSegments(getWindow());
+}
+
+bool
+SegmentStreamHandler::Impl::onSegmentReady(Namespace& segmentNamespace)
+{
+  uint64_t segmentNumber = segmentNamespace.getNameComponent().toSegment();
+  // Only handle each segment once.
+  if (segmentNumber >= readySegments_.size())
+    readySegments_.resize(segmentNumber + 1, false);
+  if (readySegments_[segmentNumber])
+    return true;
+  readySegments_[segmentNumber] = true;
+
+  MetaInfo& metaInfo = segmentNamespace.getData()->getMetaInfo();
   if (metaInfo.getFinalBlockId().getValue().size() > 0 &&
-      metaInfo.getFinalBlockId().isSegment())
+      metaInfo.getFinalBlockId().isSegment()) {
     finalSegmentNumber_ = metaInfo.getFinalBlockId().toSegment();
+    hasFinalSegmentNumber_ = true;
+  }
+
+  fireOnSegment(onSegmentUnorderedCallbacks_, &segmentNamespace);
 
-  // Report as many segments as possible where the node already has content.
+  // Report as many segments as possible which are ready.
   while (true) {
-    int nextSegmentNumber = maxReportedSegmentNumber_ + 1;
-    Namespace& nextSegment =
-      (*namespace_)[Name::Component::fromSegment(nextSegmentNumber)];
-    if (!nextSegment.getObject())
+    uint64_t nextSegmentNumber = nextSegmentToReport_;
+    if (nextSegmentNumber >= readySegments_.size() ||
+        !readySegments_[nextSegmentNumber])
       break;
 
-    maxReportedSegmentNumber_ = nextSegmentNumber;
-    fireOnSegment(&nextSegment);
+    ++nextSegmentToReport_;
+    // Remove the entries for segments which are now reported.
+    while (requestTimes_.size() > 0 &&
+           requestTimesOffset_ < nextSegmentToReport_) {
+      if (requestTimes_.front() >= 0)
+        --nOutstandingSegments_;
+      requestTimes_.pop_front();
+      ++requestTimesOffset_;
+    }
+    if (onSegmentCallbacks_.size() > 0) {
+      Name::Component nextSegmentComponent =
+        Name::Component::fromSegment(nextSegmentNumber);
+      // The application may have removed the segment node. (A
+      // SegmentedObjectHandler doesn't remove segments while there are
+      // OnSegment callbacks.)
+      if (namespace_->hasChild(nextSegmentComponent))
+        fireOnSegment(onSegmentCallbacks_, &(*namespace_)[nextSegmentComponent]);
+    }
 
-    if (dynamic_cast<const DigestSha256Signature *>
-        (nextSegment.getData()->getSignature())) {
-      // Assume we are using a signature _manifest.
-      Namespace& manifestNamespace = (*namespace_)[getNAME_COMPONENT_MANIFEST()];
-      if (manifestNamespace.getState() < NamespaceState_INTEREST_EXPRESSED)
-        // We haven't requested the signature _manifest yet.
-        manifestNamespace.objectNeeded();
+    if (hasFinalSegmentNumber_ && nextSegmentNumber == finalSegmentNumber_) {
+      // Finished. Since the segments are reported in order, all segments are
+      // ready.
+      fireOnSegment(onSegmentCallbacks_, 0);
+      fireOnSegmentsComplete();
+      stopFetching();
+
+      return false;
     }
+  }
 
-    if (finalSegmentNumber_ >= 0 && nextSegmentNumber == finalSegmentNumber_) {
-      // Finished.
-      fireOnSegment(0);
+  return true;
+}
+
+bool
+SegmentStreamHandler::Impl::verifySegment(uint64_t segmentNumber)
+{
+  Namespace* neededNode = 0;
+  Namespace* failedNode = 0;
+  Blob expectedDigest;
+  SegmentManifestResult result = signatureManifest_->verifySegment
+    (*namespace_, segmentNumber, &neededNode, &failedNode, &expectedDigest);
+  if (result == SegmentManifestResult_VERIFIED)
+    return true;
+
+  if (result == SegmentManifestResult_INCOMPLETE) {
+    if (neededNode->getState() < NamespaceState_INTEREST_EXPRESSED)
+      neededNode->objectNeeded();
+    if (find(unverifiedSegments_.begin(), unverifiedSegments_.end(),
+             segmentNumber) == unverifiedSegments_.end())
+      unverifiedSegments_.push_back(segmentNumber);
+    return false;
+  }
+
+  if (!failedNode) {
+    // The manifest or the segment is malformed, so re-fetching won't help.
+    ostringstream message;
+    message << "Segment " << segmentNumber <<
+      " can't be verified with the signature manifest";
+    reportError(message.str());
+    return false;
+  }
+
+  // The segment or a manifest packet on its path doesn't match.
+  int& nRefetches = nSegmentRefetches_[segmentNumber];
+  if (nRefetches >= getMAX_SEGMENT_REFETCHES()) {
+    ostringstream message;
+    message << "Segment " << segmentNumber <<
+      " still doesn't match the signature manifest after " << nRefetches <<
+      " re-fetches";
+    reportError(message.str());
+    return false;
+  }
 
-      // Free resources that won't be used anymore.
-      onSegmentCallbacks_.clear();
-      namespace_->removeCallback(onObjectNeededId_);
-      namespace_->removeCallback(onStateChangedId_);
+  Face* face = namespace_->getFace_();
+  if (!face) {
+    ostringstream message;
+    message << "Segment " << segmentNumber <<
+      " doesn't match the signature manifest and there is no Face to re-fetch " <<
+      failedNode->getName().toUri();
+    reportError(message.str());
+    return false;
+  }
+
+  ++nRefetches;
+  _LOG_DEBUG("SegmentStreamHandler: Segment " << segmentNumber <<
+             " doesn't match the signature manifest. Re-fetching " <<
+             failedNode->getName().toUri());
+  if (isManifestNode(*failedNode) &&
+      find(unverifiedSegments_.begin(), unverifiedSegments_.end(),
+           segmentNumber) == unverifiedSegments_.end())
+    // onManifestNodeReady will verify the segment with the re-fetched node.
+    unverifiedSegments_.push_back(segmentNumber);
+
+  // This may be called from a callback of the node, so remove it later.
+  face->callLater
+    (0, bind(&SegmentStreamHandler::Impl::refetchNode, shared_from_this(),
+             failedNode->getName(), expectedDigest));
+  return false;
+}
+
+void
+SegmentStreamHandler::Impl::refetchNode
+  (const Name& name, const Blob& expectedDigest)
+{
+  if (isStopped_)
+    return;
 
+  // Find the parent of the node. Stop if a node on the path was removed.
+  Namespace* parent = namespace_;
+  for (size_t i = namespace_->getName().size(); i < name.size() - 1; ++i) {
+    if (!parent->hasChild(name[i]))
       return;
+    parent = &(*parent)[name[i]];
+  }
+
+  const Name::Component& component = name[-1];
+  if (parent->hasChild(component) && !(*parent)[component].getData())
+    // Another segment on the path of a manifest node already re-fetched it.
+    return;
+
+  // Remove the node with the bad Data packet and fetch it again. With the
+  // implicit digest, a cache can't return the same bad packet.
+  parent->removeChild(component);
+  (*parent)[component].objectNeededWithDigest_(expectedDigest);
+}
+
+void
+SegmentStreamHandler::Impl::onManifestNodeReady()
+{
+  // Copy the list since verifying can change it.
+  vector<uint64_t> unverifiedSegments;
+  unverifiedSegments.swap(unverifiedSegments_);
+  for (size_t i = 0; i < unverifiedSegments.size(); ++i) {
+    uint64_t segmentNumber = unverifiedSegments[i];
+    if (!verifySegment(segmentNumber)) {
+      if (isStopped_)
+        // reportError stopped fetching.
+        return;
+      continue;
     }
+    if (!onSegmentReady
+        ((*namespace_)[Name::Component::fromSegment(segmentNumber)]))
+      // Finished.
+      return;
+  }
+
+  requestNewSegments(getWindow());
+}
+
+void
+SegmentStreamHandler::Impl::fetchManifestNodes()
+{
+  if (verifySegments_ || isManifestFetched_)
+    return;
+
+  uint64_t nSegments;
+  if (hasFinalSegmentNumber_)
+    nSegments = finalSegmentNumber_ + 1;
+  else {
+    // Get the final segment number from segment 0, if it arrived.
+    Name::Component segment0Component = Name::Component::fromSegment(0);
+    if (!namespace_->hasChild(segment0Component) ||
+        !(*namespace_)[segment0Component].getData())
+      return;
+    const Name::Component& finalBlockId = (*namespace_)[segment0Component]
+      .getData()->getMetaInfo().getFinalBlockId();
+    if (!(finalBlockId.getValue().size() > 0 && finalBlockId.isSegment()))
+      return;
+    nSegments = finalBlockId.toSegment() + 1;
   }
 
-  requestNewSegments(interestPipelineSize_);
+  isManifestFetched_ = SignatureManifest::fetchNodes(*namespace_, nSegments);
+}
+
+bool
+SegmentStreamHandler::Impl::isManifestNode(Namespace& node)
+{
+  // Check for _manifest or _manifest-tree/<level>/<index>.
+  if (node.getParent() == namespace_)
+    return node.getNameComponent().equals(getNAME_COMPONENT_MANIFEST());
+
+  Namespace* treeNamespace =
+    node.getParent() ? node.getParent()->getParent() : 0;
+  return treeNamespace && treeNamespace->getParent() == namespace_ &&
+         treeNamespace->getNameComponent().equals
+           (getNAME_COMPONENT_MANIFEST_TREE());
+}
+
+int
+SegmentStreamHandler::Impl::getWindow()
+{
+  if (windowControl_->getType() == SegmentStreamWindowControl_FIXED)
+    return interestPipelineSize_;
+  return windowControl_->getWindow();
 }
 
 void
 SegmentStreamHandler::Impl::requestNewSegments(int maxRequestedSegments)
 {
+  if (isFetchingPaused_)
+    // resumeFetching will call this.
+    return;
+  if (isStopped_)
+    // Finished, or stopped on an error.
+    return;
   if (maxRequestedSegments < 1)
     maxRequestedSegments = 1;
 
-  ptr_lib::shared_ptr<vector<Name::Component>> childComponents =
-    namespace_->getChildComponents();
-  // First, count how many are already requested and not received.
-  int nRequestedSegments = 0;
-  for (vector<Name::Component>::iterator component = childComponents->begin();
-       component != childComponents->end(); ++component) {
-    if (!component->isSegment())
-      // The namespace contains a child other than a segment. Ignore.
-      continue;
-
-    Namespace& child = (*namespace_)[*component];
-    if (!child.getData() &&
-        child.getState() >= NamespaceState_INTEREST_EXPRESSED) {
-      ++nRequestedSegments;
-      if (nRequestedSegments >= maxRequestedSegments)
-        // Already maxed out on requests.
-        break;
-    }
-  }
-
-  // Now find unrequested segment numbers and request.
-  int segmentNumber = maxReportedSegmentNumber_;
-  while (nRequestedSegments < maxRequestedSegments) {
-    ++segmentNumber;
-    if (finalSegmentNumber_ >= 0 && segmentNumber > finalSegmentNumber_)
+  // Segments before nextSegmentToRequest_ are already requested or received,
+  // so we only need to check new segment numbers.
+  while (nOutstandingSegments_ < maxRequestedSegments) {
+    uint64_t segmentNumber = nextSegmentToRequest_;
+    if (hasFinalSegmentNumber_ && segmentNumber > finalSegmentNumber_)
       break;
+    ++nextSegmentToRequest_;
 
     Namespace& segment = (*namespace_)[
       Name::Component::fromSegment(segmentNumber)];
@@ -318,25 +792,48 @@ SegmentStreamHandler::Impl::requestNewSegments(int maxRequestedSegments)
       // Already got the data packet or already requested.
       continue;
 
-    ++nRequestedSegments;
+    // Segment numbers are requested in order, so this is at the end.
+    while (requestTimesOffset_ + requestTimes_.size() <= segmentNumber)
+      requestTimes_.push_back(-1);
+    requestTimes_[segmentNumber - requestTimesOffset_] = ndn_getNowMilliseconds();
+    ++nOutstandingSegments_;
     segment.objectNeeded();
   }
 }
 
+MillisecondsSince1970
+SegmentStreamHandler::Impl::onSegmentNotOutstanding(uint64_t segmentNumber)
+{
+  if (segmentNumber < requestTimesOffset_ ||
+      segmentNumber - requestTimesOffset_ >= requestTimes_.size())
+    return -1;
+
+  MillisecondsSince1970& requestTime =
+    requestTimes_[segmentNumber - requestTimesOffset_];
+  MillisecondsSince1970 result = requestTime;
+  if (requestTime >= 0) {
+    requestTime = -1;
+    --nOutstandingSegments_;
+  }
+
+  return result;
+}
+
 void
-SegmentStreamHandler::Impl::fireOnSegment(Namespace* segmentNamespace)
+SegmentStreamHandler::Impl::fireOnSegment
+  (map<uint64_t, OnSegment>& callbacks, Namespace* segmentNamespace)
 {
   // Copy the keys before iterating since callbacks can change the list.
   vector<uint64_t> keys;
-  keys.reserve(onSegmentCallbacks_.size());
-  for (map<uint64_t, OnSegment>::iterator i = onSegmentCallbacks_.begin();
-       i != onSegmentCallbacks_.end(); ++i)
+  keys.reserve(callbacks.size());
+  for (map<uint64_t, OnSegment>::iterator i = callbacks.begin();
+       i != callbacks.end(); ++i)
     keys.push_back(i->first);
 
   for (size_t i = 0; i < keys.size(); ++i) {
     // A callback on a previous pass may have removed this callback, so check.
-    map<uint64_t, OnSegment>::iterator entry = onSegmentCallbacks_.find(keys[i]);
-    if (entry != onSegmentCallbacks_.end()) {
+    map<uint64_t, OnSegment>::iterator entry = callbacks.find(keys[i]);
+    if (entry != callbacks.end()) {
       try {
         entry->second(segmentNamespace);
       } catch (const std::exception& ex) {
@@ -349,6 +846,54 @@ SegmentStreamHandler::Impl::fireOnSegment(Namespace* segmentNamespace)
   }
 }
 
+void
+SegmentStreamHandler::Impl::fireOnSegmentsComplete()
+{
+  // Copy the keys before iterating since callbacks can change the list.
+  vector<uint64_t> keys;
+  keys.reserve(onSegmentsCompleteCallbacks_.size());
+  for (map<uint64_t, OnSegmentsComplete>::iterator i =
+         onSegmentsCompleteCallbacks_.begin();
+       i != onSegmentsCompleteCallbacks_.end(); ++i)
+    keys.push_back(i->first);
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    // A callback on a previous pass may have removed this callback, so check.
+    map<uint64_t, OnSegmentsComplete>::iterator entry =
+      onSegmentsCompleteCallbacks_.find(keys[i]);
+    if (entry != onSegmentsCompleteCallbacks_.end()) {
+      try {
+        entry->second(*namespace_);
+      } catch (const std::exception& ex) {
+        _LOG_ERROR("SegmentStreamHandler::fireOnSegmentsComplete: Error in onSegmentsComplete: " <<
+                   ex.what());
+      } catch (...) {
+        _LOG_ERROR("SegmentStreamHandler::fireOnSegmentsComplete: Error in onSegmentsComplete.");
+      }
+    }
+  }
+}
+
+void
+SegmentStreamHandler::Impl::stopFetching()
+{
+  isStopped_ = true;
+
+  // Free resources that won't be used anymore.
+  onSegmentCallbacks_.clear();
+  onSegmentUnorderedCallbacks_.clear();
+  onSegmentsCompleteCallbacks_.clear();
+  onSegmentsErrorCallbacks_.clear();
+  readySegments_.clear();
+  requestTimes_.clear();
+  unverifiedSegments_.clear();
+  nSegmentRefetches_.clear();
+  if (namespace_) {
+    namespace_->removeCallback(onObjectNeededId_);
+    namespace_->removeCallback(onStateChangedId_);
+  }
+}
+
 SegmentStreamHandler::Values* SegmentStreamHandler::values_ = 0;
 
 }
@@ -19,7 +19,15 @@
  * A copy of the GNU Lesser General Public License is in the file COPYING.
  */
 
+#if NDN_CPP_HAVE_MEMORY_H
+#include <memory.h>
+#else
+#include <string.h>
+#endif
+#include <sstream>
+#include <limits>
 #include <ndn-cpp/util/logging.hpp>
+#include <ndn-cpp/digest-sha256-signature.hpp>
 #include <cnl-cpp/segmented-object-handler.hpp>
 
 using namespace std;
@@ -31,7 +39,11 @@ INIT_LOGGER("cnl_cpp.SegmentedObjectHandler");
 namespace cnl_cpp {
 
 SegmentedObjectHandler::Impl::Impl(const OnSegmentedObject& onSegmentedObject)
-: totalSize_(0), namespace_(0)
+: segmentPayloadLength_(0), finalSegmentNumber_(0),
+  hasFinalSegmentNumber_(false), isContentUsable_(true),
+  concatenateSegments_(true), removeSegments_(false), totalSize_(0),
+  isSegmentRemoved_(false),
+  namespace_(0)
 {
   if (onSegmentedObject)
     addOnSegmentedObject(onSegmentedObject);
@@ -40,8 +52,15 @@ SegmentedObjectHandler::Impl::Impl(const OnSegmentedObject& onSegmentedObject)
 void
 SegmentedObjectHandler::Impl::initialize(SegmentedObjectHandler* outerHandler)
 {
-  outerHandler->addOnSegment
+  outerHandler->addOnSegmentUnordered
     (bind(&SegmentedObjectHandler::Impl::onSegment, shared_from_this(), _1));
+  outerHandler->addOnSegmentsComplete
+    (bind(&SegmentedObjectHandler::Impl::onSegmentsComplete, shared_from_this(),
+          _1));
+  setIsFetchingPaused_ = outerHandler->getSetIsFetchingPaused();
+  reportError_ = outerHandler->getReportError();
+  getVerifySegments_ = outerHandler->getGetVerifySegments();
+  getHasOnSegmentCallbacks_ = outerHandler->getGetHasOnSegmentCallbacks();
 }
 
 uint64_t
@@ -62,35 +81,265 @@ SegmentedObjectHandler::Impl::removeCallback(uint64_t callbackId)
 void
 SegmentedObjectHandler::Impl::onSegment(Namespace* segmentNamespace)
 {
-  if (segmentNamespace) {
-    segments_.push_back(segmentNamespace->getBlobObject());
-    totalSize_ += segmentNamespace->getBlobObject().size();
+  if (!isContentUsable_ || (!sink_ && !concatenateSegments_))
+    // onSegmentsComplete will get the segments from the Namespace.
+    return;
+
+  uint64_t segmentNumber = segmentNamespace->getNameComponent().toSegment();
+  if (content_) {
+    copySegment(*segmentNamespace);
+    removeWrittenSegments(segmentNumber);
+    return;
   }
-  else {
-    // Concatenate the segments.
-    ptr_lib::shared_ptr<vector<uint8_t> > content =
-      ptr_lib::make_shared<vector<uint8_t> >(totalSize_);
-    size_t offset = 0;
-    for (size_t i = 0; i < segments_.size(); ++i) {
-      const Blob& segment = segments_[i];
-      memcpy(&(*content)[offset], segment.buf(), segment.size());
-      offset += segment.size();
-      // Free the memory.
-      segments_[i] = Blob();
+  if (sink_ && hasFinalSegmentNumber_) {
+    // We already have segment 0.
+    writeSegment(segmentNumber, segmentNamespace->getBlobObject());
+    removeWrittenSegments(segmentNumber);
+    return;
+  }
+
+  if (segmentNumber != 0) {
+    // Wait for segment 0 to allocate content_.
+    pendingSegmentNumbers_.push_back(segmentNumber);
+    return;
+  }
+
+  const Name::Component& finalBlockId =
+    segmentNamespace->getData()->getMetaInfo().getFinalBlockId();
+  if (!(finalBlockId.getValue().size() > 0 && finalBlockId.isSegment())) {
+    // We can't allocate without the final segment number.
+    isContentUsable_ = false;
+    if (sink_)
+      reportError_
+        ("SegmentedObjectHandler: Segment 0 has no FinalBlockId, so can't write to the sink");
+    return;
+  }
+
+  // Allocate for all segments with the size of segment 0. The final segment
+  // may be shorter, so onSegmentsComplete shrinks to the total size.
+  finalSegmentNumber_ = finalBlockId.toSegment();
+  hasFinalSegmentNumber_ = true;
+  segmentPayloadLength_ = segmentNamespace->getBlobObject().size();
+  uint64_t contentSize;
+  bool isSizeValid = getContentSize(contentSize);
+  if (sink_) {
+    if (!isSizeValid) {
+      isContentUsable_ = false;
+      reportError_
+        ("SegmentedObjectHandler: The FinalBlockId gives an object size too large for the sink");
+      return;
     }
 
-    // Free resources that won't be used anymore.
-    // The OnSegment callback was already removed by the SegmentStreamHandler.
-    segments_.clear();
 
-    // Deserialize and fire the onSegmentedObject callbacks when done.
-    auto onObjectSet = [&] (Namespace& objectNamespace) {
+    // Write to the sink instead of allocating.
+    writeSegment(0, segmentNamespace->getBlobObject());
+    for (size_t i = 0; i < pendingSegmentNumbers_.size() && isContentUsable_; ++i)
+      writeSegment
+        (pendingSegmentNumbers_[i],
+         (*namespace_)[Name::Component::fromSegment(pendingSegmentNumbers_[i])]
+         .getBlobObject());
+    pendingSegmentNumbers_.clear();
+    removeWrittenSegments(0);
+    return;
+  }
+
+  if (!isSizeValid || contentSize > getMAX_ALLOCATED_CONTENT_SIZE()) {
+    _LOG_DEBUG("SegmentedObjectHandler: The FinalBlockId gives an object size too large to allocate. Concatenating when complete.");
+    isContentUsable_ = false;
+    pendingSegmentNumbers_.clear();
+    return;
+  }
+
+  content_ = ptr_lib::make_shared<vector<uint8_t> >((size_t)contentSize);
+
+  copySegment(*segmentNamespace);
+  for (size_t i = 0; i < pendingSegmentNumbers_.size() && content_; ++i)
+    copySegment
+      ((*namespace_)[Name::Component::fromSegment(pendingSegmentNumbers_[i])]);
+  pendingSegmentNumbers_.clear();
+  removeWrittenSegments(0);
+}
+
+void
+SegmentedObjectHandler::Impl::copySegment(Namespace& segmentNamespace)
+{
+  uint64_t segmentNumber = segmentNamespace.getNameComponent().toSegment();
+  const Blob& segment = segmentNamespace.getBlobObject();
+  if (segmentNumber > finalSegmentNumber_ ||
+      segment.size() > segmentPayloadLength_ ||
+      (segmentNumber < finalSegmentNumber_ &&
+       segment.size() != segmentPayloadLength_)) {
+    // The segments don't have the expected sizes.
+    isContentUsable_ = false;
+    content_.reset();
+    if (isSegmentRemoved_) {
+      ostringstream message;
+      message << "SegmentedObjectHandler: Segment " << segmentNumber <<
+        " has an unexpected size, but copied segments were already removed";
+      reportError_(message.str());
+    }
+    else
+      _LOG_DEBUG("SegmentedObjectHandler: Segment " << segmentNumber <<
+                 " has an unexpected size. Concatenating when complete.");
+    return;
+  }
+
+  if (segment.size() > 0)
+    memcpy(&(*content_)[segmentNumber * segmentPayloadLength_], segment.buf(),
+           segment.size());
+  totalSize_ += segment.size();
+
+  // verifyWithManifest needs the segments unless they are already verified.
+  bool isDigestSignature = (dynamic_cast<const DigestSha256Signature *>
+    (segmentNamespace.getData()->getSignature()) != 0);
+  if (!isDigestSignature || getVerifySegments_())
+    writtenSegmentNumbers_.push_back(segmentNumber);
+}
+
+bool
+SegmentedObjectHandler::Impl::getContentSize(uint64_t& contentSize)
+{
+  uint64_t maxSize = numeric_limits<uint64_t>::max();
+  if (finalSegmentNumber_ == maxSize)
+    return false;
+  uint64_t nSegments = finalSegmentNumber_ + 1;
+  if (segmentPayloadLength_ > 0 && nSegments > maxSize / segmentPayloadLength_)
+    return false;
+
+  contentSize = nSegments * segmentPayloadLength_;
+  return true;
+}
+
+void
+SegmentedObjectHandler::Impl::writeSegment
+  (uint64_t segmentNumber, const Blob& segment)
+{
+  if (segmentNumber > finalSegmentNumber_ ||
+      segment.size() > segmentPayloadLength_ ||
+      (segmentNumber < finalSegmentNumber_ &&
+       segment.size() != segmentPayloadLength_)) {
+    // We can't compute the offset, and the written segments are removed.
+    isContentUsable_ = false;
+    ostringstream message;
+    message << "SegmentedObjectHandler: Segment " << segmentNumber <<
+      " has an unexpected size. Can't write to the sink.";
+    reportError_(message.str());
+    return;
+  }
+
+  bool canWriteMore;
+  try {
+    canWriteMore = sink_->writeBlob
+      (segmentNumber * segmentPayloadLength_, segment);
+  } catch (const std::exception& ex) {
+    isContentUsable_ = false;
+    reportError_
+      (string("SegmentedObjectHandler: Error in SegmentSink write: ") +
+       ex.what());
+    return;
+  } catch (...) {
+    isContentUsable_ = false;
+    reportError_("SegmentedObjectHandler: Error in SegmentSink write.");
+    return;
+  }
+
+  totalSize_ += segment.size();
+  writtenSegmentNumbers_.push_back(segmentNumber);
+  if (!canWriteMore)
+    setIsFetchingPaused_(true);
+}
+
+void
+SegmentedObjectHandler::Impl::removeWrittenSegments(uint64_t keepSegmentNumber)
+{
+  if (!removeSegments_ || getHasOnSegmentCallbacks_()) {
+    // Keep the segment nodes.
+    writtenSegmentNumbers_.clear();
+    return;
+  }
+
+  bool keep = false;
+  for (size_t i = 0; i < writtenSegmentNumbers_.size(); ++i) {
+    if (writtenSegmentNumbers_[i] == keepSegmentNumber)
+      keep = true;
+    else {
+      namespace_->removeChild
+        (Name::Component::fromSegment(writtenSegmentNumbers_[i]));
+      isSegmentRemoved_ = true;
+    }
+  }
+
+  writtenSegmentNumbers_.clear();
+  if (keep)
+    writtenSegmentNumbers_.push_back(keepSegmentNumber);
+}
+
+void
+SegmentedObjectHandler::Impl::onSegmentsComplete(Namespace& nameSpace)
+{
+  // The SegmentStreamHandler already removed its callbacks.
+  if (sink_) {
+    if (isContentUsable_) {
+      try {
+        sink_->finish(totalSize_);
+        fireOnSegmentedObject(*namespace_);
+      } catch (const std::exception& ex) {
+        reportError_
+          (string("SegmentedObjectHandler: Error in SegmentSink finish: ") +
+           ex.what());
+      } catch (...) {
+        reportError_("SegmentedObjectHandler: Error in SegmentSink finish.");
+      }
+    }
+
+    // We only fire the callbacks once, so free the resources.
+    onSegmentedObjectCallbacks_.clear();
+    writtenSegmentNumbers_.clear();
+    return;
+  }
+
+  Blob content;
+  if (!concatenateSegments_ || !content_) {
+    // Get the segments from the Namespace.
+    vector<Blob> segments;
+    for (int i = 0; ; ++i) {
+      Name::Component segmentComponent = Name::Component::fromSegment(i);
+      if (!namespace_->hasChild(segmentComponent))
+        break;
+      Namespace& segmentNamespace = (*namespace_)[segmentComponent];
+      if (!segmentNamespace.getObject())
+        break;
+      segments.push_back(segmentNamespace.getBlobObject());
+    }
+
+    if (!concatenateSegments_) {
+      namespace_->setObject_(ptr_lib::make_shared<SegmentedBlobObject>(segments));
       fireOnSegmentedObject(*namespace_);
       // We only fire the callbacks once, so free the resources.
       onSegmentedObjectCallbacks_.clear();
-    };
-    namespace_->deserialize_(Blob(content, false), onObjectSet);
+      return;
+    }
+
+    // The segment sizes didn't allow copying them as they arrived.
+    content = SegmentedBlobObject(segments).toBlob();
   }
+  else {
+    // The final segment may be shorter than the others. This doesn't
+    // reallocate.
+    content_->resize(totalSize_);
+    content = Blob(content_, false);
+    // Free resources that won't be used anymore.
+    content_.reset();
+    writtenSegmentNumbers_.clear();
+  }
+
+  // Deserialize and fire the onSegmentedObject callbacks when done.
+  auto onObjectSet = [&] (Namespace& objectNamespace) {
+    fireOnSegmentedObject(*namespace_);
+    // We only fire the callbacks once, so free the resources.
+    onSegmentedObjectCallbacks_.clear();
+  };
+  namespace_->deserialize_(content, onObjectSet);
 }
 
 void